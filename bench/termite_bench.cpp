@@ -0,0 +1,522 @@
+// termite_bench: timings of the editor core, printed as JSON so runs can be diffed across commits.
+//
+//   termite_bench [--mb N] [--filter SUBSTR] [--out FILE]
+//
+// Editor level cases run on the headless terminal, so render and flush costs are real but no tty
+// is needed. Every case reports the median and the fastest of its repetitions, per operation.
+
+#include "termite/brackets.hpp"
+#include "termite/words.hpp"
+#include "termite/buffer.hpp"
+#include "termite/editor.hpp"
+#include "termite/file_io.hpp"
+#include "termite/filter.hpp"
+#include "termite/headless.hpp"
+#include "termite/input.hpp"
+#include "termite/journal.hpp"
+#include "termite/line_sort.hpp"
+#include "termite/syntax.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef TERMITE_BUILD_TYPE
+#define TERMITE_BUILD_TYPE ""
+#endif
+
+namespace {
+
+using namespace termite;
+using clock_type = std::chrono::steady_clock;
+
+struct Result {
+    std::string name;
+    int reps;
+    long ops;        // operations per repetition
+    double median_ns; // per operation
+    double min_ns;
+    std::string extra; // additional JSON members, already formatted
+};
+
+struct Options {
+    int mb = 16;
+    std::string filter;
+    std::string out;
+};
+
+// C-like text with keywords, strings, comments and numbers, about `bytes` long
+std::string make_source(size_t bytes) {
+    std::string s;
+    s.reserve(bytes + 256);
+    char line[160];
+    for (int i = 0; s.size() < bytes; ++i) {
+        switch (i % 6) {
+        case 0: std::snprintf(line, sizeof(line), "// block %d: helpers for the common case\n", i); break;
+        case 1: std::snprintf(line, sizeof(line), "static int function_%d(int a, int b) {\n", i); break;
+        case 2: std::snprintf(line, sizeof(line), "    const char* name = \"value_%d\"; /* inline */\n", i); break;
+        case 3: std::snprintf(line, sizeof(line), "    if (a > %d) return a * %d + b;\n", i % 97, i % 13); break;
+        case 4: std::snprintf(line, sizeof(line), "    return int(b) - %d;\n", i); break;
+        default: std::snprintf(line, sizeof(line), "}\n"); break;
+        }
+        s += line;
+    }
+    s += "// zzq_rare_needle\n";
+    return s;
+}
+
+class Bench {
+public:
+    explicit Bench(const Options& opt) : opt_(opt) {}
+
+    // setup runs untimed before every repetition, body is timed and performs `ops` operations.
+    // Returns the result to add details to, nullptr if the case was filtered out.
+    Result* run(const std::string& name, int reps, long ops, const std::function<void()>& setup,
+             const std::function<void()>& body, std::string extra = {}) {
+        if (!opt_.filter.empty() && name.find(opt_.filter) == std::string::npos) return nullptr;
+        std::vector<double> times;
+        for (int r = 0; r < reps; ++r) {
+            if (setup) setup();
+            auto t0 = clock_type::now();
+            body();
+            times.push_back(std::chrono::duration<double, std::nano>(clock_type::now() - t0).count());
+        }
+        std::sort(times.begin(), times.end());
+        results_.push_back({name, reps, ops, times[times.size() / 2] / ops, times.front() / ops, std::move(extra)});
+        std::fprintf(stderr, "%-28s %14.1f ns/op\n", name.c_str(), results_.back().median_ns);
+        return &results_.back();
+    }
+
+    std::string json() const {
+        std::string s = "{\n  \"build_type\": \"" TERMITE_BUILD_TYPE "\",\n  \"file_mb\": " + std::to_string(opt_.mb) +
+                        ",\n  \"results\": [\n";
+        char buf[512];
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const auto& r = results_[i];
+            std::snprintf(buf, sizeof(buf),
+                          "    {\"name\": \"%s\", \"reps\": %d, \"ops\": %ld, \"median_ns\": %.1f, \"min_ns\": %.1f%s}%s\n",
+                          r.name.c_str(), r.reps, r.ops, r.median_ns, r.min_ns, r.extra.c_str(),
+                          i + 1 < results_.size() ? "," : "");
+            s += buf;
+        }
+        s += "  ]\n}\n";
+        return s;
+    }
+
+private:
+    const Options& opt_;
+    std::vector<Result> results_;
+};
+
+void bench_load(Bench& b, const std::string& path, int mb) {
+    Buffer buf;
+    b.run("load_" + std::to_string(mb) + "mb", 5, 1, nullptr, [&] { buf.set_contents(file_io::read_file(path)); });
+}
+
+void bench_buffer_edits(Bench& b, const std::string& text) {
+    Buffer buf;
+    buf.set_contents(text);
+    const long n = 10000;
+    struct Where { const char* name; std::function<size_t()> row; };
+    Where places[] = {
+        {"top", [] { return size_t{0}; }},
+        {"middle", [&] { return buf.line_count() / 2; }},
+        {"end", [&] { return buf.line_count() - 1; }},
+    };
+    for (auto& w : places) {
+        std::string suffix = std::string("_") + w.name;
+        b.run("insert_char" + suffix, 5, n, nullptr, [&] {
+            size_t row = w.row();
+            for (long i = 0; i < n; ++i) buf.insert_char(row, 0, 'x');
+        });
+        b.run("delete_char" + suffix, 5, n, nullptr, [&] {
+            size_t row = w.row();
+            for (long i = 0; i < n && buf.line_length(row) > 0; ++i) buf.delete_char(row, 0);
+        });
+        b.run("split_join_line" + suffix, 5, n / 10, nullptr, [&] {
+            size_t row = w.row();
+            for (long i = 0; i < n / 10; ++i) {
+                buf.split_line(row, 0);
+                buf.join_with_next(row);
+            }
+        });
+    }
+}
+
+// follow mode: the file grows by 1 MiB reads that end anywhere inside a line
+void bench_append(Bench& b, const std::string& text) {
+    Buffer buf;
+    const size_t step = size_t{1} << 20;
+    b.run("follow_append_1mb", 5, static_cast<long>(text.size() / step), [&] { buf.set_contents(""); }, [&] {
+        for (size_t off = 0; off + step <= text.size(); off += step) buf.append(std::string_view(text).substr(off, step));
+    });
+}
+
+// typing with the crash-recovery journal attached: the UI thread only encodes, the writer syncs
+void bench_journal(Bench& b, const std::string& path, const std::string& text) {
+    Buffer buf;
+    buf.set_contents(text);
+    const long n = 10000;
+    Journal journal;
+    journal.open(path, 0);
+    buf.set_observer(&journal);
+    b.run("journal_insert_char", 5, n, nullptr, [&] {
+        size_t row = buf.line_count() / 2;
+        for (long i = 0; i < n; ++i) buf.insert_char(row, 0, 'x');
+    });
+    buf.set_observer(nullptr);
+    journal.discard();
+}
+
+// typing at 10k cursors: one batch against a char insert per cursor, with the cursors in a column
+// down the middle of the file and 100 to a line (every fourth byte of 100 lines)
+void bench_multi_cursor(Bench& b, const std::string& text) {
+    Buffer buf;
+    buf.set_contents(text);
+    const long n = 10000;
+    size_t first = buf.line_count() / 2;
+    std::vector<LinePos> column, dense;
+    for (size_t i = 0; i < static_cast<size_t>(n) && first + i < buf.line_count(); ++i) {
+        column.push_back({first + i, 0});
+        dense.push_back({first + i / 100, i % 100 * 4});
+    }
+    for (auto* at : {&column, &dense}) {
+        std::string suffix = at == &column ? "_column" : "_dense";
+        b.run("multi_cursor_insert_batch" + suffix, 5, n, nullptr, [&] { buf.insert_at(*at, "x"); });
+        b.run("multi_cursor_insert_each" + suffix, 5, n, nullptr, [&] {
+            for (size_t i = at->size(); i-- > 0;) buf.insert_char((*at)[i].row, (*at)[i].col, 'x');
+        });
+    }
+}
+
+// bracket index: lex everything once, then a partner at the other end of the file, then a key
+// typed in the middle followed by the sync that relexes it, then a line split there
+void bench_brackets(Bench& b, const std::string& text) {
+    // cut after the last whole function, then wrap everything in one more pair of braces
+    Buffer buf;
+    buf.set_contents(text.substr(0, text.rfind("\n}\n") + 3));
+    buf.split_line(0, 0);
+    buf.insert_char(0, 0, '{');
+    size_t last = buf.line_count() - 1;
+    buf.split_line(last, buf.line_length(last));
+    buf.insert_char(last + 1, 0, '}');
+    BracketIndex index;
+    b.run("bracket_index_build", 5, 1, [&] { index = BracketIndex(); }, [&] { index.sync(buf); });
+    index.sync(buf);
+    const long n = 1000;
+    BracketIndex::Pos to {0, 0};
+    if (auto* r = b.run("bracket_match_far", 5, n, nullptr, [&] {
+            for (long i = 0; i < n; ++i) index.match(buf, 0, 0, to);
+        }))
+        r->extra = ", \"partner_row\": " + std::to_string(to.row);
+    b.run("bracket_sync_edit", 5, n, nullptr, [&] {
+        size_t row = buf.line_count() / 2;
+        for (long i = 0; i < n; ++i) {
+            buf.insert_char(row, 0, 'x');
+            index.sync(buf);
+        }
+    });
+    b.run("bracket_sync_enter", 5, n, nullptr, [&] {
+        size_t row = buf.line_count() / 2;
+        for (long i = 0; i < n; ++i) {
+            buf.split_line(row, 0);
+            index.sync(buf);
+        }
+    });
+}
+
+void bench_words(Bench& b, const std::string& text) {
+    Buffer buf;
+    buf.set_contents(text);
+    WordIndex index;
+    b.run("word_index_build", 5, 1, [&] { index = WordIndex(); }, [&] { index.sync(buf); });
+    index.sync(buf);
+    const long n = 1000;
+    std::vector<std::string> found;
+    if (auto* r = b.run("word_complete", 5, n, nullptr, [&] {
+            for (long i = 0; i < n; ++i) {
+                found.clear();
+                index.complete("function_1", 10, found);
+            }
+        }))
+        r->extra = ", \"words\": " + std::to_string(index.size()) + ", \"found\": " + std::to_string(found.size());
+    // type a word into the middle line: each key relexes that line only
+    b.run("word_sync_edit", 5, n, nullptr, [&] {
+        size_t row = buf.line_count() / 2;
+        for (long i = 0; i < n; ++i) {
+            buf.insert_char(row, 0, static_cast<char>('a' + i % 26));
+            index.sync(buf);
+        }
+    });
+}
+
+// filter: every line through cat and back (pipe throughput both ways, output split into lines),
+// then the output put in place of the lines as one edit
+void bench_filter(Bench& b, const std::string& text) {
+    Buffer buf;
+    buf.set_contents(text);
+    std::vector<std::string> out;
+    bool ok = true;
+    b.run("filter_cat", 3, 1, nullptr, [&] {
+        FilterProcess f;
+        ok = f.start("cat", buf.snapshot(), 0, buf.line_count());
+        auto state = FilterProcess::State::Running;
+        while (ok && state == FilterProcess::State::Running) state = f.pump(std::chrono::milliseconds(10));
+        ok = ok && state == FilterProcess::State::Done;
+        out = std::move(f.lines());
+    });
+    if (!ok) return; // no sh here
+    std::vector<std::string> lines;
+    b.run("filter_replace_lines", 5, 1, [&] { lines = out; }, [&] {
+        buf.replace_lines(0, buf.line_count(), std::move(lines));
+    });
+}
+
+// sort commands: the order of every line (lexical, and numeric by the third field), then the
+// lines moved into it
+void bench_sort(Bench& b, const std::string& text) {
+    Buffer buf;
+    buf.set_contents(text);
+    size_t n = buf.line_count();
+    std::vector<size_t> rows;
+    SortSpec numeric;
+    numeric.numeric = true;
+    numeric.field = 3;
+    b.run("sort_order_lexical", 5, 1, nullptr, [&] { rows = sorted_rows(buf.snapshot(), 0, n, SortSpec{}); });
+    b.run("sort_order_numeric_key", 5, 1, nullptr, [&] { rows = sorted_rows(buf.snapshot(), 0, n, numeric); });
+    b.run("sort_reorder_lines", 5, 1, [&] { rows = sorted_rows(buf.snapshot(), 0, n, SortSpec{}); }, [&] {
+        buf.reorder_lines(0, n, rows);
+    });
+    b.run("sort_unique", 5, 1, nullptr, [&] { rows = unique_rows(buf.snapshot(), 0, n); });
+}
+
+void bench_highlight(Bench& b, const std::string& text) {
+    Buffer buf;
+    buf.set_contents(text);
+    const size_t rows = 50;
+    size_t first = buf.line_count() / 2;
+    size_t spans = 0;
+    if (auto* r = b.run("highlight_viewport", 50, static_cast<long>(rows), nullptr, [&] {
+            spans = 0;
+            for (size_t r = first; r < first + rows && r < buf.line_count(); ++r)
+                spans += get_syntax_highlights(buf.line(r)).size();
+        }))
+        r->extra = ", \"spans\": " + std::to_string(spans);
+}
+
+void keys(Editor& ed, int key, int times = 1) {
+    for (int i = 0; i < times; ++i) ed.process_key(key);
+}
+
+void bench_editor(Bench& b, const std::string& path, headless::Terminal& term) {
+    Editor ed;
+
+    // select the first `lines` lines from the top
+    auto select_top = [&](int lines) {
+        ed.open_file(path);
+        keys(ed, input::KEY_CTRL_HOME);
+        keys(ed, input::KEY_SHIFT_DOWN, lines);
+    };
+
+    const int paste_lines = 20000;
+    b.run("paste_large", 3, 1,
+          [&] {
+              select_top(paste_lines);
+              keys(ed, input::KEY_CTRL_C);
+              keys(ed, 27); // drop the selection
+              keys(ed, input::KEY_CTRL_END);
+          },
+          [&] { keys(ed, input::KEY_CTRL_V); },
+          ", \"lines\": " + std::to_string(paste_lines));
+
+    const int delete_lines = 100000;
+    b.run("delete_selection_large", 3, 1, [&] { select_top(delete_lines); },
+          [&] { keys(ed, input::KEY_BACKSPACE); }, ", \"lines\": " + std::to_string(delete_lines));
+
+    // block of 8 columns down the whole file (up to 1M lines) copied in one pass
+    const int block_lines = 1000000;
+    b.run("copy_block_large", 3, 1,
+          [&] {
+              ed.open_file(path);
+              keys(ed, input::KEY_CTRL_HOME);
+              keys(ed, input::KEY_ALT_SHIFT_RIGHT, 8);
+              keys(ed, input::KEY_ALT_SHIFT_DOWN, block_lines - 1);
+          },
+          [&] { keys(ed, input::KEY_CTRL_C); }, ", \"max_lines\": " + std::to_string(block_lines));
+
+    // incremental search: every typed character rescans, Enter jumps to the first match
+    auto search = [&](const std::string& needle) {
+        return [&, needle] {
+            term.push_text(needle);
+            term.push_key("\r");
+            keys(ed, input::KEY_CTRL_F);
+        };
+    };
+    auto reopen = [&] { ed.open_file(path); };
+    b.run("search_common", 5, 1, reopen, search("int"));
+    b.run("search_rare", 5, 1, reopen, search("zzq_rare_needle"));
+
+    // cold: a page of lines never drawn before; warm: nothing changed since the last frame
+    ed.open_file(path);
+    ed.draw();
+    auto frames = [&](const std::string& name, int reps, const std::function<void()>& setup) {
+        size_t bytes0 = term.bytes();
+        if (auto* r = b.run(name, reps, 1, setup, [&] { ed.draw(); }))
+            r->extra = ", \"bytes_per_frame\": " + std::to_string((term.bytes() - bytes0) / static_cast<size_t>(reps));
+    };
+    frames("render_frame_cold", 50, [&] { keys(ed, input::KEY_PAGE_DOWN); });
+    frames("render_frame_warm", 200, nullptr);
+    frames("render_frame_scroll", 100, [&] { keys(ed, input::KEY_DOWN, 30); });
+
+    // the same lines in a second pane next to the first: layouts and highlights come from the cache
+    term.push_text("vsplit\r");
+    keys(ed, input::KEY_CTRL_E);
+    frames("render_split_cold", 50, [&] { keys(ed, input::KEY_PAGE_DOWN); });
+    frames("render_split_warm", 200, nullptr);
+}
+
+// the whole file folded to its top-level functions: paging and drawing only see the headers, a line
+// break typed on a header moves every fold below it
+void bench_folds(Bench& b, const std::string& path, headless::Terminal& term) {
+    Editor ed;
+    ed.open_file(path);
+    auto fold_all = [&] {
+        term.push_text("fold all\r");
+        keys(ed, input::KEY_CTRL_E);
+    };
+    b.run("fold_all", 5, 1, [&] { ed.open_file(path); }, fold_all);
+    ed.open_file(path);
+    fold_all();
+    ed.draw();
+    b.run("folded_page_down", 50, 1, nullptr, [&] {
+        keys(ed, input::KEY_PAGE_DOWN);
+        ed.draw();
+    });
+    b.run("folded_scroll", 100, 30, nullptr, [&] {
+        keys(ed, input::KEY_DOWN, 30);
+        ed.draw();
+    });
+    keys(ed, input::KEY_CTRL_HOME);
+    b.run("folded_enter", 50, 1, nullptr, [&] {
+        keys(ed, input::KEY_ENTER);
+        ed.draw();
+    });
+}
+
+// soft wrap over the whole file: a line break typed at the top (every line below moves) and a
+// resize (every line is unmeasured again), each with a frame
+void bench_wrap(Bench& b, const std::string& path, headless::Terminal& term) {
+    Editor ed;
+    ed.open_file(path);
+    term.push_text("wrap\r");
+    keys(ed, input::KEY_CTRL_E);
+    ed.draw();
+    b.run("wrap_enter", 50, 1, nullptr, [&] {
+        keys(ed, input::KEY_ENTER);
+        ed.draw();
+    });
+    int cols = 160;
+    b.run("wrap_resize", 20, 1, [&] { term.resize(50, cols = cols == 160 ? 150 : 160); }, [&] { ed.draw(); });
+    term.resize(50, 160);
+}
+
+// --view pager: open, jump to a byte percentage and page, each followed by a frame
+void bench_view(Bench& b, const std::string& path, headless::Terminal& term) {
+    Editor ed;
+    b.run("view_open", 5, 1, nullptr, [&] {
+        ed.open_view(path);
+        ed.draw();
+    });
+    int pct = 0;
+    b.run("view_jump_percent", 20, 1, [&] { term.push_text(std::to_string(pct = (pct + 37) % 100) + "%\r"); },
+          [&] {
+              keys(ed, input::KEY_CTRL_G);
+              ed.draw();
+          });
+    b.run("view_page_down", 50, 1, nullptr, [&] {
+        keys(ed, input::KEY_PAGE_DOWN);
+        ed.draw();
+    });
+}
+
+// Hex view of a binary file: open (no line count) and page, each followed by a frame
+void bench_hex_view(Bench& b, const std::string& text) {
+    auto path = (std::filesystem::temp_directory_path() / "termite_bench.bin").string();
+    {
+        std::ofstream f(path, std::ios::binary);
+        f.put('\0');
+        f.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+    Editor ed;
+    b.run("hex_open", 5, 1, nullptr, [&] {
+        ed.open_view(path);
+        ed.draw();
+    });
+    b.run("hex_page_down", 50, 1, nullptr, [&] {
+        keys(ed, input::KEY_PAGE_DOWN);
+        ed.draw();
+    });
+    std::filesystem::remove(path);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--mb" && i + 1 < argc) opt.mb = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--filter" && i + 1 < argc) opt.filter = argv[++i];
+        else if (a == "--out" && i + 1 < argc) opt.out = argv[++i];
+        else {
+            std::fprintf(stderr, "usage: termite_bench [--mb N] [--filter SUBSTR] [--out FILE]\n");
+            return 2;
+        }
+    }
+
+    std::string text = make_source(static_cast<size_t>(opt.mb) << 20);
+    auto path = (std::filesystem::temp_directory_path() / "termite_bench.c").string();
+    {
+        std::ofstream f(path, std::ios::binary);
+        f.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    headless::Terminal term(50, 160);
+    headless::attach(&term);
+
+    Bench b(opt);
+    bench_load(b, path, opt.mb);
+    bench_buffer_edits(b, text);
+    bench_append(b, text);
+    bench_journal(b, path, text);
+    bench_multi_cursor(b, text);
+    bench_brackets(b, text);
+    bench_words(b, text);
+    bench_filter(b, text);
+    bench_sort(b, text);
+    bench_highlight(b, text);
+    bench_editor(b, path, term);
+    bench_folds(b, path, term);
+    bench_wrap(b, path, term);
+    bench_view(b, path, term);
+    bench_hex_view(b, text);
+
+    headless::attach(nullptr);
+    std::filesystem::remove(path);
+
+    std::string json = b.json();
+    if (opt.out.empty()) {
+        std::fputs(json.c_str(), stdout);
+    } else {
+        std::ofstream f(opt.out, std::ios::binary);
+        f << json;
+    }
+    return 0;
+}
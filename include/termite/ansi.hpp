@@ -11,11 +11,29 @@ inline constexpr const char* HIDE_CURSOR = "\x1b[?25l";
 inline constexpr const char* SHOW_CURSOR = "\x1b[?25h";
 inline constexpr const char* REVERSE = "\x1b[7m";
 inline constexpr const char* BOLD = "\x1b[1m";
+inline constexpr const char* RESET_SCROLL_REGION = "\x1b[r";
+// Synchronized output (DEC mode 2026): the terminal holds the screen until the frame is complete
+inline constexpr const char* BEGIN_SYNC = "\x1b[?2026h";
+inline constexpr const char* END_SYNC = "\x1b[?2026l";
 
 inline std::string cursor_pos(int row, int col) {
     return "\x1b[" + std::to_string(row) + ";" + std::to_string(col) + "H";
 }
 
+// DECSTBM: rows top..bottom (1-based) scroll, the rest stays put
+inline std::string scroll_region(int top, int bottom) {
+    return "\x1b[" + std::to_string(top) + ";" + std::to_string(bottom) + "r";
+}
+
+// SU / SD: move the scroll region content up / down by n rows
+inline std::string scroll_up(int n) {
+    return "\x1b[" + std::to_string(n) + "S";
+}
+
+inline std::string scroll_down(int n) {
+    return "\x1b[" + std::to_string(n) + "T";
+}
+
 inline std::string color256(int idx) {
     return "\x1b[38;5;" + std::to_string(idx) + "m";
 }
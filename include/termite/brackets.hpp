@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "termite/lexed_lines.hpp"
+#include "termite/syntax.hpp"
+
+namespace termite {
+
+class Buffer;
+
+// Brackets of the whole buffer, to find the partner of a bracket any number of lines away.
+// Every line keeps its balance (opens - closes) and the lowest running balance inside it, and the
+// tree of a LineSeq sums those up, so the line that holds the partner is found in O(log n); only
+// that line and the one of the bracket get lexed again. Edits come from the buffer's edit log
+// (see LexedLines): an edited line is lexed again, the lines after it only while its end state
+// changes (a block comment opened or closed).
+class BracketIndex {
+public:
+    struct Pos {
+        size_t row;
+        size_t col;
+    };
+
+    // Follow the edits made since the last call (lexes everything the first time).
+    void sync(const Buffer& buf);
+    // Partner of the bracket at (row, col); false if there is none there or it is unmatched.
+    bool match(const Buffer& buf, size_t row, size_t col, Pos& out);
+    // Innermost bracket still open at (row, col).
+    bool enclosing(const Buffer& buf, size_t row, size_t col, Pos& out);
+
+private:
+    struct Line {
+        int32_t sum;  // opens - closes
+        int32_t low;  // lowest running balance, <= 0 (the highest suffix balance is sum - low)
+        LexState in;
+        LexState out;
+        uint64_t stamp;
+    };
+    struct Node {
+        int64_t sum;
+        int64_t low;
+
+        static Node of(const Line& l) { return {l.sum, l.low}; }
+        friend Node operator+(const Node& a, const Node& b) { return {a.sum + b.sum, std::min(a.low, a.sum + b.low)}; }
+    };
+
+    LexState summarize(Line& l, const std::string& line, LexState in);
+    // First line >= row where `open` unclosed brackets get closed / last line <= row where `close`
+    // unopened ones get opened; the count is what is left before that line. NONE if none.
+    size_t find_forward(size_t row, int64_t& open) const;
+    size_t find_backward(size_t row, int64_t& close) const;
+    // From pending brackets before the partner to its position
+    bool finish_forward(const Buffer& buf, size_t row, int64_t open, Pos& out);
+    bool finish_backward(const Buffer& buf, size_t row, int64_t close, Pos& out);
+
+    LexedLines<Line, Node> lines_;
+    std::vector<BracketToken> scratch_;
+};
+
+} // namespace termite
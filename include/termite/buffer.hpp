@@ -1,20 +1,162 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace termite {
 
+namespace detail {
+
+// Leaf of the line tree: a run of consecutive lines.
+// A chunk that is referenced by more than one tree is never mutated, it gets copied first.
+struct LineChunk {
+    std::vector<std::string> lines;
+    // Per-line stamp, unique in the process: a new one is handed out whenever a line is
+    // created or modified, so caches can key on it (identity + version in one number).
+    std::vector<uint64_t> stamps;
+};
+
+// Root of the line tree: chunk handles + the index of the first line of every chunk.
+struct LineTree {
+    std::vector<std::shared_ptr<LineChunk>> chunks;
+    std::vector<size_t> starts;
+    size_t total {0};
+
+    // Find (chunk index, line index inside that chunk) for a row. Row must be < total.
+    void locate(size_t row, size_t& chunk, size_t& offset) const;
+    const std::string& line(size_t row) const;
+    uint64_t stamp(size_t row) const;
+};
+
+} // namespace detail
+
+// Immutable view of the buffer at one point in time.
+// Taking one is O(1) (it only shares the line tree), and since the buffer copies a chunk
+// before it modifies a shared one, a snapshot can be read from another thread without locks.
+class Snapshot {
+public:
+    Snapshot() = default;
+
+    size_t line_count() const { return tree_ ? tree_->total : 0; }
+    const std::string& line(size_t row) const { return tree_->line(row); }
+    size_t size() const { return line_count(); }
+    const std::string& operator[](size_t row) const { return line(row); }
+
+    // Visit every line in order, chunk by chunk (no per-line lookup).
+    template <class F>
+    void for_each_line(F&& fn) const {
+        if (!tree_) return;
+        for (const auto& c : tree_->chunks)
+            for (const auto& l : c->lines) fn(l);
+    }
+    // Visit lines [first, first + count) in order, first < line_count()
+    template <class F>
+    void for_each_line(size_t first, size_t count, F&& fn) const {
+        if (!tree_ || count == 0) return;
+        size_t c, o;
+        tree_->locate(first, c, o);
+        for (; count > 0 && c < tree_->chunks.size(); ++c, o = 0) {
+            const auto& lines = tree_->chunks[c]->lines;
+            for (; o < lines.size() && count > 0; ++o, --count) fn(lines[o]);
+        }
+    }
+
+private:
+    friend class Buffer;
+    explicit Snapshot(std::shared_ptr<const detail::LineTree> tree) : tree_(std::move(tree)) {}
+    std::shared_ptr<const detail::LineTree> tree_;
+};
+
+class Buffer;
+
+enum class LineEnding { LF, CRLF };
+
+// On-disk shape of the file, detected while loading and written back on save.
+struct FileFormat {
+    LineEnding eol {LineEnding::LF};
+    bool trailing_newline {false};
+    bool utf8_bom {false};
+};
+
+// One change: lines [row, row + removed) were replaced by `added` new lines. Edits inside lines
+// are logged as {row, 0, 0, changed} (and show up as new line stamps), so indexes that depend on
+// line contents can follow them without comparing every stamp. A batch over many lines (insert_at,
+// erase_at) is one entry from its first to its last line; the lines in between keep their stamps.
+struct LineEdit {
+    size_t row;
+    size_t removed;
+    size_t added;
+    size_t changed; // edited in place: lines [row, row + changed), removed and added are 0
+};
+
+// One primitive edit as the buffer applied it. Replaying the same ops on the same contents gives
+// the same result (crash-recovery journal).
+struct BufferOp {
+    enum Kind : uint8_t { InsertChar = 1, DeleteChar, SplitLine, JoinLine, DeleteLine, Append };
+    Kind kind;
+    size_t row {0};
+    size_t col {0};
+    std::string_view text; // InsertChar: the character, Append: the bytes
+};
+
+// Position inside a line (byte column) and a byte range inside a line, for batched edits
+struct LinePos {
+    size_t row;
+    size_t col;
+};
+
+struct LineSpan {
+    size_t row;
+    size_t col;
+    size_t len;
+};
+
+// Told about every edit of the contents (not about set_contents, that is a new document, nor
+// about replace_lines, whose caller records the result as a whole, see Journal::compact)
+class BufferObserver {
+public:
+    virtual ~BufferObserver() = default;
+    virtual void applied(const BufferOp& op) = 0;
+};
+
+// Live, non-owning view of the buffer lines (always sees the latest edit).
+class LineView {
+public:
+    explicit LineView(const Buffer& b) : buf_(&b) {}
+    size_t size() const;
+    const std::string& operator[](size_t row) const;
+
+private:
+    const Buffer* buf_;
+};
+
 class Buffer {
 public:
     Buffer();
 
+    // Split text into lines (one memchr pass) and detect the FileFormat on the way.
     void set_contents(std::string text);
-    const std::vector<std::string>& lines() const { return lines_; }
+    const FileFormat& format() const { return format_; }
+    void set_format(const FileFormat& f) { format_ = f; }
+    LineView lines() const { return LineView(*this); }
     const std::vector<std::string>& syntaxLines() const { return syntaxLines_; }
+    // Cheap consistent copy of the current contents for background readers (save, search, ...)
+    Snapshot snapshot() const { return Snapshot(tree_); }
+
+    // Edit log for indexes that follow the buffer (wrap index, bracket index, ...).
+    uint64_t revision() const { return revision_; }
+    // Append the edits made after rev; false if the log does not reach back that far
+    // (or the contents were replaced), the caller then rebuilds from scratch.
+    bool edits_since(uint64_t rev, std::vector<LineEdit>& out) const;
 
-    size_t line_count() const { return lines_.size(); }
-    size_t line_length(size_t row) const { return row < lines_.size() ? lines_[row].size() : 0; }
+    size_t line_count() const { return tree_->total; }
+    const std::string& line(size_t row) const { return tree_->line(row); }
+    uint64_t line_stamp(size_t row) const { return tree_->stamp(row); }
+    size_t line_length(size_t row) const { return row < tree_->total ? tree_->line(row).size() : 0; }
     void insert_char(size_t row, size_t col, char ch);
     // Delete character at postion, -> not if pos.y = line_length
     void delete_char(size_t row, size_t col);
@@ -24,11 +166,49 @@ public:
     void join_with_next(size_t row);
     // Delete entire line, -> no empty line left. Like in vs code :)
     void delete_line(size_t row);
+    // Insert text at every position (sorted by row, then col). Each line is rebuilt once, so
+    // typing at thousands of cursors costs one pass over the lines they are on.
+    void insert_at(const std::vector<LinePos>& at, std::string_view text);
+    // Remove every span (sorted, not overlapping), one pass per line like insert_at
+    void erase_at(const std::vector<LineSpan>& spans);
+    // Add text at the end as if the file grew (follow mode): it continues the last line unless
+    // the buffer ends with a line break. Line endings are split like in set_contents, and only
+    // the chunks at the end of the tree are touched. Returns the first row that changed.
+    size_t append(std::string_view text);
+    // Replace lines [row, row + count) by lines, as one edit (filter output): the strings are moved
+    // into new chunks, the lines around the range keep theirs. Followers see one LineEdit.
+    void replace_lines(size_t row, size_t count, std::vector<std::string> lines);
+    // Put lines [row, row + count) in the order of rows (distinct rows of the range, ones left out
+    // are dropped), as one edit: the strings are moved, not copied, and keep their stamps.
+    void reorder_lines(size_t row, size_t count, const std::vector<size_t>& rows);
+    // Apply an op reported to an observer earlier (journal replay)
+    void apply(const BufferOp& op);
+    void set_observer(BufferObserver* observer) { observer_ = observer; }
 
 
 private:
-    std::vector<std::string> lines_;
+    // Copy-on-write access: unshares the tree and the chunk holding row before handing it out
+    std::string& mutable_line(size_t row);
+    // Same without logging the edit, for batches that log all their lines as one
+    std::string& unshare_line(size_t row);
+    void insert_line(size_t row, std::string text);
+    // Lines [row, row + count) become lines with the given stamps, the tree must be unique
+    void splice(size_t row, size_t count, std::vector<std::string> lines, const std::vector<uint64_t>& stamps);
+    void erase_line(size_t row);
+    void make_tree_unique();
+    void reindex_from(size_t chunk);
+    void log_edit(size_t row, size_t removed, size_t added, size_t changed = 0);
+
+    std::shared_ptr<detail::LineTree> tree_;
+    FileFormat format_;
+    std::vector<LineEdit> edit_log_;
+    uint64_t revision_ {0};
+    uint64_t log_base_ {0}; // revision before edit_log_[0]
     std::vector<std::string> syntaxLines_;
+    BufferObserver* observer_ {nullptr};
 };
 
+inline size_t LineView::size() const { return buf_->line_count(); }
+inline const std::string& LineView::operator[](size_t row) const { return buf_->line(row); }
+
 } // namespace termite
@@ -1,13 +1,29 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "termite/panes.hpp"
+#include "termite/syntax.hpp"
+
 namespace termite {
 
 class Screen;
 class Buffer;
+class LayoutCache;
+struct LineLayout;
+class WrapIndex;
+class FoldIndex;
+class KeyLatency;
+class FileView;
+class FileFollower;
+class Journal;
+class BracketIndex;
+class WordIndex;
+class FilterProcess;
 
 class Editor {
 public:
@@ -16,30 +32,161 @@ public:
 
     int run(int argc, char** argv);
 
+    // Drive the editor without run(), e.g. from the benchmarks on the headless terminal:
+    // open a file, feed decoded keys (false = quit), draw a frame.
+    bool open_file(const std::string& path);
+    // Read-only pager over a file of any size (--view), see FileView
+    bool open_view(const std::string& path);
+    bool process_key(int key) { return handle_input(key); }
+    void draw() { render(); }
+
 private:
-    void open_file_if_provided(int argc, char** argv);
     void render();
     bool handle_input(int key);
     void scroll();
+    // Columns left for text next to the line number gutter
+    int text_width() const;
+    // Soft wrap helpers: visual row of the cursor, move the cursor by visual rows
+    int64_t cursor_vrow();
+    void move_visual(int delta);
+    // Folding: the folds of this view synced with the buffer, null while nothing is folded.
+    // Without soft wrap row_off_ then counts visible lines instead of lines.
+    FoldIndex* synced_folds();
+    // Move the cursor by delta visible lines, folded ones are skipped
+    void move_lines(int delta);
+    // Row of the cursor in row_off_ units: visual row with soft wrap, else visible line
+    int64_t cursor_row();
+    // Region headed by row: to the partner of its brace, else the more indented lines below it
+    bool fold_region(size_t row, size_t& last);
+    // "fold": open the fold at the cursor, else fold the selected lines or the region around the
+    // cursor. "fold all" folds every top-level region, "unfold" opens everything.
+    void toggle_fold();
+    void fold_all(bool fold);
+    // Ctrl-E command line
+    void run_command(const std::string& cmd);
+    // --view: render / keys of the pager instead of the buffer
+    void render_view();
+    bool handle_view_input(int key);
+    int view_rows() const;
+    // Hex view of a binary file in the pager: draw rows (returns the column of the first byte),
+    // move the top by n rows of 16 bytes, Ctrl-G to an offset
+    int render_hex_rows(int first_row, int rows, int cols);
+    void scroll_hex(int64_t n);
+    void goto_hex_offset();
+    // Follow mode (tail -f): start/stop watching filename_, take in what was appended
+    void set_follow(bool on);
+    bool poll_follow();
+    // Whole lines the selection covers, all of them without a selection
+    void selected_lines(size_t& first, size_t& count) const;
+    // Lines from first on were replaced in one bulk edit (filter, sort): journal, cursor, search
+    void lines_replaced(size_t first);
+    // "sort [-n] [-r] [-u] [-k N]", "unique" and "reverse": reorder the selected lines in place,
+    // see line_sort.hpp
+    void reorder_lines(const std::string& name, const std::string& args);
+    // "filter <command>": pipe the selected lines (all without a selection) through a shell
+    // command in the background, poll_filter() moves its data from run() and puts the output
+    // in place of the lines once it exited. Ctrl-C cancels it.
+    void start_filter(const std::string& command);
+    bool poll_filter();
+    void cancel_filter();
+    // Crash-recovery journal of filename_: replay what a previous session left, then record
+    void start_journal();
+    // Open buffers: open path into a new one and make it current, switch, close the current one
+    bool open_document(const std::string& path);
+    void switch_document(size_t index);
+    void close_document(bool force);
+    std::string document_list() const;
     // Prompt for input on the status line; returns empty string if canceled.
     std::string prompt_input(const std::string& prompt, const std::string& initial = "");
-    void clear_selection() { selecting_ = false; }
-    void start_selection_if_needed() { if (!selecting_) { selecting_ = true; anchor_cx_ = cx_; anchor_cy_ = cy_; } }
+    void clear_selection() {
+        selecting_ = false;
+        block_ = false;
+    }
+    void start_selection_if_needed() {
+        if (!selecting_) { selecting_ = true; anchor_cx_ = cx_; anchor_cy_ = cy_; }
+        block_ = false;
+    }
     bool selection_active() const { return selecting_ && (anchor_cx_ != cx_ || anchor_cy_ != cy_); }
     void delete_selection();
     void copy_selection_to_clipboard();
     void paste_from_clipboard();
     void debug_note(const std::string& note);
+    // Block selection (Alt-Shift-arrows): the same display columns of every selected line.
+    // Typing, Backspace, Delete and Enter act on each line, copy / cut / delete take the block.
+    void extend_block(int key);
+    bool block_range(int& r0, int& r1, int& c0, int& c1) const;
+    void copy_block();
+    void delete_block();
+    void edit_block(int key);
+    // Multi-cursor editing: add cursors (Ctrl-D next occurrence of the selection, Alt-Up/Down and
+    // "cursors N" a column of them, "cursors" one per search match) and apply keys at all of them
+    void add_cursor_at_next_match();
+    void add_cursor_column(int dir, int count);
+    void add_cursors_at_matches();
+    void normalize_cursors();
+    // Keys while there are extra cursors: true if the key was an edit done at every cursor
+    bool handle_cursors_key(int key);
+    void edit_at_cursors(int key);
+    // Draw a row that has extra cursors on it; false if it has none
+    bool render_cursor_row(const std::string& line, LineLayout& lay, int file_row, int win_c0, int win_c1, int text_cols);
+    // Bracket at (or right before) the cursor and its partner, 0-based; the innermost open bracket
+    // around the cursor. Both build the bracket index of the buffer on first use.
+    bool bracket_pair(size_t& row, size_t& col, size_t& prow, size_t& pcol);
+    bool enclosing_bracket(size_t& row, size_t& col);
+    // Ctrl-Space completion of the word before the cursor from the words of every open buffer
+    // (each buffer's WordIndex is built on first use, then follows its edits). Keys while the list
+    // is open go to handle_completion_key first (true if it used them); typing refines the list.
+    void start_completion();
+    bool handle_completion_key(int key);
+    void update_completion();
     // Search helpers
     void start_search();
-    void update_search_matches();
+    // Rescan lines [from_line, end), matches above it are kept
+    void update_search_matches(int from_line = 0);
     void jump_to_match(int index);
 
     std::unique_ptr<Screen> screen_;
     std::unique_ptr<Buffer> buffer_;
+    // Byte <-> display column maps of recently drawn lines, shared by all open buffers: keyed by
+    // line stamps, which no two buffers share, so a buffer switched back to finds its lines still
+    // there unless trim() dropped them when the cache grew large
+    std::unique_ptr<LayoutCache> layouts_;
+    // --view: set while paging a file, the buffer stays empty
+    std::unique_ptr<FileView> view_;
+    int view_shift_ {0}; // lines the view scrolled since the last frame
+    std::string view_path_;
+    // Binary files (NUL bytes near the start) are paged as offset / hex / ASCII rows of 16 bytes,
+    // hex_top_ is the offset of the top row. One opened in place of a buffer is left with Esc.
+    bool view_hex_ {false};
+    bool view_over_buffers_ {false};
+    uint64_t hex_top_ {0};
+    bool view_shrank_ {false}; // the shrink of the file has been reported
     std::string status_;
     std::string filename_;
     bool modified_ {false};
+    uint64_t file_bytes_ {0}; // bytes of filename_ the buffer holds, follow mode reads on from there
+    // Follow mode: appended bytes go to the end of the buffer, follow_chunk_ is the read buffer
+    std::unique_ptr<FileFollower> follow_;
+    std::string follow_chunk_;
+    // Running filter, the buffer and revision its lines were taken from: output for a buffer
+    // edited meanwhile is dropped
+    std::unique_ptr<FilterProcess> filter_;
+    std::string filter_command_;
+    const Buffer* filter_buffer_ {nullptr};
+    uint64_t filter_revision_ {0};
+    // Unsaved edits of filename_ on disk until the next save (off with --no-journal and when
+    // driven without run(), e.g. the benchmarks)
+    std::unique_ptr<Journal> journal_;
+    bool journal_enabled_ {false};
+    // Brackets of buffer_ for Ctrl-G and the highlighted pair, null until a bracket is looked up
+    std::unique_ptr<BracketIndex> brackets_;
+    // Identifiers of buffer_ for completion, null until the first Ctrl-Space
+    std::unique_ptr<WordIndex> words_;
+    // Completion list shown under the cursor: words starting with completion_prefix_
+    bool completing_ {false};
+    std::string completion_prefix_;
+    std::vector<std::string> completions_;
+    int completion_index_ {0};
 
     // Cursor position in buffer coordinates (1-based col, 1-based line index)
     int cx_ {1};
@@ -48,18 +195,108 @@ private:
     int row_off_ {0};
     //horizontal scoll offset
     int col_off_ {0};
+    // row_off_ of the last frame, render turns the difference into a terminal scroll (-1 = none)
+    int drawn_row_off_ {-1};
+    // Soft wrap: long lines continue on the next screen row, row_off_ then counts visual rows
+    bool soft_wrap_ {false};
+    std::unique_ptr<WrapIndex> wrap_;
+    std::unique_ptr<FoldIndex> folds_; // null until something is folded
     // Selection
     bool selecting_ {false};
     int anchor_cx_ {1};
     int anchor_cy_ {1};
+    // Block selection: anchor_cy_..cy_ by display columns block_anchor_col_..block_col_, which can
+    // lie past the end of short lines
+    bool block_ {false};
+    int block_anchor_col_ {0};
+    int block_col_ {0};
+    // Extra cursors next to cx_/cy_, sorted by position. anchor_cx is the other end of a selection on
+    // the same line (== cx: nothing selected).
+    struct Cursor {
+        int cx;
+        int cy;
+        int anchor_cx;
+    };
+    std::vector<Cursor> cursors_;
     // Search state
     bool searching_ {false};
     std::string search_query_;
     struct Match { int line; int start; int end; }; // char indices
     std::vector<Match> search_matches_;
     int search_index_ { -1 };
+    // Cursor, scroll, wrap, folds and selection of one view of a buffer: the fields above from cx_ to
+    // cursors_ (search state belongs to the buffer)
+    struct ViewState {
+        int cx {1};
+        int cy {1};
+        int row_off {0};
+        int col_off {0};
+        bool soft_wrap {false};
+        std::unique_ptr<WrapIndex> wrap; // null: not built yet
+        std::unique_ptr<FoldIndex> folds;
+        bool selecting {false};
+        int anchor_cx {1};
+        int anchor_cy {1};
+        bool block {false};
+        int block_anchor_col {0};
+        int block_col {0};
+        std::vector<Cursor> cursors;
+    };
+    void swap_view(ViewState& v);
+    // Open buffers. The current one lives in the members above (buffer_, search_matches_, ...),
+    // docs_[doc_] is its empty slot; the others are parked in their slots. Switching swaps the
+    // members with a slot, so it costs the same for any file size.
+    struct Document {
+        std::unique_ptr<Buffer> buffer;
+        std::unique_ptr<FileFollower> follow;
+        std::unique_ptr<Journal> journal;
+        std::unique_ptr<BracketIndex> brackets;
+        std::unique_ptr<WordIndex> words;
+        std::string filename;
+        bool modified {false};
+        uint64_t file_bytes {0};
+        std::string search_query;
+        std::vector<Match> search_matches;
+        int search_index {-1};
+        ViewState view; // where it was left when a pane switched to another buffer
+    };
+    void swap_document(Document& d);
+    std::vector<Document> docs_;
+    size_t doc_ {0};
+    // Split panes, each a view of one of the buffers; several can show the same Buffer (and share
+    // its lines in layouts_). The focused pane's view is in the members, panes_[pane_] is its slot.
+    // render() focuses every pane in turn to draw it into its part of the one frame.
+    struct Pane {
+        size_t doc {0};
+        ViewState view;
+        int drawn_row_off {-1};
+    };
+    void focus_pane(size_t pane);
+    void split_pane(bool vertical);
+    void close_pane();
+    // Rows between header and status line, and the part of them the focused pane's text gets
+    // (with several panes, each one has a title row below its text)
+    PaneRect text_area() const;
+    PaneRect pane_rect() const;
+    void render_pane(const PaneRect& rect, bool focused, int& cur_row, int& cur_col);
+    std::unique_ptr<PaneLayout> layout_;
+    std::vector<Pane> panes_;
+    size_t pane_ {0};
+    std::vector<PaneLayout::Placed> placed_scratch_;
+    std::vector<PaneRect> divider_scratch_;
     // Clipboard (internal)
     std::string clipboard_;
+    // Per-row scratch space of render, kept so drawing unchanged lines does not allocate
+    std::vector<std::pair<int, int>> span_scratch_;
+    std::vector<std::pair<int, int>> merged_scratch_;
+    std::vector<SyntaxHighlight> highlight_scratch_;
+    // Frame pacing: input marks the view dirty, run() draws at most frame_hz_ frames per second
+    // while keys keep coming and right away once the input goes quiet
+    bool dirty_ {true};
+    int frame_hz_ {120};
+    // --record / --replay: per key latency of every phase, reported on exit
+    std::unique_ptr<KeyLatency> latency_;
+    std::chrono::steady_clock::duration flush_time_ {}; // end_frame + flush of the last render
     // Debugging/status helpers
     std::string last_key_info_;
 };
@@ -6,6 +6,9 @@ namespace termite { class Buffer; }
 namespace termite::file_io {
 
 std::string read_file(const std::string& path);
+// Binary file sniff: a NUL byte in the first few KB (like git and grep), reads only those.
+// Only regular files are sniffed, so a pipe keeps its data for read_file.
+bool looks_binary(const std::string& path);
 bool save_file(const Buffer& buffer, const std::string& path);
 
 }
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace termite {
+
+// Read-only view of a file of any size (--view). The file is read through one sliding window,
+// only the line starts around the viewport are kept, and a background thread counts the lines,
+// leaving a fixed number of checkpoints behind. Memory use does not depend on the file size.
+// Line numbers past the part counted so far are estimated from the byte offset.
+// The window is read (pread), not mapped: a log truncated while it is viewed (copytruncate) ends
+// the view early instead of faulting on pages past the new end of the file.
+class FileView {
+public:
+    static constexpr uint64_t npos = ~uint64_t{0};
+    static constexpr size_t WINDOW_BYTES = size_t{1} << 18; // read at a time
+    static constexpr size_t MAX_LINE = size_t{64} << 10;    // longer lines are shown cut
+    static constexpr size_t LINE_CACHE = 16384;             // line starts kept around the top
+    static constexpr size_t CHECKPOINTS = 4096;             // line counts at fixed byte strides
+
+    FileView() = default;
+    ~FileView();
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    // Open and start counting lines in the background (unless with_lines is false: only bytes()
+    // is used then, e.g. by the hex view); false if the file cannot be read.
+    bool open(const std::string& path, bool with_lines = true);
+    uint64_t size() const { return size_; }
+    // The file turned out shorter than at open (or a read failed): size() is down to what could
+    // still be read, lines and bytes past it are gone from the view
+    bool shrank() const { return shrank_; }
+
+    // Byte offset of the line at the top of the viewport
+    uint64_t top() const { return starts_[top_]; }
+    // Start of the i-th line below the top, npos past the end of the file
+    uint64_t row(size_t i);
+    // Move the top by n lines (up if negative). Moving down stops once the line after the last
+    // of `rows` visible lines would be past the end. Returns the lines actually moved.
+    int64_t scroll(int64_t n, size_t rows);
+    // Put the line containing byte off at the top, O(window) no matter where off is.
+    void jump(uint64_t off);
+    // Put line (0-based) at the top: exact where the count got to, estimated beyond
+    void jump_line(uint64_t line);
+    // Last `rows` lines on screen
+    void jump_end(size_t rows);
+
+    // Text of the line starting at start without its line ending, at most MAX_LINE bytes.
+    // Points into the window, valid until the next call on the view.
+    std::string_view line(uint64_t start);
+
+    // File bytes [off, off + n), cut at the end of the file; n <= WINDOW_BYTES / 2.
+    // Points into the window, valid until the next call on the view.
+    std::string_view bytes(uint64_t off, size_t n);
+
+    // Line number (0-based) of the top line; exact tells whether it was counted or estimated
+    uint64_t top_line(bool& exact);
+    // Lines in the file, estimated until the background count is done
+    uint64_t line_count(bool& exact) const;
+    // Share of the file the background count has covered, 0..1
+    double count_progress() const;
+
+private:
+    // Pointer to file bytes [off, off + n), reads the window if needed (n <= WINDOW_BYTES / 2).
+    // Bytes past the end of a file that shrank read as 0.
+    const char* map(uint64_t off, size_t n);
+    // Bytes read at off into buf, short at the end of the file or on an error
+    size_t read_at(uint64_t off, char* buf, size_t n) const;
+    uint64_t next_line(uint64_t start);
+    // Start of the line containing byte off
+    uint64_t line_start(uint64_t off);
+    uint64_t count_newlines(uint64_t from, uint64_t to);
+    // Number of the line starting at start: counted from a checkpoint, or estimated
+    uint64_t number_at(uint64_t start, bool& exact);
+    double bytes_per_line() const;
+    void count_lines(std::string path, uint64_t size);
+    void trim();
+
+    uint64_t size_ {0};
+    bool shrank_ {false};
+    intptr_t file_ {-1};       // fd, or HANDLE on Windows
+    std::vector<char> window_; // file bytes [win_off_, win_off_ + win_len_)
+    uint64_t win_off_ {0};
+    size_t win_len_ {0};
+
+    std::deque<uint64_t> starts_ {0}; // consecutive line starts, starts_[top_] is the top line
+    size_t top_ {0};
+    uint64_t top_line_ {0};
+    bool top_exact_ {true};
+
+    // Background line count. checkpoints_[k] is the number of newlines before k * stride_,
+    // written before scanned_ moves past it.
+    std::thread counter_;
+    std::atomic<bool> stop_ {false};
+    std::atomic<uint64_t> scanned_ {0};
+    std::atomic<uint64_t> newlines_ {0};
+    std::atomic<bool> counted_ {false};
+    uint64_t total_lines_ {0};
+    uint64_t stride_ {0};
+    std::array<uint64_t, CHECKPOINTS> checkpoints_ {};
+};
+
+} // namespace termite
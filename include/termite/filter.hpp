@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "termite/buffer.hpp"
+
+namespace termite {
+
+// Runs a shell command over lines of a buffer ("filter"): the lines go to its stdin, its stdout
+// comes back as lines. Input is written straight from a snapshot of the buffer, so nothing is
+// copied on the way in, and output is split into lines as it arrives. All pipes are non-blocking
+// and pump() never waits longer than it is told to, so the editor keeps drawing and reading keys
+// (and can cancel) while a command works through hundreds of MB.
+// Not available on Windows: start() fails there.
+class FilterProcess {
+public:
+    enum class State { Running, Done, Failed };
+
+    FilterProcess() = default;
+    ~FilterProcess(); // a command still running is killed
+    FilterProcess(const FilterProcess&) = delete;
+    FilterProcess& operator=(const FilterProcess&) = delete;
+
+    // Start `sh -c command` with lines [first, first + count) of input as its stdin
+    bool start(const std::string& command, Snapshot input, size_t first, size_t count);
+    // Move what the pipes take / have for up to budget. Done: the command exited with status 0
+    // and lines() holds all of its output. Failed: see error().
+    State pump(std::chrono::milliseconds budget);
+    // Kill the command and everything it started
+    void cancel();
+
+    size_t first() const { return first_; }
+    size_t count() const { return count_; }
+    uint64_t bytes_in() const { return bytes_in_; }
+    uint64_t bytes_out() const { return bytes_out_; }
+    // Output lines so far, without their line endings; a last line without one counts too
+    std::vector<std::string>& lines() { return lines_; }
+    // Why it failed: exit status and the first line the command wrote to stderr
+    const std::string& error() const { return error_; }
+
+private:
+    void feed();
+    void drain(int& fd, bool keep);
+    void close_fd(int& fd);
+    State finish(int status);
+
+    Snapshot input_;
+    size_t first_ {0};
+    size_t count_ {0};
+    size_t next_row_ {0};  // next line to write, and how much of it (with its '\n') went out
+    size_t next_col_ {0};
+    std::vector<std::string> lines_;
+    std::string partial_;  // output after the last '\n'
+    std::string stderr_;   // kept up to a few KB
+    std::string error_;
+    uint64_t bytes_in_ {0};
+    uint64_t bytes_out_ {0};
+    int pid_ {-1};
+    int in_ {-1};  // the command's stdin, written by us
+    int out_ {-1};
+    int err_ {-1};
+};
+
+} // namespace termite
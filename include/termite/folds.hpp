@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "termite/line_seq.hpp"
+
+namespace termite {
+
+class Buffer;
+struct LineEdit;
+
+// Folded line ranges of one view of a buffer. A fold keeps its first line (the header) on screen
+// and hides the lines after it up to its last one; folds may nest or overlap.
+// The folds are kept sorted by first line with the highest last line of every subtree on top
+// (an interval tree), so the folds around a line are found in O(log n + found). Every line counts
+// the folds hiding it in a LineSeq whose tree sums up the visible lines, which maps screen row <->
+// line in O(log n) and takes inserted or removed lines without a pass over the others.
+// Without folds nothing is kept and the mapping is the identity.
+class FoldIndex {
+public:
+    struct Fold {
+        size_t first; // header, stays visible
+        size_t last;  // last hidden line
+    };
+
+    // Follow the edits made since the last call: folds move with the lines around them, a fold
+    // whose lines were edited structurally (lines inserted into it, its header removed) opens.
+    void sync(const Buffer& buf);
+    // Close a fold over first..last; false if it hides nothing or is closed already
+    bool fold(const Buffer& buf, size_t first, size_t last);
+    // Replace all folds by these (sorted by first line, e.g. the top-level regions)
+    void fold_all(const Buffer& buf, std::vector<Fold> folds);
+    // Open the folds headed by row; false if there are none
+    bool unfold(size_t row);
+    // Open every fold that hides row
+    void reveal(size_t row);
+    void clear();
+
+    bool empty() const { return folds_.empty(); }
+    size_t count() const { return folds_.size(); }
+    bool hidden(size_t line) const { return line < hidden_.size() && hidden_[line] != 0; }
+    // Lines hidden under row by the folds it heads (0: not the header of a closed fold)
+    size_t folded_below(size_t row) const;
+    // Bumped whenever the set of hidden lines changes (the wrap index recounts then)
+    uint64_t version() const { return version_; }
+
+    size_t visible_lines() const;
+    // Visible lines before line, i.e. the screen row of a visible line
+    size_t row_of_line(size_t line) const;
+    // Visible line at screen row vrow, the line count for rows past the end
+    size_t line_at(size_t vrow) const;
+    size_t next_visible(size_t line) const { return line_at(row_of_line(line) + 1); }
+
+private:
+    struct Visible {
+        int64_t n;
+
+        static Visible of(uint32_t hidden) { return {hidden == 0 ? 1 : 0}; }
+        friend Visible operator+(Visible a, Visible b) { return {a.n + b.n}; }
+    };
+
+    void attach(const Buffer& buf);
+    // Lines [e.row, e.row + e.removed) became e.added new ones: open the folds the edit reaches
+    // into, move the ones after it. True if folds were opened.
+    bool follow(const LineEdit& e);
+    // Count folds per line, sort the folds and build the interval tree again
+    void rebuild();
+    void rebuild_intervals();
+    // Add delta to the fold counts of first+1..last
+    void hide(size_t first, size_t last, int delta);
+    // Index of the first fold that starts at or after row
+    size_t first_from(size_t row) const;
+    // Indices of the folds with first < row <= last
+    void covering(size_t node, size_t lo, size_t hi, size_t row, size_t end, std::vector<size_t>& out) const;
+    // Open the folds at these indices, without the version bump
+    void drop(std::vector<size_t>& which);
+    void remove(std::vector<size_t>& which);
+
+    uint64_t revision_ {0};
+    uint64_t version_ {0};
+    size_t lines_ {0};
+    std::vector<Fold> folds_;       // sorted by first, then by last descending
+    std::vector<size_t> max_last_;  // segment tree over folds_: highest last in every node
+    size_t leaves_ {1};
+    LineSeq<uint32_t, Visible> hidden_; // folds hiding each line
+};
+
+} // namespace termite
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace termite {
+
+// Follows a growing file (tail -f): hands out only the bytes appended since the last look.
+// On Linux an inotify watch tells when the file was written, so an idle poll is one read() that
+// returns nothing; elsewhere the size is looked at on every poll. The name is followed, not the
+// file: a watch on its directory sees a new file created (or moved) in place of a rotated one.
+class FileFollower {
+public:
+    enum class Change { None, Appended, Truncated, Rotated };
+
+    FileFollower() = default;
+    ~FileFollower();
+    FileFollower(const FileFollower&) = delete;
+    FileFollower& operator=(const FileFollower&) = delete;
+
+    // Follow path from byte offset `from` on (what is already loaded)
+    bool start(const std::string& path, uint64_t from);
+    // Non-blocking. Appended: out holds up to max bytes following the last ones handed out.
+    // Truncated: the file got shorter than what was read (rotated by truncation), reload it.
+    // Rotated: another file has the name now (rotated by rename or delete and create), reload it.
+    Change poll(std::string& out, size_t max);
+    // More appended bytes than the last poll could take
+    bool pending() const { return offset_ < size_; }
+    // The editor wrote the file itself: continue from its current end
+    void skip_to_end();
+
+private:
+    bool changed();
+    bool replaced() const;
+    uint64_t file_size() const;
+
+    std::string path_;
+    std::string name_; // the file name in its directory, for the directory's events
+    std::ifstream in_;
+    uint64_t offset_ {0}; // bytes handed out
+    uint64_t size_ {0};   // file size at the last change
+    uint64_t dev_ {0};    // the file in_ reads, told apart from one put in its place
+    uint64_t ino_ {0};
+    int inotify_ {-1};
+    int dir_watch_ {-1};
+};
+
+} // namespace termite
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace termite::headless {
+
+// One character cell of the virtual terminal. A wide glyph owns its cell and leaves the next one
+// empty (text == "").
+struct Cell {
+    std::string text {" "};
+    int fg {-1}; // 256 color index, -1 = default
+    int bg {-1};
+    bool bold {false};
+    bool reverse {false};
+};
+
+// In-memory terminal: understands the subset of VT/xterm sequences Screen emits (cursor moves,
+// erase, SGR colors, scroll regions + SU/SD, cursor visibility, synchronized output) and keeps
+// the resulting grid. Also plays the keyboard: scripted keys are handed out one key at a time,
+// with an idle moment after each, so the editor sees the same input pattern as with a person typing.
+class Terminal {
+public:
+    Terminal(int rows, int cols);
+
+    // Terminal side: output of the editor
+    void feed(std::string_view bytes);
+    void resize(int rows, int cols);
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    // 0-based
+    const Cell& cell(int row, int col) const { return grid_[static_cast<size_t>(row * cols_ + col)]; }
+    std::string row_text(int row) const;
+    int cursor_row() const { return cur_row_; }
+    int cursor_col() const { return cur_col_; }
+    bool cursor_visible() const { return cursor_visible_; }
+
+    // Totals since construction: bytes fed, write calls (one per flushed frame), synchronized updates
+    size_t bytes() const { return bytes_; }
+    size_t writes() const { return writes_; }
+    size_t sync_frames() const { return sync_frames_; }
+
+    // Keyboard side: bytes of one key (e.g. "\x1b[B"); push_text queues every character as its own key.
+    void push_key(std::string bytes);
+    void push_text(std::string_view text);
+    bool keys_left() const { return !keys_.empty() || !current_.empty(); }
+    // Type Ctrl-Q once the script is used up (default). Off when the keys come from elsewhere,
+    // e.g. a --replay log, then the keyboard just stays quiet.
+    void set_quit_at_end(bool on) { quit_at_end_ = on; }
+
+    // Used by the headless platform layer. When the script is used up the terminal types Ctrl-Q,
+    // so Editor::run returns (scripts should not end inside a prompt).
+    bool input_pending();
+    int read_byte();
+
+private:
+    void put(std::string_view glyph, int width);
+    void csi(char final, std::string_view params, bool priv);
+    void line_feed();
+    void scroll_up(int top, int bottom, int n);
+    void scroll_down(int top, int bottom, int n);
+    void erase(int row, int c0, int c1);
+    Cell& at(int row, int col) { return grid_[static_cast<size_t>(row * cols_ + col)]; }
+
+    int rows_;
+    int cols_;
+    std::vector<Cell> grid_;
+    int cur_row_ {0};
+    int cur_col_ {0};
+    bool wrap_pending_ {false};
+    bool cursor_visible_ {true};
+    int top_ {0};    // scroll region, 0-based inclusive
+    int bottom_;
+    Cell pen_;       // attributes for new text
+    std::string pending_; // incomplete sequence from the last feed
+    size_t bytes_ {0};
+    size_t writes_ {0};
+    size_t sync_frames_ {0};
+
+    std::deque<std::string> keys_;
+    std::string current_; // rest of the key being read
+    bool idle_reported_ {true};
+    bool quit_at_end_ {true};
+};
+
+// The terminal the headless platform layer talks to (nullptr: none, reads return -1)
+void attach(Terminal* term);
+Terminal* attached();
+
+// Split a byte string into keys: escape sequences, UTF-8 characters and single bytes
+std::vector<std::string> split_keys(std::string_view bytes);
+
+} // namespace termite::headless
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <string>
+
 namespace termite::input {
 
 // Key codes (very small subset yet)
 enum : int {
+    KEY_CTRL_SPACE = 0,
     KEY_CTRL_A = 1,
     KEY_CTRL_B = 2,
     KEY_CTRL_D = 4,
@@ -31,6 +34,8 @@ enum : int {
     KEY_CTRL_DOWN = 1104,
     KEY_CTRL_HOME = 1105,
     KEY_CTRL_END = 1106,
+    KEY_CTRL_PAGE_UP = 1107,
+    KEY_CTRL_PAGE_DOWN = 1108,
     KEY_CTRL_V = 22,
     KEY_CTRL_F = 6,
     KEY_SHIFT_LEFT = 1201,
@@ -41,10 +46,27 @@ enum : int {
     KEY_CTRL_SHIFT_RIGHT = 1206,
     KEY_CTRL_SHIFT_UP = 1207,
     KEY_CTRL_SHIFT_DOWN = 1208,
+    KEY_ALT_UP = 1301,
+    KEY_ALT_DOWN = 1302,
+    KEY_ALT_SHIFT_UP = 1303,
+    KEY_ALT_SHIFT_DOWN = 1304,
+    KEY_ALT_SHIFT_RIGHT = 1305,
+    KEY_ALT_SHIFT_LEFT = 1306,
     KEY_CTRL_K = 11,
+    KEY_CTRL_W = 23,
+    KEY_CTRL_X = 24,
     KEY_F2 = 2002,
 };
 
 int read_key();
 
+// True if a key arrives within timeout_ms (0 = don't wait, -1 = wait forever)
+bool key_pending(int timeout_ms);
+
+// Key log for reproducing sessions: record_to writes every key read_key returns with its time,
+// replay_from makes read_key return the keys of such a file at their recorded times instead of
+// reading the terminal (Ctrl-Q on the real keyboard stops it, the end of the file quits).
+bool record_to(const std::string& path);
+bool replay_from(const std::string& path);
+
 }
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "termite/buffer.hpp"
+
+namespace termite {
+
+// Crash-recovery journal of one file: every edit of the buffer is appended to a side file
+// (.NAME.termite-journal next to it), so unsaved work survives a crash or a dropped session.
+//
+// Records are encoded on the UI thread into the pending batch (a mutex and a string append).
+// A writer thread appends whole batches as checksummed frames and syncs them to disk (group
+// commit): typing never waits for the disk, and a crash loses at most the last batch.
+// The records apply to one version of the saved file, named in the header. Saving starts the
+// journal over; when it has grown large it is replaced by one snapshot of the contents.
+// The journal gets the permission bits of the file, and a session holds a lock on it (a .lock file
+// next to it, released by the system if the session dies) so a second one neither replays nor
+// truncates a live journal.
+class Journal : public BufferObserver {
+public:
+    // Version of the saved file the records apply to
+    struct Base {
+        uint64_t size {0};
+        uint64_t mtime {0}; // ns since the file clock epoch
+        bool operator==(const Base&) const = default;
+    };
+
+    struct Recovery {
+        bool found {false};     // there is a journal for the file
+        bool matches {false};   // and it was written against this version of it
+        size_t records {0};     // records replayed
+        uint64_t valid_bytes {0}; // journal length up to the last intact frame
+    };
+
+    static std::string path_for(const std::string& file);
+    static Base base_of(const std::string& file);
+    // Replay the journal a previous session left for file onto buf, which holds the file as loaded.
+    // A torn last frame (crash while writing) ends the replay.
+    static Recovery recover(const std::string& file, Buffer& buf);
+
+    // Take the lock of file's journal, before recover() and open(); false if another session
+    // holds it (it is editing the same file). Released when the journal is destroyed.
+    bool lock(const std::string& file);
+
+    Journal() = default;
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Journal the edits of file from now on. keep_bytes: part of an existing journal to continue
+    // (Recovery::valid_bytes), 0 to start a new one. The side file is created with the first edit.
+    void open(const std::string& file, uint64_t keep_bytes);
+    void applied(const BufferOp& op) override;
+    // The file was saved: records so far are obsolete, the next ones apply to the new version
+    void checkpoint();
+    // Records since the last checkpoint outweigh the contents, compact() would shrink the journal
+    bool wants_compaction() const;
+    // Replace the journal by one snapshot of the contents, written by the writer thread
+    void compact(Snapshot contents, const FileFormat& format);
+    // Nothing left to recover (clean exit): stop and delete the side file
+    void discard();
+    // A write failed, the journal stopped
+    bool failed() const { return failed_.load(std::memory_order_relaxed); }
+
+private:
+    void writer_loop();
+    bool write_frame(std::FILE* f, const std::string& payload);
+    // One frame with a CONTENTS record of snap, text_bytes receives the length of its text
+    bool write_contents(std::FILE* f, const Snapshot& snap, const FileFormat& format, uint64_t& text_bytes);
+    void stop();
+
+    std::string file_;
+    std::string path_;
+    std::thread writer_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    // shared with the writer, under mu_
+    std::string pending_;                 // encoded records of the next batch
+    bool stop_ {false};
+    bool reset_ {false};                  // checkpoint: drop the side file, new base
+    bool compact_ {false};                // compaction requested, of compact_snap_
+    Snapshot compact_snap_;
+    FileFormat compact_format_;
+    Base base_;
+    uint32_t mode_ {0600}; // permission bits of the side file
+    uint64_t keep_bytes_ {0};
+    // writer thread only
+    std::FILE* out_ {nullptr};
+    // records since the last checkpoint or compaction, and the size of what they apply to
+    std::atomic<uint64_t> record_bytes_ {0};
+    std::atomic<uint64_t> contents_bytes_ {0};
+    std::atomic<bool> failed_ {false};
+    int lock_fd_ {-1};
+    std::string lock_path_;
+};
+
+} // namespace termite
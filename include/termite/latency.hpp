@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace termite {
+
+// Log-linear histogram of durations in nanoseconds: 32 buckets per power of two (~3% error),
+// fixed size, adding a sample never allocates.
+class LatencyHistogram {
+public:
+    void add(uint64_t ns);
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    // Upper bound of the bucket holding quantile q (0..1)
+    uint64_t percentile(double q) const;
+
+private:
+    static constexpr int SUB_BITS = 5;
+    static constexpr uint64_t SUB = 1u << SUB_BITS;
+    std::array<uint64_t, 64 * SUB> buckets_ {};
+    uint64_t count_ {0};
+    uint64_t max_ {0};
+};
+
+// Where the time goes between reading a key and the frame that shows it (--record / --replay).
+// Keys coalesced into one frame all get that frame's render and flush time.
+class KeyLatency {
+public:
+    using clock = std::chrono::steady_clock;
+    enum Phase { Decode, Handle, Render, Flush, Total, PhaseCount };
+
+    void key(clock::time_point read_start, clock::duration decode, clock::duration handle);
+    void frame(clock::duration render, clock::duration flush, clock::time_point end);
+    // p50 / p99 / p999 / max of every phase, one line each
+    std::string report() const;
+
+private:
+    std::array<LatencyHistogram, PhaseCount> phases_;
+    std::vector<clock::time_point> waiting_; // keys read since the last frame
+};
+
+} // namespace termite
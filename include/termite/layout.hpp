@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "termite/syntax.hpp"
+
+namespace termite {
+
+class Buffer;
+
+inline constexpr int TAB_WIDTH = 4;
+
+// Display layout of one line: where every grapheme starts, in bytes and in screen columns,
+// plus the text as the terminal should show it (tabs as spaces, control bytes as ^X).
+struct LineLayout {
+    uint64_t stamp {0};
+    bool plain {true};     // printable ASCII only: byte index == column, line is its own display text
+    int width {0};         // display columns of the whole line
+    std::vector<int> bytes; // grapheme start offsets + line size as sentinel
+    std::vector<int> cols;  // display column of every grapheme + width as sentinel
+    std::string text;       // display text (not plain lines only)
+    std::vector<int> text_off; // byte in text where each column starts, -1 inside a wide glyph, + end entry
+    // Syntax spans of the line in display columns, filled by render on first use
+    std::vector<SyntaxHighlight> syntax;
+    bool syntax_valid {false};
+    // Soft wrap: first column of every visual row for wrap_width (0 = not computed)
+    int wrap_width {0};
+    std::vector<int> wrap_starts;
+    uint64_t last_used {0};
+
+    // Column of the first grapheme starting at or after byte (bytes inside a grapheme round up).
+    int col_of(int byte) const;
+    // Start byte of the grapheme covering col; line size for columns past the end.
+    int byte_at(int col) const;
+    // Byte in the display text where column col starts (col must be a glyph start).
+    int offset(int col) const { return plain ? col : text_off[static_cast<size_t>(col)]; }
+};
+
+// Part of a line that fits in a column window. text shows columns [c0, c1) and needs
+// lead / trail spaces around it where a wide glyph is cut by the window edge.
+struct VisibleText {
+    int lead {0};
+    int c0 {0};
+    int c1 {0};
+    std::string_view text;
+    int trail {0};
+};
+
+void build_layout(const std::string& line, LineLayout& out);
+
+// Columns [c0, c1) of the line as a view into the layout (or the line itself), no copy.
+VisibleText visible_text(const std::string& line, const LineLayout& lay, int c0, int c1);
+
+// Layouts keyed by line stamp (identity + version), so lines moving up or down keep their entry
+// and an edited line simply gets a new one.
+class LayoutCache {
+public:
+    const LineLayout& get(const Buffer& buf, size_t row) { return get_mut(buf, row); }
+    LineLayout& get_mut(const Buffer& buf, size_t row);
+    // Start of a frame: drop entries that were not used recently once the cache grew large.
+    // Call between frames only, references from get() are stable until then.
+    void trim();
+    void clear() { entries_.clear(); }
+
+private:
+    std::unordered_map<uint64_t, LineLayout> entries_;
+    uint64_t frame_ {0};
+};
+
+} // namespace termite
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "termite/buffer.hpp"
+#include "termite/line_seq.hpp"
+#include "termite/syntax.hpp"
+
+namespace termite {
+
+// Per-line lexer results of an index that follows the buffer (brackets, words): a LineSeq of Line
+// values, each with the state the line was lexed in (`in`), the one it ends in (`out`) and the stamp
+// of the text it was lexed from (`stamp`, 0 = not lexed yet).
+// sync() follows the buffer's edit log: removed lines are dropped, inserted and edited lines are
+// noted as ranges that move with the later edits (no pass over the other lines), then lexed again
+// in order, going on past them only while the state at the start of the next line changes (a block
+// comment opened or closed).
+template <class Line, class Summary>
+class LexedLines {
+public:
+    // lex(line, text, in) fills in what the index keeps of text lexed from state in and returns the
+    // state at its end; drop(line) is called for a line that is removed or about to be lexed again.
+    // Lexes everything the first time and when the edit log does not reach back far enough.
+    template <class Lex, class Drop>
+    void sync(const Buffer& buf, Lex&& lex, Drop&& drop);
+
+    const LineSeq<Line, Summary>& lines() const { return lines_; }
+    size_t size() const { return lines_.size(); }
+    LexState state_before(size_t row) const { return row == 0 ? LexState::Code : lines_[row - 1].out; }
+
+private:
+    struct Range {
+        size_t first;
+        size_t last; // exclusive
+    };
+
+    template <class Lex, class Drop>
+    void reset(const Buffer& buf, Lex& lex, Drop& drop);
+    // Lines [row, row + removed) became `added` new ones: the dirty ranges after them move along
+    void shift(size_t row, size_t removed, size_t added);
+
+    bool built_ {false};
+    uint64_t revision_ {0};
+    LineSeq<Line, Summary> lines_;
+    std::vector<Range> dirty_; // lines to lex again, during sync()
+    std::vector<Range> moved_;
+};
+
+template <class Line, class Summary>
+template <class Lex, class Drop>
+void LexedLines<Line, Summary>::reset(const Buffer& buf, Lex& lex, Drop& drop) {
+    lines_.update(0, lines_.size(), [&](size_t, Line& l) { drop(l); });
+    lines_.clear();
+    LexState state = LexState::Code;
+    size_t row = 0;
+    buf.snapshot().for_each_line([&](const std::string& text) {
+        Line l{};
+        l.in = state;
+        l.out = state = lex(l, text, state);
+        l.stamp = buf.line_stamp(row++);
+        lines_.push_back(std::move(l));
+    });
+    lines_.settle();
+    built_ = true;
+    revision_ = buf.revision();
+}
+
+template <class Line, class Summary>
+void LexedLines<Line, Summary>::shift(size_t row, size_t removed, size_t added) {
+    size_t end = row + removed;
+    moved_.clear();
+    for (const Range& r : dirty_) {
+        // the part before the edit stays, the part after it moves, the part inside it is gone
+        if (r.first < row) moved_.push_back({r.first, std::min(r.last, row)});
+        if (r.last > end) moved_.push_back({std::max(r.first, end) - removed + added, r.last - removed + added});
+    }
+    dirty_.swap(moved_);
+}
+
+template <class Line, class Summary>
+template <class Lex, class Drop>
+void LexedLines<Line, Summary>::sync(const Buffer& buf, Lex&& lex, Drop&& drop) {
+    if (built_ && buf.revision() == revision_) return;
+    std::vector<LineEdit> edits;
+    if (!built_ || !buf.edits_since(revision_, edits)) {
+        reset(buf, lex, drop);
+        return;
+    }
+    dirty_.clear();
+    for (const auto& e : edits) {
+        if (e.removed == 0 && e.added == 0) {
+            dirty_.push_back({e.row, e.row + e.changed});
+            continue;
+        }
+        lines_.update(e.row, e.removed, [&](size_t, Line& l) { drop(l); });
+        lines_.splice(e.row, e.removed, e.added, Line{});
+        shift(e.row, e.removed, e.added);
+        // the new lines, and the one after them: it may start in another state now
+        dirty_.push_back({e.row, e.row + e.added + 1});
+    }
+    revision_ = buf.revision();
+    if (lines_.size() != buf.line_count()) {
+        reset(buf, lex, drop);
+        return;
+    }
+    std::sort(dirty_.begin(), dirty_.end(), [](const Range& a, const Range& b) { return a.first < b.first; });
+    // lex again what changed, and go on past a range while the next line starts in another state
+    size_t done = 0; // lines below this are up to date
+    for (const Range& r : dirty_) {
+        for (size_t row = std::max(r.first, done); row < lines_.size(); ++row) {
+            LexState in = state_before(row);
+            const Line& old = lines_[row];
+            bool same = old.in == in && old.stamp == buf.line_stamp(row);
+            if (same && row >= r.last) break;
+            done = row + 1;
+            if (same) continue;
+            Line& l = lines_.mut(row);
+            drop(l);
+            l.in = in;
+            l.out = lex(l, buf.line(row), in);
+            l.stamp = buf.line_stamp(row);
+        }
+    }
+    lines_.settle();
+}
+
+} // namespace termite
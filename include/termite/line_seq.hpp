@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace termite {
+
+// Per-line values of an index that follows the buffer (wrap rows, bracket balances, ...), kept in
+// chunks of lines like the buffer's line tree. A segment tree over the chunks holds the line count
+// and the summary of every subtree: a row is found in O(log n), inserting or removing lines rewrites
+// one chunk, and searches over the summaries go down the tree instead of along the lines.
+// Summary is a monoid over the values: Summary{} is the empty run, a + b joins two runs in order
+// and Summary::of(value) is one line. Values changed with mut() or update() are summed up again by
+// settle(), once per chunk; the summary queries expect a settled sequence.
+template <class T, class Summary>
+class LineSeq {
+public:
+    static constexpr size_t NONE = SIZE_MAX;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T& operator[](size_t row) const {
+        size_t c, o;
+        locate(row, c, o);
+        return chunks_[c].items[o];
+    }
+    // Value of row for changing it, its chunk is summed up again by settle()
+    T& mut(size_t row);
+    // fn(row, value) for every line of [first, first + count), for changing them
+    template <class F>
+    void update(size_t first, size_t count, F&& fn);
+
+    void clear();
+    void assign(size_t n, const T& value);
+    // Building line by line (first load); settle() before anything else
+    void push_back(T value);
+    // Lines [row, row + removed) become `added` copies of fill
+    void splice(size_t row, size_t removed, size_t added, const T& fill);
+    void settle();
+
+    Summary total() const { return tree_.empty() ? Summary{} : tree_[1].sum; }
+    // Summary of lines [0, row)
+    Summary prefix(size_t row) const;
+    // Walk the lines from `from` on: enter(s) is asked whether the line looked for is in a run of lines
+    // with summary s (a subtree, then single lines); runs it is not in are handed to pass(s), in order.
+    // Returns the line it enters, NONE if none. seek_backward walks from `to` (inclusive) down.
+    template <class Enter, class Pass>
+    size_t seek_forward(size_t from, Enter&& enter, Pass&& pass) const;
+    template <class Enter, class Pass>
+    size_t seek_backward(size_t to, Enter&& enter, Pass&& pass) const;
+
+private:
+    // Lines per chunk when they are cut anew, a chunk is split once it grows past twice that
+    static constexpr size_t CHUNK = 256;
+
+    struct Chunk {
+        std::vector<T> items;
+        Summary sum {};
+        bool stale {true}; // sum not up to date
+    };
+    struct Node {
+        size_t count {0};
+        Summary sum {};
+    };
+
+    void locate(size_t row, size_t& chunk, size_t& offset) const;
+    size_t start_of(size_t chunk) const;
+    void touch(size_t chunk);
+    void recount(size_t chunk);
+    void index();
+    void rebuild_tree();
+    template <class Enter, class Pass>
+    size_t descend_forward(size_t node, size_t lo, size_t hi, size_t from, Enter& enter, Pass& pass) const;
+    template <class Enter, class Pass>
+    size_t descend_backward(size_t node, size_t lo, size_t hi, size_t to, Enter& enter, Pass& pass) const;
+
+    std::vector<Chunk> chunks_;
+    size_t size_ {0};
+    std::vector<Node> tree_; // segment tree over chunks_, leaves from leaves_ on
+    size_t leaves_ {1};
+    std::vector<size_t> stale_;
+    bool rebuild_ {false}; // chunks were added or removed since the tree was built
+};
+
+// Summary of values that are only looked up by row
+struct NoSummary {
+    template <class T>
+    static NoSummary of(const T&) { return {}; }
+    friend NoSummary operator+(NoSummary, NoSummary) { return {}; }
+};
+
+template <class T, class Summary>
+void LineSeq<T, Summary>::locate(size_t row, size_t& chunk, size_t& offset) const {
+    if (row >= size_) {
+        chunk = chunks_.empty() ? 0 : chunks_.size() - 1;
+        offset = chunks_.empty() ? 0 : chunks_.back().items.size();
+        return;
+    }
+    size_t node = 1;
+    while (node < leaves_) {
+        if (row < tree_[2 * node].count) {
+            node = 2 * node;
+        } else {
+            row -= tree_[2 * node].count;
+            node = 2 * node + 1;
+        }
+    }
+    chunk = node - leaves_;
+    offset = row;
+}
+
+template <class T, class Summary>
+size_t LineSeq<T, Summary>::start_of(size_t chunk) const {
+    size_t start = 0;
+    for (size_t i = leaves_ + chunk; i > 1; i /= 2)
+        if (i & 1) start += tree_[i - 1].count;
+    return start;
+}
+
+template <class T, class Summary>
+void LineSeq<T, Summary>::touch(size_t chunk) {
+    if (chunks_[chunk].stale) return;
+    chunks_[chunk].stale = true;
+    stale_.push_back(chunk);
+}
+
+template <class T, class Summary>
+void LineSeq<T, Summary>::recount(size_t chunk) {
+    size_t i = leaves_ + chunk;
+    tree_[i].count = chunks_[chunk].items.size();
+    for (i /= 2; i > 0; i /= 2) tree_[i].count = tree_[2 * i].count + tree_[2 * i + 1].count;
+}
+
+template <class T, class Summary>
+void LineSeq<T, Summary>::index() {
+    if (rebuild_) rebuild_tree();
+}
+
+template <class T, class Summary>
+void LineSeq<T, Summary>::rebuild_tree() {
+    leaves_ = 1;
+    while (leaves_ < chunks_.size()) leaves_ *= 2;
+    tree_.assign(2 * leaves_, Node{});
+    stale_.clear();
+    for (size_t c = 0; c < chunks_.size(); ++c) {
+        tree_[leaves_ + c] = Node{chunks_[c].items.size(), chunks_[c].sum};
+        if (chunks_[c].stale) stale_.push_back(c);
+    }
+    for (size_t i = leaves_ - 1; i > 0; --i)
+        tree_[i] = Node{tree_[2 * i].count + tree_[2 * i + 1].count, tree_[2 * i].sum + tree_[2 * i + 1].sum};
+    rebuild_ = false;
+}
+
+template <class T, class Summary>
+T& LineSeq<T, Summary>::mut(size_t row) {
+    index();
+    size_t c, o;
+    locate(row, c, o);
+    touch(c);
+    return chunks_[c].items[o];
+}
+
+template <class T, class Summary>
+template <class F>
+void LineSeq<T, Summary>::update(size_t first, size_t count, F&& fn) {
+    index();
+    if (first >= size_) return;
+    count = std::min(count, size_ - first);
+    size_t c, o;
+    locate(first, c, o);
+    for (size_t row = first; count > 0; ++c, o = 0) {
+        auto& items = chunks_[c].items;
+        touch(c);
+        for (; o < items.size() && count > 0; ++o, --count) fn(row++, items[o]);
+    }
+}
+
+template <class T, class Summary>
+void LineSeq<T, Summary>::clear() {
+    chunks_.clear();
+    size_ = 0;
+    tree_.clear();
+    leaves_ = 1;
+    stale_.clear();
+    rebuild_ = false;
+}
+
+template <class T, class Summary>
+void LineSeq<T, Summary>::assign(size_t n, const T& value) {
+    clear();
+    chunks_.resize((n + CHUNK - 1) / CHUNK);
+    for (size_t c = 0; c < chunks_.size(); ++c) chunks_[c].items.assign(std::min(CHUNK, n - c * CHUNK), value);
+    size_ = n;
+    rebuild_ = true;
+}
+
+template <class T, class Summary>
+void LineSeq<T, Summary>::push_back(T value) {
+    if (chunks_.empty() || chunks_.back().items.size() == CHUNK) {
+        chunks_.emplace_back();
+        chunks_.back().items.reserve(CHUNK);
+    }
+    chunks_.back().items.push_back(std::move(value));
+    chunks_.back().stale = true;
+    ++size_;
+    rebuild_ = true;
+}
+
+template <class T, class Summary>
+void LineSeq<T, Summary>::splice(size_t row, size_t removed, size_t added, const T& fill) {
+    index();
+    row = std::min(row, size_);
+    removed = std::min(removed, size_ - row);
+    if (removed == 0 && added == 0) return;
+    size_t c0, o0, c1, o1;
+    locate(row, c0, o0);
+    locate(row + removed, c1, o1);
+    if (c1 > c0 && o1 == 0) o1 = chunks_[--c1].items.size(); // ends right at a chunk boundary
+    if (!chunks_.empty() && c0 == c1 && chunks_[c0].items.size() - removed + added <= 2 * CHUNK &&
+        (removed < chunks_[c0].items.size() || added > 0 || chunks_.size() == 1)) {
+        // the common case: the edit stays inside one chunk, only its path in the tree changes
+        auto& items = chunks_[c0].items;
+        auto at = items.erase(items.begin() + static_cast<std::ptrdiff_t>(o0),
+                              items.begin() + static_cast<std::ptrdiff_t>(o0 + removed));
+        items.insert(at, added, fill);
+        size_ = size_ - removed + added;
+        touch(c0);
+        recount(c0);
+        return;
+    }
+    // the range spans chunks or overflows one: those chunks are cut anew around the new lines
+    std::vector<Chunk> fresh;
+    auto put = [&](T&& value) {
+        if (fresh.empty() || fresh.back().items.size() == CHUNK) {
+            fresh.emplace_back();
+            fresh.back().items.reserve(CHUNK);
+        }
+        fresh.back().items.push_back(std::move(value));
+    };
+    size_t last = chunks_.empty() ? 0 : c1 + 1;
+    if (!chunks_.empty()) {
+        auto& head = chunks_[c0].items;
+        for (size_t i = 0; i < o0; ++i) put(std::move(head[i]));
+    }
+    for (size_t i = 0; i < added; ++i) put(T(fill));
+    if (!chunks_.empty()) {
+        auto& tail = chunks_[c1].items;
+        for (size_t i = o1; i < tail.size(); ++i) put(std::move(tail[i]));
+    }
+    auto first = chunks_.erase(chunks_.begin() + static_cast<std::ptrdiff_t>(c0),
+                               chunks_.begin() + static_cast<std::ptrdiff_t>(last));
+    chunks_.insert(first, std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()));
+    size_ = size_ - removed + added;
+    rebuild_tree();
+}
+
+template <class T, class Summary>
+void LineSeq<T, Summary>::settle() {
+    index();
+    for (size_t c : stale_) {
+        Chunk& chunk = chunks_[c];
+        Summary sum{};
+        for (const auto& v : chunk.items) sum = sum + Summary::of(v);
+        chunk.sum = sum;
+        chunk.stale = false;
+        size_t i = leaves_ + c;
+        tree_[i].sum = sum;
+        for (i /= 2; i > 0; i /= 2) tree_[i].sum = tree_[2 * i].sum + tree_[2 * i + 1].sum;
+    }
+    stale_.clear();
+}
+
+template <class T, class Summary>
+Summary LineSeq<T, Summary>::prefix(size_t row) const {
+    if (row >= size_) return total();
+    size_t c, o;
+    locate(row, c, o);
+    // the subtrees left of the chunk, nearest last, then the lines before row inside it
+    Summary sum{};
+    for (size_t i = leaves_ + c; i > 1; i /= 2)
+        if (i & 1) sum = tree_[i - 1].sum + sum;
+    const auto& items = chunks_[c].items;
+    for (size_t k = 0; k < o; ++k) sum = sum + Summary::of(items[k]);
+    return sum;
+}
+
+template <class T, class Summary>
+template <class Enter, class Pass>
+size_t LineSeq<T, Summary>::descend_forward(size_t node, size_t lo, size_t hi, size_t from, Enter& enter, Pass& pass) const {
+    if (hi <= from || lo >= chunks_.size()) return NONE;
+    const Node& n = tree_[node];
+    if (lo >= from && !enter(n.sum)) {
+        pass(n.sum);
+        return NONE;
+    }
+    if (hi - lo == 1) return lo;
+    size_t mid = (lo + hi) / 2;
+    size_t found = descend_forward(2 * node, lo, mid, from, enter, pass);
+    return found != NONE ? found : descend_forward(2 * node + 1, mid, hi, from, enter, pass);
+}
+
+template <class T, class Summary>
+template <class Enter, class Pass>
+size_t LineSeq<T, Summary>::descend_backward(size_t node, size_t lo, size_t hi, size_t to, Enter& enter, Pass& pass) const {
+    if (lo >= to) return NONE;
+    const Node& n = tree_[node];
+    if (hi <= to && !enter(n.sum)) {
+        pass(n.sum);
+        return NONE;
+    }
+    if (hi - lo == 1) return lo;
+    size_t mid = (lo + hi) / 2;
+    size_t found = descend_backward(2 * node + 1, mid, hi, to, enter, pass);
+    return found != NONE ? found : descend_backward(2 * node, lo, mid, to, enter, pass);
+}
+
+template <class T, class Summary>
+template <class Enter, class Pass>
+size_t LineSeq<T, Summary>::seek_forward(size_t from, Enter&& enter, Pass&& pass) const {
+    if (from >= size_) return NONE;
+    size_t c, o;
+    locate(from, c, o);
+    // rest of the chunk line by line, then the tree, then into the chunk it found
+    for (bool first = true;; first = false) {
+        size_t start = start_of(c);
+        const auto& items = chunks_[c].items;
+        for (; o < items.size(); ++o) {
+            Summary s = Summary::of(items[o]);
+            if (enter(s)) return start + o;
+            pass(s);
+        }
+        if (!first) return NONE;
+        c = descend_forward(1, 0, leaves_, c + 1, enter, pass);
+        if (c == NONE) return NONE;
+        o = 0;
+    }
+}
+
+template <class T, class Summary>
+template <class Enter, class Pass>
+size_t LineSeq<T, Summary>::seek_backward(size_t to, Enter&& enter, Pass&& pass) const {
+    if (size_ == 0) return NONE;
+    size_t c, o;
+    locate(std::min(to, size_ - 1), c, o);
+    for (bool first = true;; first = false) {
+        size_t start = start_of(c);
+        const auto& items = chunks_[c].items;
+        for (size_t k = o + 1; k-- > 0;) {
+            Summary s = Summary::of(items[k]);
+            if (enter(s)) return start + k;
+            pass(s);
+        }
+        if (!first || c == 0) return NONE;
+        c = descend_backward(1, 0, leaves_, c, enter, pass);
+        if (c == NONE) return NONE;
+        o = chunks_[c].items.size() - 1;
+    }
+}
+
+} // namespace termite
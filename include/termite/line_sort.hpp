@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "termite/buffer.hpp"
+
+namespace termite {
+
+// How "sort" compares lines, after the flags of sort(1)
+struct SortSpec {
+    bool numeric {false}; // -n: by the number the key starts with (none counts as 0)
+    bool reverse {false}; // -r
+    bool unique {false};  // -u: of lines with equal keys only the first one stays
+    size_t field {0};     // -k N: the key runs from the N-th blank separated field to the end, 0 = whole line
+};
+
+// Rows of lines [first, first + count) of snap in sorted order. Stable: equal keys keep their order.
+// Only (key, row) entries are sorted, with a merge sort whose runs and merges are spread over
+// the cores; the lines themselves are moved into place afterwards by Buffer::reorder_lines.
+std::vector<size_t> sorted_rows(const Snapshot& snap, size_t first, size_t count, const SortSpec& spec);
+// Rows of lines [first, first + count) without the ones equal to an earlier line, in order
+std::vector<size_t> unique_rows(const Snapshot& snap, size_t first, size_t count);
+
+} // namespace termite
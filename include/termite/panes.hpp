@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace termite {
+
+// Rectangle on the screen, 1-based like terminal coordinates
+struct PaneRect {
+    int top {1};
+    int left {1};
+    int rows {0};
+    int cols {0};
+
+    bool operator==(const PaneRect&) const = default;
+};
+
+// Split layout of the text area: a binary tree of splits whose leaves are the panes.
+// Panes are numbered 0..count()-1; closing one renumbers the ones above it.
+// The placement is kept until the tree or the area changes, so looking up a pane's rectangle
+// (done several times per key) does not walk the tree.
+class PaneLayout {
+public:
+    struct Placed {
+        size_t pane;
+        PaneRect rect;
+    };
+
+    PaneLayout();
+
+    size_t count() const { return count_; }
+    // Split pane in half; the new pane (returned) goes right of it (vertical) or below it
+    size_t split(size_t pane, bool vertical);
+    // Give the space of pane to its sibling
+    void close(size_t pane);
+    // Pane rectangles inside area, left/top first, and the one column dividers between side by
+    // side panes (rows = their height)
+    void place(const PaneRect& area, std::vector<Placed>& panes, std::vector<PaneRect>& dividers) const;
+    PaneRect rect_of(size_t pane, const PaneRect& area) const;
+    // Pane after pane in placement order, wrapping around
+    size_t next(size_t pane) const;
+
+private:
+    struct Node {
+        bool leaf {true};
+        size_t pane {0};
+        bool vertical {false};
+        int a {-1};
+        int b {-1};
+        int parent {-1};
+    };
+
+    int find(size_t pane) const;
+    int add(const Node& node);
+    const std::vector<Placed>& placed(const PaneRect& area) const;
+    void place(int node, const PaneRect& area, std::vector<Placed>& panes, std::vector<PaneRect>* dividers) const;
+
+    std::vector<Node> nodes_;
+    std::vector<int> free_; // nodes_ left by closed panes, reused by the next splits
+    int root_ {0};
+    size_t count_ {1};
+    // placement for placed_area_, valid until a split or close
+    mutable std::vector<Placed> placed_;
+    mutable std::vector<PaneRect> dividers_;
+    mutable PaneRect placed_area_;
+    mutable bool placed_valid_ {false};
+};
+
+} // namespace termite
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <optional>
 
 namespace termite::platform {
@@ -15,8 +16,18 @@ void shutdown();
 // Read a single key (blocking). Returns byte value or -1 on error.
 int read_key();
 
+// Wait up to timeout_ms (0 = just check, -1 = forever) for input; true if a byte can be read.
+bool input_pending(int timeout_ms);
+
+// Send bytes to the terminal and flush them.
+void write_output(const char* data, size_t n);
+
 // Query current terminal window size.
 std::optional<WinSize> window_size();
 
+// Ask the terminal whether it knows DEC private mode `mode` (DECRQM), call after init().
+// Terminals that do not answer count as not supporting it.
+bool query_private_mode(int mode);
+
 } // namespace termite::platform
 
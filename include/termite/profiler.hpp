@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Frame profiler: time per phase, bytes sent to the terminal and heap allocations of every frame.
+// Only compiled in with -DTERMITE_ENABLE_PROFILER=ON (defines TERMITE_PROFILER); without it every
+// call below is an empty inline function. With it, nothing is measured while the overlay is hidden.
+
+namespace termite::profiler {
+
+enum class Phase { Scroll, Highlight, Compose, Flush, Count };
+
+#ifdef TERMITE_PROFILER
+
+bool enabled();
+void set_enabled(bool on);
+
+void add_time(Phase phase, std::chrono::steady_clock::duration d);
+void add_bytes(size_t n);
+// Close the current frame: its numbers become the ones shown by overlay_lines()
+void end_frame();
+// Overlay text for the last finished frame
+std::vector<std::string> overlay_lines();
+
+// Adds the lifetime of the scope to a phase
+class Scope {
+public:
+    explicit Scope(Phase phase) : phase_(phase), on_(enabled()) {
+        if (on_) start_ = std::chrono::steady_clock::now();
+    }
+    ~Scope() {
+        if (on_) add_time(phase_, std::chrono::steady_clock::now() - start_);
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    Phase phase_;
+    bool on_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#else
+
+inline constexpr bool enabled() { return false; }
+inline void set_enabled(bool) {}
+inline void add_bytes(size_t) {}
+inline void end_frame() {}
+inline std::vector<std::string> overlay_lines() { return {}; }
+
+class Scope {
+public:
+    explicit Scope(Phase) {}
+};
+
+#endif
+
+} // namespace termite::profiler
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include "termite/syntax.hpp"
 
@@ -13,16 +14,58 @@ public:
     Screen();
     ~Screen();
 
+    // Full clear, the next frame repaints every row
     void clear();
+
+    // Frames: render composes every row between begin_frame/end_frame and only rows whose
+    // bytes differ from the last frame are sent. Row content must not move the cursor
+    // off its row.
+    void begin_frame();
+    // Following writes are the content of screen row `row` (1-based)
+    void begin_row(int row);
+    // Following writes continue row `row` at column `col`, after what earlier segments of the row
+    // wrote (side by side panes). The segment starts with a jump to its column inside the row.
+    void begin_segment(int row, int col);
+    // Tell the screen that the content of rows [top, bottom] moved up by n rows (down if n < 0).
+    // Uses a scroll region (DECSTBM + SU/SD) so the terminal shifts them, afterwards only the
+    // exposed rows differ from the last frame.
+    void scroll_rows(int top, int bottom, int n);
+    void end_frame();
+
+    // Wrap every frame in synchronized update sequences, only for terminals that support mode 2026
+    void set_synchronized_output(bool on) { sync_output_ = on; }
+
     void move_cursor(int row, int col);
-    void write(const std::string& s);
+    void write(std::string_view s);
     void flush();
     void draw_status(const std::string& status);
     void draw_line_numbers(std::size_t line_size);
     void draw_debug_window(const std::vector<std::string>& lines);
+    // List box with its top left corner at (row, col), item `selected` highlighted. Drawn on top
+    // of the frame like the debug window: only the rows it covered get repainted after it closes.
+    void draw_popup(int row, int col, const std::vector<std::string>& items, int selected);
     void write_with_syntax_highlighting(const std::vector<SyntaxHighlight>& highlights,
-                                        const std::string& text);
+                                        std::string_view text);
     Size size() const;
+    // Terminal size differs from the one the last frame was drawn for
+    bool resized() const;
+
+private:
+    void invalidate_row(int row);
+    void open_sync();
+
+    std::string out_;          // bytes for the terminal, sent by flush()
+    std::string* target_;      // where write() goes: out_, a frame row or the overlay
+    bool in_frame_ {false};
+    bool sync_output_ {false};
+    bool sync_open_ {false};   // BEGIN_SYNC sent, END_SYNC goes out with the next flush
+    Size frame_size_ {0, 0};
+    std::vector<std::string> prev_; // rows as sent in the last frame
+    std::vector<bool> prev_valid_;
+    std::vector<std::string> next_; // rows of the frame being composed
+    std::vector<bool> next_set_;
+    std::string overlay_;      // drawn on top of the rows after the diff (debug window)
+    std::vector<int> overlay_rows_;
 };
 
 } // namespace termite
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+#include <string>
 #include <vector>
 
 
@@ -22,5 +24,38 @@ namespace termite {
 
     std::vector<SyntaxHighlight> get_syntax_highlights(const std::string& line);
 
+    // Line-at-a-time lexer: what carries over from one line to the next (a C block comment) is the
+    // state, so any line can be lexed on its own given the state the line before it ended in.
+    enum class LexState : uint8_t
+    {
+        Code,
+        BlockComment,
+    };
+
+    struct BracketToken
+    {
+        int col; // byte offset in the line
+        char ch;
+    };
+
+    struct WordToken
+    {
+        int col; // byte offset in the line
+        int len;
+    };
+
+    // Bytes of an identifier: letters, digits, '_' and UTF-8 bytes (it does not start with a digit)
+    inline bool is_word_byte(char c)
+    {
+        unsigned char u = (unsigned char)c;
+        return u >= 0x80 || (u >= '0' && u <= '9') || ((u | 0x20) >= 'a' && (u | 0x20) <= 'z') || u == '_';
+    }
+
+    // Lex line starting in state `in`: brackets ()[]{} outside strings, character literals and
+    // comments are appended to brackets, identifiers there to words (each if given). Returns the
+    // state at the end of the line.
+    LexState lex_line(const std::string& line, LexState in, std::vector<BracketToken>* brackets,
+                      std::vector<WordToken>* words = nullptr);
+
 
 }
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace termite::unicode {
+
+// True if every byte is printable ASCII (0x20..0x7e): no tabs, no control bytes, no UTF-8.
+// Such a line has byte index == display column. Checks 16 bytes per step where SIMD is available.
+bool is_plain_ascii(const char* p, size_t n);
+
+// Decode the code point starting at s[i]. Invalid or truncated sequences decode as U+FFFD with len 1.
+char32_t decode(const std::string& s, size_t i, size_t& len);
+
+// Terminal width of a single code point: 0 (combining, zero width), 1 or 2 (wide / emoji).
+int char_width(char32_t cp);
+
+// Byte index of the next / previous grapheme cluster boundary (base + combining marks,
+// ZWJ sequences, flag pairs). Clamped to [0, s.size()].
+size_t next_grapheme(const std::string& s, size_t i);
+size_t prev_grapheme(const std::string& s, size_t i);
+
+// Display width of the grapheme cluster [begin, end).
+int grapheme_width(const std::string& s, size_t begin, size_t end);
+
+} // namespace termite::unicode
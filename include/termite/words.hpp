@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "termite/lexed_lines.hpp"
+#include "termite/syntax.hpp"
+
+namespace termite {
+
+class Buffer;
+
+// Identifiers of a buffer for word completion, as the lexer finds them (not in strings or comments).
+// A sorted table counts every word, so the words with a prefix are one range of it, found in
+// O(log n); a hash map in front of it finds the entry of a lexed word without string compares
+// down the tree. Every line keeps its entries (see LexedLines): an edited line takes its words out and
+// puts the new ones in, the lines after it are only lexed again while the block-comment state at their
+// start changes.
+class WordIndex {
+public:
+    // Words shorter than this are not worth completing
+    static constexpr size_t MIN_LENGTH = 3;
+
+    // Follow the edits made since the last call (lexes everything the first time).
+    void sync(const Buffer& buf);
+    // Append up to max words that start with prefix and are longer than it, in sorted order
+    void complete(std::string_view prefix, size_t max, std::vector<std::string>& out) const;
+    size_t size() const { return words_.size(); }
+
+private:
+    using Table = std::map<std::string, uint32_t, std::less<>>; // word -> occurrences
+    struct Line {
+        std::vector<Table::iterator> words;
+        LexState in;
+        LexState out;
+        uint64_t stamp;
+    };
+
+    LexState lex(Line& l, const std::string& line, LexState in);
+    void drop(Line& l);
+
+    Table words_;
+    std::unordered_map<std::string_view, Table::iterator> lookup_; // keys point into words_
+    LexedLines<Line, NoSummary> lines_;
+    std::vector<WordToken> scratch_;
+};
+
+} // namespace termite
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "termite/line_seq.hpp"
+
+namespace termite {
+
+class Buffer;
+class FoldIndex;
+class LayoutCache;
+struct LineLayout;
+
+// Word wrap of one line at width columns: the first column of every visual row.
+// Cached on the layout, so it is only recomputed when the line or the width changes.
+const std::vector<int>& wrap_rows(const std::string& line, LineLayout& lay, int width);
+
+// Visual rows of the whole buffer in soft wrap mode.
+// Keeps the row count of every line in a LineSeq, so visual row <-> line lookups and inserting or
+// removing lines are O(log n) plus one chunk. Lines that were never drawn count as one row; they are
+// measured (really wrapped) only when they become visible, so a resize touches no line at all.
+// Lines hidden by folds count as no rows; the folds must be synced with the buffer first.
+class WrapIndex {
+public:
+    // Throw everything away: all lines are unmeasured at the new width.
+    void reset(const Buffer& buf, int width, const FoldIndex* folds = nullptr);
+    // Follow structural edits (inserted/removed lines) of the buffer and changed folds, resets if
+    // that is not possible.
+    void sync(const Buffer& buf, int width, const FoldIndex* folds = nullptr);
+
+    // Wrap line exactly (if it changed since the last time) and return its visual row count.
+    int measure(const Buffer& buf, LayoutCache& layouts, size_t line);
+
+    int64_t total_rows() const { return lines_.total().n; }
+    // First visual row of line
+    int64_t row_of_line(size_t line) const { return lines_.prefix(line).n; }
+    // Line that contains visual row vrow, sub receives the row inside that line.
+    size_t line_at(int64_t vrow, int& sub) const;
+
+private:
+    struct Line {
+        int32_t rows;   // visual rows, 1 until measured
+        bool hidden;    // folded away: counts as no rows
+        uint64_t stamp; // line stamp when measured, 0 = not measured
+    };
+    struct Rows {
+        int64_t n {0};
+        static Rows of(const Line& l) { return {l.hidden ? 0 : l.rows}; }
+        friend Rows operator+(Rows a, Rows b) { return {a.n + b.n}; }
+    };
+
+    // Take the hidden lines over from the folds
+    void refold();
+
+    int width_ {0};
+    uint64_t revision_ {0};
+    const FoldIndex* folds_ {nullptr};
+    uint64_t fold_version_ {0};
+    LineSeq<Line, Rows> lines_;
+};
+
+} // namespace termite
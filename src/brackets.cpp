@@ -0,0 +1,136 @@
+#include "termite/brackets.hpp"
+
+#include "termite/buffer.hpp"
+
+#include <algorithm>
+
+namespace termite {
+
+namespace {
+
+constexpr size_t NONE = SIZE_MAX;
+
+bool is_open(char c) { return c == '(' || c == '[' || c == '{'; }
+
+char partner_of(char c) {
+    switch (c) {
+    case '(': return ')';
+    case ')': return '(';
+    case '[': return ']';
+    case ']': return '[';
+    case '{': return '}';
+    default: return '{';
+    }
+}
+
+} // namespace
+
+LexState BracketIndex::summarize(Line& l, const std::string& line, LexState in) {
+    scratch_.clear();
+    LexState out = lex_line(line, in, &scratch_);
+    l.sum = 0;
+    l.low = 0;
+    for (const auto& t : scratch_) {
+        l.sum += is_open(t.ch) ? 1 : -1;
+        l.low = std::min(l.low, l.sum);
+    }
+    return out;
+}
+
+void BracketIndex::sync(const Buffer& buf) {
+    lines_.sync(
+        buf, [&](Line& l, const std::string& line, LexState in) { return summarize(l, line, in); }, [](Line&) {});
+}
+
+size_t BracketIndex::find_forward(size_t row, int64_t& open) const {
+    return lines_.lines().seek_forward(
+        row, [&](const Node& n) { return open + n.low <= 0; }, [&](const Node& n) { open += n.sum; });
+}
+
+size_t BracketIndex::find_backward(size_t row, int64_t& close) const {
+    return lines_.lines().seek_backward(
+        row, [&](const Node& n) { return n.sum - n.low >= close; }, [&](const Node& n) { close -= n.sum; });
+}
+
+bool BracketIndex::finish_forward(const Buffer& buf, size_t row, int64_t open, Pos& out) {
+    size_t r = find_forward(row, open);
+    if (r == NONE) return false;
+    scratch_.clear();
+    lex_line(buf.line(r), lines_.state_before(r), &scratch_);
+    for (const auto& t : scratch_) {
+        open += is_open(t.ch) ? 1 : -1;
+        if (open == 0) {
+            out = {r, static_cast<size_t>(t.col)};
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BracketIndex::finish_backward(const Buffer& buf, size_t row, int64_t close, Pos& out) {
+    size_t r = find_backward(row, close);
+    if (r == NONE) return false;
+    scratch_.clear();
+    lex_line(buf.line(r), lines_.state_before(r), &scratch_);
+    for (size_t k = scratch_.size(); k-- > 0;) {
+        close += is_open(scratch_[k].ch) ? -1 : 1;
+        if (close == 0) {
+            out = {r, static_cast<size_t>(scratch_[k].col)};
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BracketIndex::match(const Buffer& buf, size_t row, size_t col, Pos& out) {
+    if (row >= lines_.size()) return false;
+    scratch_.clear();
+    lex_line(buf.line(row), lines_.state_before(row), &scratch_);
+    auto at = std::find_if(scratch_.begin(), scratch_.end(), [&](const BracketToken& t) { return static_cast<size_t>(t.col) == col; });
+    if (at == scratch_.end()) return false;
+    char ch = at->ch;
+    int64_t depth = 1;
+    bool found = false;
+    // the rest of its own line first
+    if (is_open(ch)) {
+        for (auto t = at + 1; t != scratch_.end() && !found; ++t) {
+            depth += is_open(t->ch) ? 1 : -1;
+            if (depth == 0) {
+                out = {row, static_cast<size_t>(t->col)};
+                found = true;
+            }
+        }
+        if (!found) found = row + 1 < lines_.size() && finish_forward(buf, row + 1, depth, out);
+    } else {
+        for (auto t = at; t != scratch_.begin() && !found;) {
+            --t;
+            depth += is_open(t->ch) ? -1 : 1;
+            if (depth == 0) {
+                out = {row, static_cast<size_t>(t->col)};
+                found = true;
+            }
+        }
+        if (!found) found = row > 0 && finish_backward(buf, row - 1, depth, out);
+    }
+    // nesting is counted over all kinds, a ( closed by ] is no match
+    return found && buf.line(out.row)[out.col] == partner_of(ch);
+}
+
+bool BracketIndex::enclosing(const Buffer& buf, size_t row, size_t col, Pos& out) {
+    if (row >= lines_.size()) return false;
+    scratch_.clear();
+    lex_line(buf.line(row), lines_.state_before(row), &scratch_);
+    // as if a closing bracket stood at col
+    int64_t close = 1;
+    for (size_t k = scratch_.size(); k-- > 0;) {
+        if (static_cast<size_t>(scratch_[k].col) >= col) continue;
+        close += is_open(scratch_[k].ch) ? -1 : 1;
+        if (close == 0) {
+            out = {row, static_cast<size_t>(scratch_[k].col)};
+            return true;
+        }
+    }
+    return row > 0 && finish_backward(buf, row - 1, close, out);
+}
+
+} // namespace termite
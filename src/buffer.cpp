@@ -1,62 +1,479 @@
 #include "termite/buffer.hpp"
 
-#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 namespace termite {
 
+namespace {
+// Lines per chunk when building the tree, chunks get split once they grow past twice that.
+constexpr size_t CHUNK_LINES = 512;
+// Structural edits kept for followers, the older half is dropped when full.
+constexpr size_t MAX_LOGGED_EDITS = 1024;
+
+std::atomic<uint64_t> g_next_stamp {1};
+
+uint64_t new_stamps(size_t n) { return g_next_stamp.fetch_add(n, std::memory_order_relaxed); }
+}
+
+namespace detail {
+
+void LineTree::locate(size_t row, size_t& chunk, size_t& offset) const {
+    // last chunk whose first line is <= row
+    auto it = std::upper_bound(starts.begin(), starts.end(), row);
+    chunk = static_cast<size_t>(it - starts.begin()) - 1;
+    offset = row - starts[chunk];
+}
+
+const std::string& LineTree::line(size_t row) const {
+    size_t c, o;
+    locate(row, c, o);
+    return chunks[c]->lines[o];
+}
+
+uint64_t LineTree::stamp(size_t row) const {
+    size_t c, o;
+    locate(row, c, o);
+    return chunks[c]->stamps[o];
+}
+
+} // namespace detail
+
 Buffer::Buffer() {
     // Ensure there is always at least one line
-    lines_.push_back("");
+    set_contents("");
 }
 
 void Buffer::set_contents(std::string text) {
-    lines_.clear();
-    std::stringstream ss(std::move(text));
-    std::string line;
-    while (std::getline(ss, line)) {
-        // Keep line endings normalized; 
-        //std::getline strips '\n'
-        lines_.push_back(line);
+    auto tree = std::make_shared<detail::LineTree>();
+    auto chunk = std::make_shared<detail::LineChunk>();
+    chunk->lines.reserve(CHUNK_LINES);
+    FileFormat fmt;
+    const char* p = text.data();
+    const char* end = p + text.size();
+    if (text.size() >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        fmt.utf8_bom = true;
+        p += 3;
+    }
+    // The first line ending decides the style (like vim's fileformat detection).
+    // In CRLF mode the '\r' is stripped from the line, a bare '\n' line gets CRLF on save.
+    bool first_eol = true;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        const char* line_end = nl ? nl : end;
+        if (nl) {
+            bool cr = line_end > p && line_end[-1] == '\r';
+            if (first_eol) {
+                fmt.eol = cr ? LineEnding::CRLF : LineEnding::LF;
+                first_eol = false;
+            }
+            if (cr && fmt.eol == LineEnding::CRLF) --line_end;
+        }
+        chunk->lines.emplace_back(p, line_end);
+        if (chunk->lines.size() == CHUNK_LINES) {
+            tree->chunks.push_back(std::move(chunk));
+            chunk = std::make_shared<detail::LineChunk>();
+            chunk->lines.reserve(CHUNK_LINES);
+        }
+        if (!nl) break;
+        p = nl + 1;
+        fmt.trailing_newline = (p == end);
+    }
+    if (!chunk->lines.empty() || tree->chunks.empty()) {
+        if (chunk->lines.empty()) chunk->lines.emplace_back(); // Ensure there is always at least one line
+        tree->chunks.push_back(std::move(chunk));
+    }
+    uint64_t stamp = new_stamps(static_cast<size_t>(tree->chunks.size()) * CHUNK_LINES);
+    for (auto& c : tree->chunks) {
+        c->stamps.resize(c->lines.size());
+        for (auto& st : c->stamps) st = stamp++;
+    }
+    tree_ = std::move(tree);
+    format_ = fmt;
+    reindex_from(0);
+    // everything changed: followers have to rebuild
+    edit_log_.clear();
+    log_base_ = ++revision_;
+}
+
+bool Buffer::edits_since(uint64_t rev, std::vector<LineEdit>& out) const {
+    if (rev < log_base_ || rev > revision_) return false;
+    out.insert(out.end(), edit_log_.begin() + static_cast<std::ptrdiff_t>(rev - log_base_), edit_log_.end());
+    return true;
+}
+
+void Buffer::log_edit(size_t row, size_t removed, size_t added, size_t changed) {
+    if (edit_log_.size() == MAX_LOGGED_EDITS) {
+        size_t drop = MAX_LOGGED_EDITS / 2;
+        edit_log_.erase(edit_log_.begin(), edit_log_.begin() + static_cast<std::ptrdiff_t>(drop));
+        log_base_ += drop;
+    }
+    edit_log_.push_back({row, removed, added, changed});
+    ++revision_;
+}
+
+void Buffer::make_tree_unique() {
+    if (tree_.use_count() > 1) {
+        // a snapshot holds the old root: copy the chunk handles only, chunks stay shared
+        tree_ = std::make_shared<detail::LineTree>(*tree_);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+void Buffer::reindex_from(size_t chunk) {
+    auto& t = *tree_;
+    t.starts.resize(t.chunks.size());
+    size_t start = chunk == 0 ? 0 : t.starts[chunk - 1] + t.chunks[chunk - 1]->lines.size();
+    for (size_t i = chunk; i < t.chunks.size(); ++i) {
+        t.starts[i] = start;
+        start += t.chunks[i]->lines.size();
+    }
+    t.total = start;
+}
+
+std::string& Buffer::mutable_line(size_t row) {
+    auto& s = unshare_line(row);
+    log_edit(row, 0, 0, 1);
+    return s;
+}
+
+std::string& Buffer::unshare_line(size_t row) {
+    make_tree_unique();
+    size_t c, o;
+    tree_->locate(row, c, o);
+    auto& chunk = tree_->chunks[c];
+    if (chunk.use_count() > 1) chunk = std::make_shared<detail::LineChunk>(*chunk);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    chunk->stamps[o] = new_stamps(1);
+    return chunk->lines[o];
+}
+
+void Buffer::insert_line(size_t row, std::string text) {
+    make_tree_unique();
+    auto& t = *tree_;
+    // appending after the last line goes to the end of the last chunk
+    size_t c, o;
+    if (row >= t.total) {
+        c = t.chunks.size() - 1;
+        o = t.chunks[c]->lines.size();
+    } else {
+        t.locate(row, c, o);
+    }
+    auto& chunk = t.chunks[c];
+    if (chunk.use_count() > 1) chunk = std::make_shared<detail::LineChunk>(*chunk);
+    auto& ls = chunk->lines;
+    auto& st = chunk->stamps;
+    ls.insert(ls.begin() + static_cast<std::ptrdiff_t>(o), std::move(text));
+    st.insert(st.begin() + static_cast<std::ptrdiff_t>(o), new_stamps(1));
+    if (ls.size() > 2 * CHUNK_LINES) {
+        auto tail = std::make_shared<detail::LineChunk>();
+        tail->lines.assign(std::make_move_iterator(ls.begin() + CHUNK_LINES), std::make_move_iterator(ls.end()));
+        tail->stamps.assign(st.begin() + CHUNK_LINES, st.end());
+        ls.erase(ls.begin() + CHUNK_LINES, ls.end());
+        st.erase(st.begin() + CHUNK_LINES, st.end());
+        t.chunks.insert(t.chunks.begin() + static_cast<std::ptrdiff_t>(c + 1), std::move(tail));
+    }
+    reindex_from(c);
+    log_edit(row < t.total ? row : t.total - 1, 0, 1);
+}
+
+void Buffer::erase_line(size_t row) {
+    make_tree_unique();
+    auto& t = *tree_;
+    size_t c, o;
+    t.locate(row, c, o);
+    auto& chunk = t.chunks[c];
+    if (chunk.use_count() > 1) chunk = std::make_shared<detail::LineChunk>(*chunk);
+    chunk->lines.erase(chunk->lines.begin() + static_cast<std::ptrdiff_t>(o));
+    chunk->stamps.erase(chunk->stamps.begin() + static_cast<std::ptrdiff_t>(o));
+    if (chunk->lines.empty() && t.chunks.size() > 1) {
+        t.chunks.erase(t.chunks.begin() + static_cast<std::ptrdiff_t>(c));
     }
-    if (lines_.empty()) lines_.push_back(""); // Ensure there is always at least one line
+    reindex_from(c < t.chunks.size() ? c : t.chunks.size() - 1);
+    log_edit(row, 1, 0);
 }
 
 void Buffer::insert_char(size_t row, size_t col, char ch) {
-    if (row >= lines_.size()) return;
-    auto& s = lines_[row];
+    if (row >= line_count()) return;
+    if (observer_) observer_->applied({BufferOp::InsertChar, row, col, std::string_view(&ch, 1)});
+    auto& s = mutable_line(row);
     if (col > s.size()) col = s.size();
     s.insert(s.begin() + static_cast<std::ptrdiff_t>(col), ch);
 }
 
 void Buffer::delete_char(size_t row, size_t col) {
-    if (row >= lines_.size()) return;
-    auto& s = lines_[row];
-    if (col >= s.size()) return;
+    if (row >= line_count()) return;
+    if (col >= line(row).size()) return;
+    if (observer_) observer_->applied({BufferOp::DeleteChar, row, col, {}});
+    auto& s = mutable_line(row);
     s.erase(s.begin() + static_cast<std::ptrdiff_t>(col));
 }
 
+void Buffer::insert_at(const std::vector<LinePos>& at, std::string_view text) {
+    if (text.empty()) return;
+    // lines back to front; reported back to front too, so replaying the ops one by one
+    // never shifts a position that is still to come
+    size_t end = at.size();
+    size_t lo = SIZE_MAX, hi = 0; // lines edited, logged as one range
+    while (end > 0) {
+        size_t row = at[end - 1].row;
+        size_t first = end - 1;
+        while (first > 0 && at[first - 1].row == row) --first;
+        if (row < line_count()) {
+            if (observer_) {
+                size_t len = line(row).size();
+                for (size_t k = end; k-- > first;)
+                    for (size_t j = 0; j < text.size(); ++j)
+                        observer_->applied({BufferOp::InsertChar, row, std::min(at[k].col, len) + j, text.substr(j, 1)});
+            }
+            // grow once, then move the pieces right from the back: every byte moves at most once
+            auto& s = unshare_line(row);
+            lo = std::min(lo, row);
+            hi = std::max(hi, row);
+            size_t src = s.size();
+            s.resize(src + (end - first) * text.size());
+            size_t dst = s.size();
+            for (size_t k = end; k-- > first;) {
+                size_t col = std::min(at[k].col, src);
+                dst -= src - col;
+                std::memmove(&s[dst], s.data() + col, src - col);
+                dst -= text.size();
+                std::memcpy(&s[dst], text.data(), text.size());
+                src = col;
+            }
+        }
+        end = first;
+    }
+    if (lo <= hi) log_edit(lo, 0, 0, hi - lo + 1);
+}
+
+void Buffer::erase_at(const std::vector<LineSpan>& spans) {
+    size_t end = spans.size();
+    size_t lo = SIZE_MAX, hi = 0; // lines edited, logged as one range
+    while (end > 0) {
+        size_t row = spans[end - 1].row;
+        size_t first = end - 1;
+        while (first > 0 && spans[first - 1].row == row) --first;
+        if (row < line_count()) {
+            size_t len = line(row).size();
+            if (observer_) {
+                for (size_t k = end; k-- > first;) {
+                    size_t col = std::min(spans[k].col, len);
+                    size_t n = std::min(spans[k].len, len - col);
+                    for (size_t j = 0; j < n; ++j) observer_->applied({BufferOp::DeleteChar, row, col, {}});
+                }
+            }
+            // close the gaps front to back in place
+            auto& s = unshare_line(row);
+            lo = std::min(lo, row);
+            hi = std::max(hi, row);
+            size_t dst = std::min(spans[first].col, len);
+            size_t src = dst;
+            for (size_t k = first; k < end; ++k) {
+                size_t col = std::max(src, std::min(spans[k].col, len));
+                std::memmove(&s[0] + dst, s.data() + src, col - src);
+                dst += col - src;
+                src = std::max(col, std::min(spans[k].col + spans[k].len, len));
+            }
+            std::memmove(&s[0] + dst, s.data() + src, len - src);
+            s.resize(dst + len - src);
+        }
+        end = first;
+    }
+    if (lo <= hi) log_edit(lo, 0, 0, hi - lo + 1);
+}
+
 void Buffer::split_line(size_t row, size_t col) {
-    if (row >= lines_.size()) return;
-    auto& s = lines_[row];
+    if (row >= line_count()) return;
+    if (observer_) observer_->applied({BufferOp::SplitLine, row, col, {}});
+    auto& s = mutable_line(row);
     if (col > s.size()) col = s.size();
     std::string right = s.substr(col);
     s.erase(col);
-    lines_.insert(lines_.begin() + static_cast<std::ptrdiff_t>(row + 1), std::move(right));
+    insert_line(row + 1, std::move(right));
 }
 
 void Buffer::join_with_next(size_t row) {
-    if (row + 1 >= lines_.size()) return;
-    lines_[row] += lines_[row + 1];
-    lines_.erase(lines_.begin() + static_cast<std::ptrdiff_t>(row + 1));
+    if (row + 1 >= line_count()) return;
+    if (observer_) observer_->applied({BufferOp::JoinLine, row, 0, {}});
+    std::string next = line(row + 1);
+    mutable_line(row) += next;
+    erase_line(row + 1);
 }
 
 void Buffer::delete_line(size_t row) {
-    if (row >= lines_.size()) return;
-    if (lines_.size() == 1) {
-        lines_[0].clear();
+    if (row >= line_count()) return;
+    if (observer_) observer_->applied({BufferOp::DeleteLine, row, 0, {}});
+    if (line_count() == 1) {
+        mutable_line(0).clear();
         return;
     }
-    lines_.erase(lines_.begin() + static_cast<std::ptrdiff_t>(row));
+    erase_line(row);
+}
+
+size_t Buffer::append(std::string_view text) {
+    bool cont = !format_.trailing_newline; // the first piece belongs to the last line
+    size_t first_row = cont ? line_count() - 1 : line_count();
+    if (text.empty()) return first_row;
+    if (observer_) observer_->applied({BufferOp::Append, 0, 0, text});
+    make_tree_unique();
+    auto& t = *tree_;
+    size_t old_total = t.total;
+    size_t first_chunk = t.chunks.size() - 1;
+    auto& tail = t.chunks.back();
+    if (tail.use_count() > 1) tail = std::make_shared<detail::LineChunk>(*tail);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    detail::LineChunk* chunk = tail.get();
+    bool first_eol = old_total == 1 && cont; // no line ending seen yet, the first one decides the style
+    const char* p = text.data();
+    const char* end = p + text.size();
+    size_t added = 0;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        const char* line_end = nl ? nl : end;
+        if (nl) {
+            bool cr = line_end > p && line_end[-1] == '\r';
+            if (first_eol) {
+                format_.eol = cr ? LineEnding::CRLF : LineEnding::LF;
+                first_eol = false;
+            }
+            if (cr && format_.eol == LineEnding::CRLF) --line_end;
+        }
+        if (cont) {
+            std::string& last = chunk->lines.back();
+            // "\r" and "\n" arrived in different appends
+            if (nl && line_end == p && format_.eol == LineEnding::CRLF && !last.empty() && last.back() == '\r')
+                last.pop_back();
+            last.append(p, line_end);
+            chunk->stamps.back() = new_stamps(1);
+            log_edit(old_total - 1, 0, 0, 1);
+            cont = false;
+        } else {
+            if (chunk->lines.size() >= CHUNK_LINES) {
+                t.chunks.push_back(std::make_shared<detail::LineChunk>());
+                chunk = t.chunks.back().get();
+                chunk->lines.reserve(CHUNK_LINES);
+                chunk->stamps.reserve(CHUNK_LINES);
+            }
+            chunk->lines.emplace_back(p, line_end);
+            chunk->stamps.push_back(new_stamps(1));
+            ++added;
+        }
+        if (!nl) break;
+        p = nl + 1;
+    }
+    format_.trailing_newline = text.back() == '\n';
+    reindex_from(first_chunk);
+    if (added > 0) log_edit(old_total, 0, added);
+    return first_row;
+}
+
+void Buffer::replace_lines(size_t row, size_t count, std::vector<std::string> lines) {
+    std::vector<uint64_t> stamps(lines.size());
+    uint64_t stamp = new_stamps(lines.size());
+    for (auto& st : stamps) st = stamp++;
+    make_tree_unique();
+    splice(row, count, std::move(lines), stamps);
+}
+
+void Buffer::reorder_lines(size_t row, size_t count, const std::vector<size_t>& rows) {
+    make_tree_unique();
+    auto& t = *tree_;
+    row = std::min(row, t.total);
+    count = std::min(count, t.total - row);
+    if (count == 0) return;
+    // the lines of the range: moved out of chunks no snapshot shares, copied from the others
+    std::vector<std::string> old;
+    std::vector<uint64_t> old_stamps;
+    old.reserve(count);
+    old_stamps.reserve(count);
+    size_t c, o;
+    t.locate(row, c, o);
+    for (size_t left = count; left > 0; ++c, o = 0) {
+        auto& chunk = t.chunks[c];
+        bool own = chunk.use_count() == 1;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        size_t n = std::min(left, chunk->lines.size() - o);
+        for (size_t i = o; i < o + n; ++i) {
+            if (own)
+                old.push_back(std::move(chunk->lines[i]));
+            else
+                old.push_back(chunk->lines[i]);
+            old_stamps.push_back(chunk->stamps[i]);
+        }
+        left -= n;
+    }
+    // same contents, so every line keeps its stamp and caches keyed on it stay valid
+    std::vector<std::string> lines;
+    std::vector<uint64_t> stamps;
+    lines.reserve(rows.size());
+    stamps.reserve(rows.size());
+    for (size_t r : rows) {
+        if (r < row || r - row >= count) continue;
+        lines.push_back(std::move(old[r - row]));
+        stamps.push_back(old_stamps[r - row]);
+    }
+    splice(row, count, std::move(lines), stamps);
+}
+
+void Buffer::splice(size_t row, size_t count, std::vector<std::string> lines, const std::vector<uint64_t>& stamps) {
+    auto& t = *tree_;
+    row = std::min(row, t.total);
+    count = std::min(count, t.total - row);
+    // chunks c0..c1 hold the range; what they have before and after it goes around the new lines
+    auto position = [&](size_t r, size_t& c, size_t& o) {
+        if (r < t.total) {
+            t.locate(r, c, o);
+        } else {
+            c = t.chunks.size() - 1;
+            o = t.chunks[c]->lines.size();
+        }
+    };
+    size_t c0, o0, c1, o1;
+    position(row, c0, o0);
+    position(row + count, c1, o1);
+    std::vector<std::shared_ptr<detail::LineChunk>> fresh;
+    std::shared_ptr<detail::LineChunk> chunk;
+    auto put = [&](std::string&& text, uint64_t stamp) {
+        if (!chunk || chunk->lines.size() == CHUNK_LINES) {
+            if (chunk) fresh.push_back(std::move(chunk));
+            chunk = std::make_shared<detail::LineChunk>();
+            chunk->lines.reserve(CHUNK_LINES);
+            chunk->stamps.reserve(CHUNK_LINES);
+        }
+        chunk->lines.push_back(std::move(text));
+        chunk->stamps.push_back(stamp);
+    };
+    const auto& head = *t.chunks[c0];
+    for (size_t i = 0; i < o0; ++i) put(std::string(head.lines[i]), head.stamps[i]);
+    size_t added = lines.size();
+    for (size_t i = 0; i < added; ++i) put(std::move(lines[i]), stamps[i]);
+    const auto& tail = *t.chunks[c1];
+    for (size_t i = o1; i < tail.lines.size(); ++i) put(std::string(tail.lines[i]), tail.stamps[i]);
+    if (!chunk && t.chunks.size() == c1 - c0 + 1) {
+        put(std::string(), new_stamps(1)); // Ensure there is always at least one line
+        added = 1;
+    }
+    if (chunk) fresh.push_back(std::move(chunk));
+    auto first = t.chunks.begin() + static_cast<std::ptrdiff_t>(c0);
+    first = t.chunks.erase(first, first + static_cast<std::ptrdiff_t>(c1 - c0 + 1));
+    t.chunks.insert(first, std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()));
+    reindex_from(c0);
+    log_edit(row, count, added);
+}
+
+void Buffer::apply(const BufferOp& op) {
+    switch (op.kind) {
+    case BufferOp::InsertChar:
+        if (!op.text.empty()) insert_char(op.row, op.col, op.text[0]);
+        break;
+    case BufferOp::DeleteChar: delete_char(op.row, op.col); break;
+    case BufferOp::SplitLine: split_line(op.row, op.col); break;
+    case BufferOp::JoinLine: join_with_next(op.row); break;
+    case BufferOp::DeleteLine: delete_line(op.row); break;
+    case BufferOp::Append: append(op.text); break;
+    }
 }
 
 }
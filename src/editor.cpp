@@ -1,87 +1,665 @@
 #include "termite/editor.hpp"
 #include "termite/screen.hpp"
 #include "termite/buffer.hpp"
+#include "termite/layout.hpp"
+#include "termite/wrap.hpp"
+#include "termite/folds.hpp"
 #include "termite/input.hpp"
 #include "termite/file_io.hpp"
 #include "termite/platform.hpp"
+#include "termite/profiler.hpp"
+#include "termite/latency.hpp"
+#include "termite/file_view.hpp"
+#include "termite/follow.hpp"
+#include "termite/filter.hpp"
+#include "termite/journal.hpp"
+#include "termite/brackets.hpp"
+#include "termite/words.hpp"
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
 
 namespace termite {
 
-Editor::Editor() : screen_(new Screen()), buffer_(new Buffer()) {}
+namespace {
+// Follow mode: look for appended data this often while idle, and take at most this much per frame
+constexpr int FOLLOW_POLL_MS = 50;
+constexpr size_t FOLLOW_READ_MAX = size_t{16} << 20;
+// Filter: longest the pipes are served per turn of the loop before keys are looked at again
+constexpr int FILTER_PUMP_MS = 10;
+
+std::string megabytes(uint64_t bytes) { return std::to_string(bytes >> 20) + " MB"; }
+}
+
+Editor::Editor() : screen_(new Screen()), buffer_(new Buffer()), layouts_(new LayoutCache()), wrap_(new WrapIndex()), docs_(1),
+      layout_(new PaneLayout()), panes_(1) {}
 
 Editor::~Editor() { platform::shutdown(); }
 
 int Editor::run(int argc, char** argv) {
+    std::vector<std::string> files;
+    bool view = false;
+    bool follow = false;
+    journal_enabled_ = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--record" || arg == "--replay") && i + 1 < argc) {
+            std::string log = argv[++i];
+            if (!(arg == "--record" ? input::record_to(log) : input::replay_from(log))) {
+                std::cerr << "Cannot open key log: " << log << "\n";
+                return 1;
+            }
+            latency_ = std::make_unique<KeyLatency>();
+        } else if (arg == "--view") {
+            view = true;
+        } else if (arg == "--follow") {
+            follow = true;
+        } else if (arg == "--no-journal") {
+            journal_enabled_ = false;
+        } else if (!arg.empty()) {
+            files.push_back(arg);
+        }
+    }
+
+    if (view && files.empty()) {
+        std::cerr << "--view needs a file\n";
+        return 1;
+    }
+
     status_ = "Termite — Press Ctrl-Q to quit";
     if (!platform::init()) {
         std::cerr << "Failed to initialize terminal (raw mode).\n";
     }
-    open_file_if_provided(argc, argv);
+    screen_->set_synchronized_output(platform::query_private_mode(2026));
+    if (view) {
+        open_view(files.front());
+    } else if (!files.empty()) {
+        for (const auto& f : files)
+            if (open_document(f) && follow && !view_) set_follow(true);
+        switch_document(0);
+    }
+    using clock = std::chrono::steady_clock;
+    auto last_frame = clock::time_point{};
     while (true) {
-        render();
+        auto budget = std::chrono::microseconds(1000000 / std::max(1, frame_hz_));
+        auto now = clock::now();
+        if (screen_->resized()) dirty_ = true;
+        if (follow_ && poll_follow()) dirty_ = true;
+        if (filter_ && poll_filter()) dirty_ = true;
+        // the last frame found the viewed file shorter: draw again with the view pulled back
+        if (view_ && view_->shrank() && !view_shrank_) dirty_ = true;
+        // draw when the input is idle, during bursts only once per frame budget
+        if (dirty_ && (now - last_frame >= budget || !input::key_pending(0))) {
+            render();
+            if (latency_) {
+                auto end = clock::now();
+                latency_->frame(end - now - flush_time_, flush_time_, end);
+            }
+            last_frame = now;
+            dirty_ = false;
+        }
+        // dirty: wake up for the next frame; clean: block, but look at the window size now and then
+        int wait_ms = 100;
+        if (dirty_) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(last_frame + budget - clock::now());
+            wait_ms = std::max(0, static_cast<int>(left.count()));
+        }
+        if (follow_) wait_ms = std::min(wait_ms, follow_->pending() ? 0 : FOLLOW_POLL_MS);
+        if (filter_) wait_ms = 0; // poll_filter waited on its pipes already
+        if (!input::key_pending(wait_ms)) continue;
+        auto read_start = clock::now();
         int k = input::read_key();
-        if (!handle_input(k)) break;
+        auto decoded = clock::now();
+        bool keep_going = handle_input(k);
+        if (latency_) latency_->key(read_start, decoded - read_start, clock::now() - decoded);
+        if (!keep_going) break;
+        dirty_ = true;
+        if (journal_ && journal_->wants_compaction()) journal_->compact(buffer_->snapshot(), buffer_->format());
+    }
+    // unsaved edits stay on disk, the next session offers them again
+    auto end_journal = [](Buffer& buf, std::unique_ptr<Journal>& journal, bool modified) {
+        if (!journal) return;
+        buf.set_observer(nullptr);
+        if (!modified) journal->discard();
+        journal.reset();
+    };
+    end_journal(*buffer_, journal_, modified_);
+    for (auto& d : docs_)
+        if (d.buffer) end_journal(*d.buffer, d.journal, d.modified);
+    if (latency_) {
+        platform::shutdown(); // back on the normal screen, so the report stays visible
+        std::cerr << latency_->report();
     }
     return 0;
 }
 
-void Editor::open_file_if_provided(int argc, char** argv) {
-    if (argc > 1 && argv[1] && argv[1][0] != '\0') {
-        try {
-            auto contents = file_io::read_file(argv[1]);
-            buffer_->set_contents(std::move(contents)); //move is more performant the copy
-            status_ = std::string("Opened: ") + argv[1];
-            filename_ = argv[1];
-            modified_ = false;
-        } catch (...) {
-            status_ = std::string("Failed to open: ") + argv[1];
+bool Editor::open_file(const std::string& path) {
+    try {
+        auto contents = file_io::read_file(path);
+        file_bytes_ = contents.size();
+        buffer_->set_contents(std::move(contents)); //move is more performant the copy
+        status_ = "Opened: " + path;
+        filename_ = path;
+        modified_ = false;
+        cx_ = cy_ = 1;
+        row_off_ = col_off_ = 0;
+        clear_selection();
+        if (folds_) folds_->clear();
+        search_query_.clear();
+        search_matches_.clear();
+        search_index_ = -1;
+        if (journal_enabled_) start_journal();
+        return true;
+    } catch (...) {
+        status_ = "Failed to open: " + path;
+        return false;
+    }
+}
+
+bool Editor::open_view(const std::string& path) {
+    auto v = std::make_unique<FileView>();
+    // hex rows need no line index, so a binary file of any size opens without a pass over it
+    bool hex = file_io::looks_binary(path);
+    if (!v->open(path, !hex)) {
+        status_ = "Failed to open: " + path;
+        return false;
+    }
+    view_ = std::move(v);
+    view_path_ = path;
+    view_hex_ = hex;
+    hex_top_ = 0;
+    view_shrank_ = false;
+    status_ = (hex ? "Binary file, hex view: " : "Viewing: ") + path + " (read-only)";
+    col_off_ = 0;
+    drawn_row_off_ = -1;
+    return true;
+}
+
+void Editor::set_follow(bool on) {
+    follow_.reset();
+    if (!on) {
+        status_ = "Follow off";
+        return;
+    }
+    auto f = std::make_unique<FileFollower>();
+    if (filename_.empty() || !f->start(filename_, file_bytes_)) {
+        status_ = "Cannot follow: " + (filename_.empty() ? std::string("(untitled)") : filename_);
+        return;
+    }
+    follow_ = std::move(f);
+    status_ = "Following: " + filename_;
+}
+
+bool Editor::poll_follow() {
+    auto change = follow_->poll(follow_chunk_, FOLLOW_READ_MAX);
+    if (change == FileFollower::Change::None) return false;
+    bool at_end = cy_ >= (int)buffer_->line_count();
+    if (change == FileFollower::Change::Truncated || change == FileFollower::Change::Rotated) {
+        if (journal_) journal_->discard(); // its records apply to the old contents
+        open_file(filename_);
+        set_follow(true);
+        bool rotated = change == FileFollower::Change::Rotated;
+        status_ = std::string(rotated ? "File rotated" : "File truncated") + ", reloaded: " + filename_;
+    } else {
+        // only the new bytes: split at their newlines, add at the end, rescan search from there
+        size_t first = buffer_->append(follow_chunk_);
+        file_bytes_ += follow_chunk_.size();
+        if (!search_query_.empty()) update_search_matches((int)first);
+    }
+    if (at_end) {
+        cy_ = (int)buffer_->line_count();
+        cx_ = (int)buffer_->line_length((size_t)(cy_ - 1)) + 1;
+        scroll();
+    }
+    return true;
+}
+
+void Editor::selected_lines(size_t& first, size_t& count) const {
+    first = 0;
+    count = buffer_->line_count();
+    if (!selection_active()) return;
+    // a selection that ends at the start of a line leaves that line out
+    int top = std::min(anchor_cy_, cy_);
+    int bottom = std::max(anchor_cy_, cy_);
+    if (bottom > top && (anchor_cy_ > cy_ ? anchor_cx_ : cx_) == 1) --bottom;
+    first = (size_t)(top - 1);
+    count = (size_t)(bottom - top + 1);
+}
+
+void Editor::lines_replaced(size_t first) {
+    // the journal takes the result as one snapshot instead of records
+    if (journal_) journal_->compact(buffer_->snapshot(), buffer_->format());
+    modified_ = true;
+    clear_selection();
+    cursors_.clear();
+    cy_ = (int)std::min(first, buffer_->line_count() - 1) + 1;
+    cx_ = 1;
+    if (!search_query_.empty()) update_search_matches((int)first);
+    scroll();
+}
+
+void Editor::start_filter(const std::string& command) {
+    if (filter_) {
+        status_ = "A filter is running already (Ctrl-C cancels it)";
+        return;
+    }
+    size_t first = 0, count = 0;
+    selected_lines(first, count);
+    auto f = std::make_unique<FilterProcess>();
+    if (!f->start(command, buffer_->snapshot(), first, count)) {
+        status_ = "Cannot run filter: " + f->error();
+        return;
+    }
+    filter_ = std::move(f);
+    filter_command_ = command;
+    filter_buffer_ = buffer_.get();
+    filter_revision_ = buffer_->revision();
+    status_ = "Filtering " + std::to_string(count) + " lines through " + command + " (Ctrl-C cancels)";
+}
+
+bool Editor::poll_filter() {
+    auto state = filter_->pump(std::chrono::milliseconds(FILTER_PUMP_MS));
+    if (state == FilterProcess::State::Running) {
+        std::string progress = "Filtering through " + filter_command_ + ": " + megabytes(filter_->bytes_in()) + " in, " +
+                               megabytes(filter_->bytes_out()) + " out (Ctrl-C cancels)";
+        if (progress == status_) return false;
+        status_ = std::move(progress);
+        return true;
+    }
+    auto f = std::move(filter_);
+    if (state == FilterProcess::State::Failed) {
+        status_ = "Filter failed, nothing changed: " + f->error();
+        return true;
+    }
+    if (filter_buffer_ != buffer_.get() || buffer_->revision() != filter_revision_) {
+        status_ = "Buffer changed while filtering, output dropped";
+        return true;
+    }
+    size_t first = f->first();
+    size_t count = f->count();
+    size_t added = f->lines().size();
+    buffer_->replace_lines(first, count, std::move(f->lines()));
+    lines_replaced(first);
+    status_ = "Filtered " + std::to_string(count) + " lines through " + filter_command_ + ": " +
+              std::to_string(added) + " lines";
+    return true;
+}
+
+void Editor::cancel_filter() {
+    filter_.reset(); // kills the command
+    status_ = "Filter canceled";
+}
+
+void Editor::swap_view(ViewState& v) {
+    std::swap(cx_, v.cx);
+    std::swap(cy_, v.cy);
+    std::swap(row_off_, v.row_off);
+    std::swap(col_off_, v.col_off);
+    std::swap(soft_wrap_, v.soft_wrap);
+    std::swap(wrap_, v.wrap);
+    std::swap(folds_, v.folds);
+    std::swap(selecting_, v.selecting);
+    std::swap(anchor_cx_, v.anchor_cx);
+    std::swap(anchor_cy_, v.anchor_cy);
+    std::swap(block_, v.block);
+    std::swap(block_anchor_col_, v.block_anchor_col);
+    std::swap(block_col_, v.block_col);
+    std::swap(cursors_, v.cursors);
+}
+
+void Editor::swap_document(Document& d) {
+    std::swap(buffer_, d.buffer);
+    std::swap(follow_, d.follow);
+    std::swap(journal_, d.journal);
+    std::swap(brackets_, d.brackets);
+    std::swap(words_, d.words);
+    std::swap(filename_, d.filename);
+    std::swap(modified_, d.modified);
+    std::swap(file_bytes_, d.file_bytes);
+    std::swap(search_query_, d.search_query);
+    std::swap(search_matches_, d.search_matches);
+    std::swap(search_index_, d.search_index);
+}
+
+bool Editor::bracket_pair(size_t& row, size_t& col, size_t& prow, size_t& pcol) {
+    row = (size_t)(cy_ - 1);
+    const std::string& line = buffer_->line(row);
+    for (int c : {cx_ - 1, cx_ - 2}) {
+        // only a bracket character is worth the index
+        if (c < 0 || c >= (int)line.size() || !std::strchr("()[]{}", line[(size_t)c])) continue;
+        if (!brackets_) brackets_ = std::make_unique<BracketIndex>();
+        brackets_->sync(*buffer_);
+        BracketIndex::Pos p;
+        if (brackets_->match(*buffer_, row, (size_t)c, p)) {
+            col = (size_t)c;
+            prow = p.row;
+            pcol = p.col;
+            return true;
         }
     }
+    return false;
+}
+
+bool Editor::enclosing_bracket(size_t& row, size_t& col) {
+    if (!brackets_) brackets_ = std::make_unique<BracketIndex>();
+    brackets_->sync(*buffer_);
+    BracketIndex::Pos p;
+    if (!brackets_->enclosing(*buffer_, (size_t)(cy_ - 1), (size_t)(cx_ - 1), p)) return false;
+    row = p.row;
+    col = p.col;
+    return true;
+}
+
+bool Editor::open_document(const std::string& path) {
+    // not text: page it as hex instead of splitting it into lines at random 0x0A bytes
+    if (file_io::looks_binary(path)) {
+        if (!open_view(path)) return false;
+        view_over_buffers_ = true;
+        status_ += ", Esc goes back";
+        return true;
+    }
+    // an untitled buffer nobody typed into is replaced instead of kept next to the file
+    if (filename_.empty() && !modified_) return open_file(path);
+    size_t prev = doc_;
+    docs_.emplace_back();
+    docs_.back().buffer = std::make_unique<Buffer>();
+    switch_document(docs_.size() - 1);
+    if (open_file(path)) return true;
+    std::string failed = status_;
+    switch_document(prev);
+    docs_.pop_back();
+    status_ = failed;
+    return false;
+}
+
+void Editor::switch_document(size_t index) {
+    if (index >= docs_.size() || index == doc_) return;
+    // the buffer keeps this view for the next time a pane switches to it
+    swap_view(docs_[doc_].view);
+    ViewState superseded;
+    swap_view(superseded);
+    swap_document(docs_[doc_]);
+    doc_ = index;
+    swap_document(docs_[doc_]);
+    swap_view(docs_[doc_].view);
+    if (!wrap_) wrap_ = std::make_unique<WrapIndex>();
+    drawn_row_off_ = -1;
+    status_ = document_list();
+}
+
+void Editor::close_document(bool force) {
+    if (modified_ && !force) {
+        status_ = "Unsaved changes: save first or use close!";
+        return;
+    }
+    std::string name = filename_.empty() ? std::string("(untitled)") : filename_;
+    if (filter_ && filter_buffer_ == buffer_.get()) filter_.reset();
+    if (journal_) {
+        buffer_->set_observer(nullptr);
+        journal_->discard(); // closed on purpose, nothing to recover
+    }
+    size_t closed = doc_;
+    if (docs_.size() == 1) {
+        // the last one: continue with an empty untitled buffer
+        Document gone;
+        swap_document(gone);
+        buffer_ = std::make_unique<Buffer>();
+        ViewState fresh;
+        swap_view(fresh);
+        wrap_ = std::make_unique<WrapIndex>();
+    } else {
+        switch_document(closed + 1 < docs_.size() ? closed + 1 : closed - 1);
+        docs_.erase(docs_.begin() + static_cast<std::ptrdiff_t>(closed));
+        if (doc_ > closed) --doc_;
+    }
+    // other panes that showed it move on to the same buffer as this one
+    for (size_t i = 0; i < panes_.size(); ++i) {
+        auto& p = panes_[i];
+        if (i == pane_) continue;
+        if (p.doc == closed || docs_.size() == 1) {
+            p.doc = doc_;
+            p.view = ViewState();
+            p.drawn_row_off = -1;
+        } else if (p.doc > closed) {
+            --p.doc;
+        }
+    }
+    drawn_row_off_ = -1;
+    status_ = "Closed " + name + (docs_.size() > 1 ? " | " + document_list() : std::string());
+}
+
+PaneRect Editor::text_area() const {
+    auto sz = screen_->size();
+    return PaneRect{2, 1, std::max(1, sz.rows - 2), sz.cols}; // below the header, above the status line
+}
+
+PaneRect Editor::pane_rect() const {
+    if (panes_.size() == 1) return text_area();
+    PaneRect r = layout_->rect_of(pane_, text_area());
+    r.rows = std::max(1, r.rows - 1); // title row
+    return r;
+}
+
+void Editor::focus_pane(size_t pane) {
+    if (pane == pane_ || pane >= panes_.size()) return;
+    panes_[pane_].doc = doc_;
+    panes_[pane_].drawn_row_off = drawn_row_off_;
+    swap_view(panes_[pane_].view);
+    pane_ = pane;
+    swap_view(panes_[pane_].view);
+    drawn_row_off_ = panes_[pane_].drawn_row_off;
+    if (panes_[pane_].doc != doc_) {
+        swap_document(docs_[doc_]);
+        doc_ = panes_[pane_].doc;
+        swap_document(docs_[doc_]);
+    }
+    if (!wrap_) wrap_ = std::make_unique<WrapIndex>();
+    // edits in another pane of the same buffer may have removed the lines under this one
+    int lines = (int)buffer_->line_count();
+    cy_ = std::clamp(cy_, 1, std::max(1, lines));
+    cx_ = std::min(cx_, (int)buffer_->line_length((size_t)(cy_ - 1)) + 1);
+    anchor_cy_ = std::clamp(anchor_cy_, 1, std::max(1, lines));
+    anchor_cx_ = std::min(anchor_cx_, (int)buffer_->line_length((size_t)(anchor_cy_ - 1)) + 1);
+    cursors_.erase(std::remove_if(cursors_.begin(), cursors_.end(), [&](const Cursor& c) { return c.cy > lines; }),
+                   cursors_.end());
+    for (auto& c : cursors_) {
+        int len = (int)buffer_->line_length((size_t)(c.cy - 1));
+        c.cx = std::min(c.cx, len + 1);
+        c.anchor_cx = std::min(c.anchor_cx, len + 1);
+    }
+    if (!soft_wrap_) {
+        FoldIndex* folds = synced_folds();
+        int rows = folds ? (int)folds->visible_lines() : lines;
+        row_off_ = std::min(row_off_, std::max(0, rows - 1));
+    }
+}
+
+void Editor::split_pane(bool vertical) {
+    size_t added = layout_->split(pane_, vertical);
+    panes_.emplace_back();
+    // the new pane starts where this one is
+    Pane& p = panes_[added];
+    p.doc = doc_;
+    p.view.cx = cx_;
+    p.view.cy = cy_;
+    p.view.row_off = row_off_;
+    p.view.col_off = col_off_;
+    p.view.soft_wrap = soft_wrap_;
+    if (folds_) p.view.folds = std::make_unique<FoldIndex>(*folds_); // row_off_ counts visible lines
+    for (auto& other : panes_) other.drawn_row_off = -1;
+    focus_pane(added);
+    drawn_row_off_ = -1;
+    scroll();
+}
+
+void Editor::close_pane() {
+    if (panes_.size() == 1) {
+        status_ = "Only one pane";
+        return;
+    }
+    size_t closing = pane_;
+    focus_pane(layout_->next(pane_));
+    layout_->close(closing);
+    panes_.erase(panes_.begin() + static_cast<std::ptrdiff_t>(closing));
+    if (pane_ > closing) --pane_;
+    for (auto& p : panes_) p.drawn_row_off = -1;
+    drawn_row_off_ = -1;
+    scroll();
+}
+
+// "1:a.c [2:b.c*] 3:c.h", the current one in brackets, * for unsaved changes
+std::string Editor::document_list() const {
+    std::string s;
+    for (size_t i = 0; i < docs_.size(); ++i) {
+        bool current = i == doc_;
+        const std::string& name = current ? filename_ : docs_[i].filename;
+        std::string entry = std::to_string(i + 1) + ":" + (name.empty() ? std::string("(untitled)") : name);
+        if (current ? modified_ : docs_[i].modified) entry += "*";
+        if (!s.empty()) s += " ";
+        s += current ? "[" + entry + "]" : entry;
+    }
+    return s;
+}
+
+void Editor::start_journal() {
+    buffer_->set_observer(nullptr);
+    journal_.reset();
+    std::string path = Journal::path_for(filename_);
+    auto journal = std::make_unique<Journal>();
+    if (!journal->lock(filename_)) {
+        // like a swap file in use: that session's journal is left alone, this one keeps none
+        status_ = "Another termite is editing " + filename_ + ": no journal for this session";
+        return;
+    }
+    auto rec = Journal::recover(filename_, *buffer_);
+    if (rec.found && !rec.matches) {
+        // written against another version of the file (changed since): set aside, not replayed
+        std::error_code ec;
+        std::filesystem::rename(path, path + ".stale", ec);
+        status_ = "Journal of an older version of the file moved to " + path + ".stale";
+    } else if (rec.records > 0) {
+        modified_ = true;
+        status_ = "Recovered " + std::to_string(rec.records) + " unsaved edits from " + path;
+    }
+    journal_ = std::move(journal);
+    journal_->open(filename_, rec.matches ? rec.valid_bytes : 0);
+    buffer_->set_observer(journal_.get());
+}
+
+int Editor::text_width() const {
+    auto digits = [](int n){ int d = 1; while (n >= 10) { n /= 10; ++d; } return d; };
+    int lnw = std::max(4, digits((int)buffer_->line_count()));
+    return std::max(1, pane_rect().cols - (lnw + 2));
+}
+
+int64_t Editor::cursor_vrow() {
+    wrap_->sync(*buffer_, text_width(), synced_folds());
+    size_t row = (size_t)std::clamp(cy_ - 1, 0, (int)buffer_->line_count() - 1);
+    wrap_->measure(*buffer_, *layouts_, row);
+    auto& lay = layouts_->get_mut(*buffer_, row);
+    const auto& starts = wrap_rows(buffer_->line(row), lay, text_width());
+    int col = lay.col_of(cx_ - 1);
+    auto sub = std::upper_bound(starts.begin(), starts.end(), col) - starts.begin() - 1;
+    return wrap_->row_of_line(row) + sub;
+}
+
+void Editor::move_visual(int delta) {
+    int64_t from = cursor_vrow();
+    size_t row = (size_t)(cy_ - 1);
+    auto& cur = layouts_->get_mut(*buffer_, row);
+    const auto& cur_starts = wrap_rows(buffer_->line(row), cur, text_width());
+    int goal = cur.col_of(cx_ - 1) - cur_starts[(size_t)(from - wrap_->row_of_line(row))];
+
+    int64_t to = std::clamp<int64_t>(from + delta, 0, wrap_->total_rows() - 1);
+    int sub = 0;
+    size_t line = wrap_->line_at(to, sub);
+    int rows = wrap_->measure(*buffer_, *layouts_, line);
+    if (sub >= rows) sub = rows - 1;
+    auto& lay = layouts_->get_mut(*buffer_, line);
+    const auto& starts = wrap_rows(buffer_->line(line), lay, text_width());
+    int col = starts[(size_t)sub] + goal;
+    // stay on this visual row: the next row's first column already belongs to the next row
+    if (sub + 1 < rows) col = std::min(col, starts[(size_t)sub + 1] - 1);
+    cy_ = (int)line + 1;
+    cx_ = lay.byte_at(col) + 1;
+}
+
+int64_t Editor::cursor_row() {
+    if (soft_wrap_) return cursor_vrow();
+    FoldIndex* folds = synced_folds();
+    return folds ? (int64_t)folds->row_of_line((size_t)(cy_ - 1)) : cy_ - 1;
+}
+
+FoldIndex* Editor::synced_folds() {
+    if (!folds_) return nullptr;
+    folds_->sync(*buffer_);
+    return folds_->empty() ? nullptr : folds_.get();
+}
+
+void Editor::move_lines(int delta) {
+    int lines = (int)buffer_->line_count();
+    FoldIndex* folds = synced_folds();
+    if (!folds) {
+        cy_ = std::clamp(cy_ + delta, 1, std::max(1, lines));
+        return;
+    }
+    int64_t to = std::clamp<int64_t>((int64_t)folds->row_of_line((size_t)(cy_ - 1)) + delta, 0,
+                                     (int64_t)folds->visible_lines() - 1);
+    cy_ = (int)folds->line_at((size_t)to) + 1;
 }
 
 void Editor::scroll() {
+    profiler::Scope prof(profiler::Phase::Scroll);
     const auto& lines = buffer_->lines();
     int max_line_rows = (int)lines.size();
     int line_index = (cy_ >= 1 && cy_ <= max_line_rows) ? (cy_ - 1) : -1;
-    auto disp_col = [](const std::string& s, int char_col, int tabw) {
-        if (char_col < 0) char_col = 0;
-        if (char_col > (int)s.size()) char_col = (int)s.size();
-        int col = 0;
-        for (int i = 0; i < char_col; ++i) {
-            if (s[i] == '\t') { int spaces = tabw - (col % tabw); col += spaces; }
-            else { col += 1; }
-        }
-        return col;
-    };
-    auto disp_len = [&](const std::string& s) { return disp_col(s, (int)s.size(), 4); };
 
-    auto sz = screen_->size();
-    int header_rows = 1;
-    int status_rows = 1;
-    int max_rows = sz.rows - header_rows - status_rows;
-    if (max_rows < 1) max_rows = 1;
-    if (cy_ < row_off_ + 1) {
-        row_off_ = cy_ - 1;
+    PaneRect area = pane_rect();
+    int max_rows = std::max(1, area.rows);
+    // the cursor got into a fold (search, goto, edits): open what hides it
+    FoldIndex* folds = synced_folds();
+    if (folds && line_index >= 0 && folds->hidden((size_t)line_index)) {
+        folds->reveal((size_t)line_index);
+        folds = synced_folds();
+    }
+    if (soft_wrap_) {
+        // nothing runs off to the right, only keep the cursor's visual row on screen
+        col_off_ = 0;
+        int64_t vrow = cursor_vrow();
+        if (vrow < row_off_) row_off_ = (int)vrow;
+        else if (vrow >= row_off_ + max_rows) row_off_ = (int)(vrow - max_rows + 1);
+        return;
+    }
+    // folded: rows are visible lines, the cursor's is the number of them above it
+    int cur = cy_;
+    int rows = max_line_rows;
+    if (folds && line_index >= 0) {
+        cur = (int)folds->row_of_line((size_t)line_index) + 1;
+        rows = (int)folds->visible_lines();
+    }
+    if (cur < row_off_ + 1) {
+        row_off_ = cur - 1;
         if (row_off_ < 0) row_off_ = 0;
-    } else if (cy_ > row_off_ + max_rows) {
-        row_off_ = cy_ - max_rows;
+    } else if (cur > row_off_ + max_rows) {
+        row_off_ = cur - max_rows;
         if (row_off_ < 0) row_off_ = 0;
-        if (cy_ > max_line_rows) {
-            row_off_ = std::max(0, max_line_rows - max_rows);
+        if (cur > rows) {
+            row_off_ = std::max(0, rows - max_rows);
         }
     }
 
-    int max_cols = sz.cols;
+    int max_cols = area.cols;
     auto digits = [](int n){ int d = 1; while (n >= 10) { n /= 10; ++d; } return d; };
     int lnw = std::max(4, digits((int)lines.size()));
     int text_cols = std::max(1, max_cols - (lnw + 2));
     if (line_index >= 0) {
-        const std::string& line = lines[line_index];
-        int c_disp = disp_col(line, cx_ - 1, 4);
-        int line_disp_len = disp_len(line);
+        const LineLayout& lay = layouts_->get(*buffer_, (size_t)line_index);
+        int c_disp = lay.col_of(cx_ - 1);
+        int line_disp_len = lay.width;
         if (c_disp < col_off_) {
             col_off_ = c_disp;
             if (col_off_ < 0) col_off_ = 0;
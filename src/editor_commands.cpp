@@ -0,0 +1,198 @@
+#include "termite/editor.hpp"
+
+#include "termite/buffer.hpp"
+#include "termite/follow.hpp"
+#include "termite/line_sort.hpp"
+#include "termite/profiler.hpp"
+#include "termite/screen.hpp"
+#include "termite/wrap.hpp"
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+namespace termite
+{
+
+    void Editor::reorder_lines(const std::string &name, const std::string &args)
+    {
+        size_t first = 0, count = 0;
+        selected_lines(first, count);
+        std::vector<size_t> rows;
+        if (name == "reverse")
+        {
+            for (size_t row = first + count; row-- > first;)
+                rows.push_back(row);
+        }
+        else if (name == "unique")
+        {
+            rows = unique_rows(buffer_->snapshot(), first, count);
+        }
+        else
+        {
+            SortSpec spec;
+            std::istringstream in(args);
+            std::string flag;
+            while (in >> flag)
+            {
+                if (flag == "-k" && in >> spec.field && spec.field > 0)
+                    continue;
+                if (flag.size() < 2 || flag[0] != '-' || flag.find_first_not_of("nru", 1) != std::string::npos)
+                {
+                    status_ = "usage: sort [-n] [-r] [-u] [-k <field>]";
+                    return;
+                }
+                spec.numeric |= flag.find('n') != std::string::npos;
+                spec.reverse |= flag.find('r') != std::string::npos;
+                spec.unique |= flag.find('u') != std::string::npos;
+            }
+            rows = sorted_rows(buffer_->snapshot(), first, count, spec);
+        }
+        buffer_->reorder_lines(first, count, rows);
+        lines_replaced(first);
+        status_ = name + ": " + std::to_string(count) + " lines";
+        if (rows.size() != count)
+            status_ += ", " + std::to_string(count - rows.size()) + " duplicates removed";
+    }
+
+    // Commands typed at the Ctrl-E prompt: first word is the command, the rest its arguments
+    void Editor::run_command(const std::string &cmd)
+    {
+        std::istringstream in(cmd);
+        std::string name;
+        in >> name;
+
+        if (name == "wrap")
+        {
+            soft_wrap_ = !soft_wrap_;
+            row_off_ = 0;
+            col_off_ = 0;
+            drawn_row_off_ = -1; // row_off_ changes meaning, nothing to scroll
+            if (soft_wrap_)
+                wrap_->reset(*buffer_, text_width(), synced_folds());
+            status_ = soft_wrap_ ? "Soft wrap on" : "Soft wrap off";
+        }
+        else if (name == "profiler")
+        {
+#ifdef TERMITE_PROFILER
+            profiler::set_enabled(!profiler::enabled());
+            status_ = profiler::enabled() ? "Profiler on" : "Profiler off";
+#else
+            status_ = "Profiler not built in (configure with -DTERMITE_ENABLE_PROFILER=ON)";
+#endif
+        }
+        else if (name == "fps")
+        {
+            int hz = 0;
+            if (in >> hz && hz > 0)
+            {
+                frame_hz_ = hz;
+                status_ = "Frame rate limit: " + std::to_string(hz) + " Hz";
+            }
+            else
+            {
+                status_ = "Frame rate limit: " + std::to_string(frame_hz_) + " Hz (usage: fps <hz>)";
+            }
+        }
+        else if (name == "follow")
+        {
+            if (view_)
+                status_ = "Follow works on the editable buffer, not in --view";
+            else
+                set_follow(!follow_);
+        }
+        else if (name == "open")
+        {
+            std::string path;
+            std::getline(in >> std::ws, path);
+            if (path.empty())
+                status_ = "usage: open <file>";
+            else if (open_document(path) && docs_.size() > 1)
+                status_ = document_list();
+        }
+        else if (name == "next" || name == "prev")
+        {
+            size_t n = docs_.size();
+            switch_document(name == "next" ? (doc_ + 1) % n : (doc_ + n - 1) % n);
+            status_ = document_list();
+        }
+        else if (name == "buffer")
+        {
+            size_t index = 0;
+            if (in >> index && index >= 1 && index <= docs_.size())
+                switch_document(index - 1);
+            status_ = document_list();
+        }
+        else if (name == "buffers")
+        {
+            status_ = document_list();
+        }
+        else if (name == "close" || name == "close!")
+        {
+            close_document(name == "close!");
+        }
+        else if (name == "split" || name == "vsplit")
+        {
+            if (view_)
+                status_ = "Splits work on the editable buffer, not in --view";
+            else
+                split_pane(name == "vsplit");
+        }
+        else if (name == "unsplit")
+        {
+            close_pane();
+        }
+        else if (name == "cursors")
+        {
+            // "cursors": one per search match, "cursors <n>": a column of n more below the cursor
+            int n = 0;
+            if (in >> n)
+                add_cursor_column(n < 0 ? -1 : 1, std::abs(n));
+            else
+                add_cursors_at_matches();
+        }
+        else if (name == "fold")
+        {
+            // "fold": toggle at the cursor, "fold all": every top-level region
+            std::string arg;
+            in >> arg;
+            if (arg == "all")
+                fold_all(true);
+            else
+                toggle_fold();
+        }
+        else if (name == "unfold")
+        {
+            fold_all(false);
+        }
+        else if (name == "sort" || name == "unique" || name == "reverse")
+        {
+            std::string args;
+            std::getline(in, args);
+            if (view_)
+                status_ = "Sorting works on the editable buffer, not in --view";
+            else
+                reorder_lines(name, args);
+        }
+        else if (name == "filter" || name[0] == '!')
+        {
+            // "filter <command>" or "!<command>": the selected lines (all of them without a selection)
+            std::string command = name == "filter" ? std::string() : name.substr(1);
+            std::string rest;
+            std::getline(in, rest);
+            command += rest;
+            command.erase(0, command.find_first_not_of(' '));
+            if (view_)
+                status_ = "Filters work on the editable buffer, not in --view";
+            else if (command.empty())
+                status_ = "usage: filter <command>  (or !<command>)";
+            else
+                start_filter(command);
+        }
+        else
+        {
+            status_ = "Unknown command: " + name;
+        }
+    }
+
+}
@@ -0,0 +1,108 @@
+#include "termite/editor.hpp"
+
+#include "termite/buffer.hpp"
+#include "termite/input.hpp"
+#include "termite/syntax.hpp"
+#include "termite/words.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+namespace termite
+{
+
+    namespace
+    {
+        // Entries of the completion list
+        constexpr size_t MAX_COMPLETIONS = 10;
+    }
+
+    void Editor::update_completion()
+    {
+        completing_ = false;
+        completions_.clear();
+        completion_index_ = 0;
+        const std::string &line = buffer_->line((size_t)(cy_ - 1));
+        size_t end = std::min((size_t)(cx_ - 1), line.size());
+        size_t start = end;
+        while (start > 0 && is_word_byte(line[start - 1]))
+            --start;
+        if (start == end || std::isdigit((unsigned char)line[start]))
+            return;
+        completion_prefix_ = line.substr(start, end - start);
+        // the first ones of every buffer, merged: the first ones of all of them
+        auto collect = [&](const Buffer &buf, std::unique_ptr<WordIndex> &words)
+        {
+            if (!words)
+                words = std::make_unique<WordIndex>();
+            words->sync(buf);
+            words->complete(completion_prefix_, MAX_COMPLETIONS, completions_);
+        };
+        collect(*buffer_, words_);
+        for (size_t i = 0; i < docs_.size(); ++i)
+            if (i != doc_ && docs_[i].buffer)
+                collect(*docs_[i].buffer, docs_[i].words);
+        std::sort(completions_.begin(), completions_.end());
+        completions_.erase(std::unique(completions_.begin(), completions_.end()), completions_.end());
+        if (completions_.size() > MAX_COMPLETIONS)
+            completions_.resize(MAX_COMPLETIONS);
+        completing_ = !completions_.empty();
+    }
+
+    void Editor::start_completion()
+    {
+        update_completion();
+        if (!completing_)
+        {
+            status_ = "No completions";
+            return;
+        }
+        // only one: take it right away
+        if (completions_.size() == 1)
+            handle_completion_key(input::KEY_ENTER);
+    }
+
+    bool Editor::handle_completion_key(int key)
+    {
+        int n = (int)completions_.size();
+        switch (key)
+        {
+        case input::KEY_UP:
+            completion_index_ = (completion_index_ + n - 1) % n;
+            return true;
+        case input::KEY_DOWN:
+            completion_index_ = (completion_index_ + 1) % n;
+            return true;
+        case input::KEY_ENTER:
+        case '\t':
+        {
+            // type the rest of the word, so every cursor and the journal get it like typed keys
+            std::string rest = completions_[(size_t)completion_index_].substr(completion_prefix_.size());
+            completing_ = false;
+            for (char ch : rest)
+                handle_input((unsigned char)ch);
+            return true;
+        }
+        case 27: // ESC
+        case input::KEY_CTRL_C:
+            completing_ = false;
+            return true;
+        case input::KEY_BACKSPACE:
+            completing_ = false;
+            handle_input(key);
+            update_completion();
+            return true;
+        default:
+            completing_ = false;
+            if (key > 0 && key <= 0xFF && is_word_byte((char)key))
+            {
+                handle_input(key);
+                update_completion();
+                return true;
+            }
+            return false; // anything else closes the list and does what it always does
+        }
+    }
+
+}
@@ -0,0 +1,497 @@
+#include "termite/editor.hpp"
+
+#include "termite/buffer.hpp"
+#include "termite/input.hpp"
+#include "termite/layout.hpp"
+#include "termite/syntax.hpp"
+#include "termite/unicode.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace termite
+{
+
+    namespace
+    {
+        // One cursor of a batched edit: [col, col + sel) selected on row, who = index into the extra
+        // cursors or -1 for the primary one
+        struct Caret
+        {
+            size_t row;
+            size_t col;
+            size_t sel;
+            int who;
+        };
+
+        // Bytes [b0, b1) of display columns [c0, c1) of a line. A line that is printable ASCII up to
+        // c1 maps columns to bytes one to one, only others get laid out (into scratch, so a block
+        // over a million lines does not fill the layout cache).
+        void block_bytes(const std::string &line, int c0, int c1, LineLayout &scratch, size_t &b0, size_t &b1)
+        {
+            size_t n = std::min(line.size(), (size_t)c1);
+            size_t i = 0;
+            while (i < n && (unsigned char)line[i] >= 0x20 && (unsigned char)line[i] < 0x7f)
+                ++i;
+            if (i == n)
+            {
+                b0 = std::min(line.size(), (size_t)c0);
+                b1 = n;
+                return;
+            }
+            build_layout(line, scratch);
+            b0 = (size_t)scratch.byte_at(c0);
+            b1 = (size_t)scratch.byte_at(c1);
+        }
+    }
+
+    void Editor::normalize_cursors()
+    {
+        auto before = [](const Cursor &a, const Cursor &b)
+        { return a.cy != b.cy ? a.cy < b.cy : a.cx < b.cx; };
+        std::sort(cursors_.begin(), cursors_.end(), before);
+        auto same = [](const Cursor &a, const Cursor &b)
+        { return a.cy == b.cy && a.cx == b.cx; };
+        cursors_.erase(std::unique(cursors_.begin(), cursors_.end(), same), cursors_.end());
+        cursors_.erase(std::remove_if(cursors_.begin(), cursors_.end(), [&](const Cursor &c)
+                                      { return c.cy == cy_ && c.cx == cx_; }),
+                       cursors_.end());
+    }
+
+    void Editor::add_cursor_at_next_match()
+    {
+        if (!selection_active())
+        {
+            // first Ctrl-D selects the word under the cursor
+            const std::string &s = buffer_->line((size_t)(cy_ - 1));
+            int b = cx_ - 1, e = cx_ - 1;
+            while (b > 0 && is_word_byte(s[(size_t)b - 1]))
+                --b;
+            while (e < (int)s.size() && is_word_byte(s[(size_t)e]))
+                ++e;
+            if (b == e)
+            {
+                status_ = "No word at the cursor";
+                return;
+            }
+            selecting_ = true;
+            block_ = false;
+            anchor_cy_ = cy_;
+            anchor_cx_ = b + 1;
+            cx_ = e + 1;
+            return;
+        }
+        if (anchor_cy_ != cy_)
+        {
+            status_ = "Select text on one line to add cursors at its next match";
+            return;
+        }
+        int a = std::min(anchor_cx_, cx_) - 1;
+        std::string needle = buffer_->line((size_t)(cy_ - 1)).substr((size_t)a, (size_t)std::abs(cx_ - anchor_cx_));
+        // search on from the last cursor, wrapping around the end of the buffer
+        int row = cy_ - 1;
+        size_t from = (size_t)std::max(cx_, anchor_cx_) - 1;
+        if (!cursors_.empty() && (cursors_.back().cy > cy_ || (cursors_.back().cy == cy_ && cursors_.back().cx > cx_)))
+        {
+            row = cursors_.back().cy - 1;
+            from = (size_t)std::max(cursors_.back().cx, cursors_.back().anchor_cx) - 1;
+        }
+        auto taken = [&](int r, int end)
+        {
+            if (r == cy_ - 1 && std::max(cx_, anchor_cx_) - 1 == end)
+                return true;
+            return std::any_of(cursors_.begin(), cursors_.end(), [&](const Cursor &c)
+                               { return c.cy - 1 == r && std::max(c.cx, c.anchor_cx) - 1 == end; });
+        };
+        int lines = (int)buffer_->line_count();
+        for (int n = 0; n <= lines; ++n)
+        {
+            const std::string &s = buffer_->line((size_t)row);
+            for (size_t pos = s.find(needle, from); pos != std::string::npos; pos = s.find(needle, pos + 1))
+            {
+                int end = (int)(pos + needle.size());
+                if (taken(row, end))
+                    continue;
+                cursors_.push_back(Cursor{end + 1, row + 1, (int)pos + 1});
+                normalize_cursors();
+                status_ = std::to_string(cursors_.size() + 1) + " cursors";
+                return;
+            }
+            row = (row + 1) % lines;
+            from = 0;
+        }
+        status_ = "No more matches";
+    }
+
+    void Editor::add_cursor_column(int dir, int count)
+    {
+        // continue the column above the topmost / below the bottommost cursor
+        int row = cy_;
+        if (!cursors_.empty())
+            row = dir < 0 ? std::min(row, cursors_.front().cy) : std::max(row, cursors_.back().cy);
+        int goal = layouts_->get(*buffer_, (size_t)(cy_ - 1)).col_of(cx_ - 1);
+        int lines = (int)buffer_->line_count();
+        cursors_.reserve(cursors_.size() + (size_t)std::max(0, count));
+        for (int i = 0; i < count; ++i)
+        {
+            row += dir;
+            if (row < 1 || row > lines)
+                break;
+            int cx = layouts_->get(*buffer_, (size_t)(row - 1)).byte_at(goal) + 1;
+            cursors_.push_back(Cursor{cx, row, cx});
+        }
+        normalize_cursors();
+        if (!cursors_.empty())
+            status_ = std::to_string(cursors_.size() + 1) + " cursors";
+    }
+
+    void Editor::add_cursors_at_matches()
+    {
+        if (search_matches_.empty())
+        {
+            status_ = "No search matches (Ctrl-F first)";
+            return;
+        }
+        // every match selected, the current one keeps being the primary cursor
+        const Match &cur = search_matches_[(size_t)std::max(0, search_index_)];
+        cy_ = cur.line + 1;
+        cx_ = cur.end + 1;
+        anchor_cy_ = cy_;
+        anchor_cx_ = cur.start + 1;
+        selecting_ = true;
+        block_ = false;
+        cursors_.clear();
+        cursors_.reserve(search_matches_.size());
+        int last_line = -1, last_end = 0;
+        for (const auto &m : search_matches_)
+        {
+            // overlapping matches ("aa" in "aaa") cannot all be replaced
+            if (m.line == last_line && m.start < last_end)
+                continue;
+            last_line = m.line;
+            last_end = m.end;
+            cursors_.push_back(Cursor{m.end + 1, m.line + 1, m.start + 1});
+        }
+        normalize_cursors();
+        // the primary match may have been dropped as an overlap of the one before it
+        cursors_.erase(std::remove_if(cursors_.begin(), cursors_.end(), [&](const Cursor &c)
+                                      { return c.cy == cy_ && std::min(c.cx, c.anchor_cx) < cx_ && std::max(c.cx, c.anchor_cx) > anchor_cx_; }),
+                       cursors_.end());
+        status_ = std::to_string(cursors_.size() + 1) + " cursors";
+        scroll();
+    }
+
+    bool Editor::handle_cursors_key(int key)
+    {
+        switch (key)
+        {
+        case input::KEY_BACKSPACE:
+        case input::KEY_DELETE:
+        case input::KEY_ENTER:
+            edit_at_cursors(key);
+            return true;
+        case input::KEY_LEFT:
+        case input::KEY_RIGHT:
+        case input::KEY_UP:
+        case input::KEY_DOWN:
+        case input::KEY_HOME:
+        case input::KEY_END:
+        {
+            // the extra cursors move by logical lines, the primary one moves as usual after this
+            int lines = (int)buffer_->line_count();
+            for (auto &c : cursors_)
+            {
+                const std::string &s = buffer_->line((size_t)(c.cy - 1));
+                int len = (int)s.size();
+                switch (key)
+                {
+                case input::KEY_LEFT:
+                    if (c.cx > 1)
+                        c.cx = (int)unicode::prev_grapheme(s, (size_t)(c.cx - 1)) + 1;
+                    else if (c.cy > 1)
+                        c.cx = (int)buffer_->line_length((size_t)(--c.cy - 1)) + 1;
+                    break;
+                case input::KEY_RIGHT:
+                    if (c.cx <= len)
+                        c.cx = (int)unicode::next_grapheme(s, (size_t)(c.cx - 1)) + 1;
+                    else if (c.cy < lines)
+                    {
+                        ++c.cy;
+                        c.cx = 1;
+                    }
+                    break;
+                case input::KEY_UP:
+                case input::KEY_DOWN:
+                {
+                    int row = c.cy + (key == input::KEY_UP ? -1 : 1);
+                    if (row < 1 || row > lines)
+                        break;
+                    int goal = layouts_->get(*buffer_, (size_t)(c.cy - 1)).col_of(c.cx - 1);
+                    c.cy = row;
+                    c.cx = layouts_->get(*buffer_, (size_t)(row - 1)).byte_at(goal) + 1;
+                    break;
+                }
+                case input::KEY_HOME:
+                    c.cx = 1;
+                    break;
+                default:
+                    c.cx = len + 1;
+                    break;
+                }
+                c.anchor_cx = c.cx;
+            }
+            return false;
+        }
+        case input::KEY_CTRL_C:
+        case input::KEY_CTRL_S:
+        case input::KEY_CTRL_Q:
+        case input::KEY_UNKNOWN:
+            return false;
+        default:
+            if ((key >= 32 && key <= 126) || key == '\t' || (key >= 0x80 && key <= 0xFF))
+            {
+                edit_at_cursors(key);
+                return true;
+            }
+            // ESC and every other key go back to a single cursor
+            cursors_.clear();
+            return false;
+        }
+    }
+
+    void Editor::edit_at_cursors(int key)
+    {
+        // a selection over several lines does not fit the per-line batch, it is dropped
+        if (selecting_ && anchor_cy_ != cy_)
+            clear_selection();
+        std::vector<Caret> carets;
+        carets.reserve(cursors_.size() + 1);
+        auto add = [&](int cx, int cy, int anchor_cx, int who)
+        {
+            int len = (int)buffer_->line_length((size_t)(cy - 1));
+            int a = std::clamp(std::min(cx, anchor_cx) - 1, 0, len);
+            int b = std::clamp(std::max(cx, anchor_cx) - 1, 0, len);
+            carets.push_back(Caret{(size_t)(cy - 1), (size_t)a, (size_t)(b - a), who});
+        };
+        add(cx_, cy_, selecting_ ? anchor_cx_ : cx_, -1);
+        for (size_t i = 0; i < cursors_.size(); ++i)
+            add(cursors_[i].cx, cursors_[i].cy, cursors_[i].anchor_cx, (int)i);
+        std::sort(carets.begin(), carets.end(), [](const Caret &a, const Caret &b)
+                  { return a.row != b.row ? a.row < b.row : a.col < b.col; });
+        // a cursor inside the selection of the one before it goes away with that selection
+        size_t kept = 0;
+        for (size_t i = 0; i < carets.size(); ++i)
+        {
+            if (kept > 0 && carets[kept - 1].row == carets[i].row &&
+                carets[i].col < carets[kept - 1].col + std::max<size_t>(carets[kept - 1].sel, 1))
+            {
+                if (carets[i].who < 0)
+                    carets[kept - 1].who = -1;
+                continue;
+            }
+            carets[kept++] = carets[i];
+        }
+        carets.resize(kept);
+
+        // pass 1: selections go, and with nothing selected Backspace / Delete take one grapheme
+        std::vector<LineSpan> spans;
+        spans.reserve(carets.size());
+        for (const auto &c : carets)
+        {
+            size_t col = c.col, len = c.sel;
+            if (len == 0 && key == input::KEY_BACKSPACE && col > 0)
+            {
+                col = unicode::prev_grapheme(buffer_->line(c.row), c.col);
+                len = c.col - col;
+            }
+            else if (len == 0 && key == input::KEY_DELETE && col < buffer_->line_length(c.row))
+            {
+                len = unicode::next_grapheme(buffer_->line(c.row), c.col) - col;
+            }
+            // the grapheme left of a cursor can be the end of the previous cursor's selection
+            if (!spans.empty() && spans.back().row == c.row && col < spans.back().col + spans.back().len)
+            {
+                size_t end = col + len;
+                col = spans.back().col + spans.back().len;
+                len = end > col ? end - col : 0;
+            }
+            spans.push_back(LineSpan{c.row, col, len});
+        }
+        buffer_->erase_at(spans);
+        size_t shift = 0;
+        for (size_t i = 0; i < carets.size(); ++i)
+        {
+            if (i == 0 || carets[i].row != carets[i - 1].row)
+                shift = 0;
+            carets[i].col = spans[i].col - shift;
+            carets[i].sel = 0;
+            shift += spans[i].len;
+        }
+
+        // pass 2: what the key adds
+        if (key == input::KEY_ENTER)
+        {
+            // every split moves the cursors after it one line down
+            for (size_t i = carets.size(); i-- > 0;)
+                buffer_->split_line(carets[i].row, carets[i].col);
+            for (size_t i = 0; i < carets.size(); ++i)
+            {
+                carets[i].row += i + 1;
+                carets[i].col = 0;
+            }
+        }
+        else if (key != input::KEY_BACKSPACE && key != input::KEY_DELETE)
+        {
+            std::vector<LinePos> at;
+            at.reserve(carets.size());
+            for (const auto &c : carets)
+                at.push_back(LinePos{c.row, c.col});
+            char ch = static_cast<char>(key);
+            buffer_->insert_at(at, std::string_view(&ch, 1));
+            size_t on_row = 0;
+            for (size_t i = 0; i < carets.size(); ++i)
+            {
+                on_row = (i > 0 && carets[i].row == carets[i - 1].row) ? on_row + 1 : 1;
+                carets[i].col += on_row;
+            }
+        }
+
+        std::vector<Cursor> moved;
+        moved.reserve(carets.size());
+        for (const auto &c : carets)
+        {
+            int cx = (int)c.col + 1, cy = (int)c.row + 1;
+            if (c.who < 0)
+            {
+                cx_ = cx;
+                cy_ = cy;
+            }
+            else
+                moved.push_back(Cursor{cx, cy, cx});
+        }
+        cursors_.swap(moved);
+        normalize_cursors();
+        clear_selection();
+        modified_ = true;
+        scroll();
+    }
+
+    void Editor::extend_block(int key)
+    {
+        if (!selecting_ || !block_)
+        {
+            selecting_ = true;
+            block_ = true;
+            anchor_cx_ = cx_;
+            anchor_cy_ = cy_;
+            block_col_ = block_anchor_col_ = layouts_->get(*buffer_, (size_t)(cy_ - 1)).col_of(cx_ - 1);
+            cursors_.clear();
+        }
+        switch (key)
+        {
+        case input::KEY_ALT_SHIFT_UP:
+            if (cy_ > 1)
+                --cy_;
+            break;
+        case input::KEY_ALT_SHIFT_DOWN:
+            if (cy_ < (int)buffer_->line_count())
+                ++cy_;
+            break;
+        case input::KEY_ALT_SHIFT_LEFT:
+            if (block_col_ > 0)
+                --block_col_;
+            break;
+        default:
+            ++block_col_;
+            break;
+        }
+        cx_ = layouts_->get(*buffer_, (size_t)(cy_ - 1)).byte_at(block_col_) + 1;
+    }
+
+    bool Editor::block_range(int &r0, int &r1, int &c0, int &c1) const
+    {
+        if (!selecting_ || !block_)
+            return false;
+        r0 = std::min(anchor_cy_, cy_) - 1;
+        r1 = std::min(std::max(anchor_cy_, cy_), (int)buffer_->line_count()) - 1;
+        c0 = std::min(block_anchor_col_, block_col_);
+        c1 = std::max(block_anchor_col_, block_col_);
+        return true;
+    }
+
+    void Editor::copy_block()
+    {
+        int r0, r1, c0, c1;
+        if (!block_range(r0, r1, c0, c1))
+            return;
+        // one pass, into a buffer sized for the block (exact unless lines hold tabs or UTF-8)
+        std::string out;
+        out.reserve((size_t)(r1 - r0 + 1) * (size_t)(c1 - c0 + 1));
+        LineLayout scratch;
+        for (int row = r0; row <= r1; ++row)
+        {
+            const std::string &line = buffer_->line((size_t)row);
+            size_t b0, b1;
+            block_bytes(line, c0, c1, scratch, b0, b1);
+            out.append(line, b0, b1 - b0);
+            if (row < r1)
+                out.push_back('\n');
+        }
+        clipboard_ = std::move(out);
+        status_ = "Copied block of " + std::to_string(r1 - r0 + 1) + " lines";
+    }
+
+    void Editor::delete_block()
+    {
+        int r0, r1, c0, c1;
+        if (!block_range(r0, r1, c0, c1))
+            return;
+        std::vector<LineSpan> spans;
+        spans.reserve((size_t)(r1 - r0 + 1));
+        LineLayout scratch;
+        for (int row = r0; row <= r1; ++row)
+        {
+            size_t b0, b1;
+            block_bytes(buffer_->line((size_t)row), c0, c1, scratch, b0, b1);
+            if (b1 > b0)
+                spans.push_back(LineSpan{(size_t)row, b0, b1 - b0});
+        }
+        buffer_->erase_at(spans);
+        if (!spans.empty())
+            modified_ = true;
+        // the block shrinks to a column at c0; anchor_cy_ stays, so edit_block can keep using it
+        block_col_ = block_anchor_col_ = c0;
+        cx_ = layouts_->get(*buffer_, (size_t)(cy_ - 1)).byte_at(c0) + 1;
+        anchor_cx_ = layouts_->get(*buffer_, (size_t)(anchor_cy_ - 1)).byte_at(c0) + 1;
+        selecting_ = false;
+    }
+
+    void Editor::edit_block(int key)
+    {
+        int r0, r1, c0, c1;
+        if (!block_range(r0, r1, c0, c1))
+            return;
+        delete_block();
+        if (c1 > c0 && (key == input::KEY_BACKSPACE || key == input::KEY_DELETE))
+        {
+            // what was selected is gone, the column stays for typing into
+            selecting_ = true;
+            scroll();
+            return;
+        }
+        // a column of cursors, one per line (at the end of lines too short to reach it)
+        cursors_.clear();
+        cursors_.reserve((size_t)(r1 - r0));
+        LineLayout scratch;
+        for (int row = r0; row <= r1; ++row)
+        {
+            if (row == cy_ - 1)
+                continue;
+            size_t b0, b1;
+            block_bytes(buffer_->line((size_t)row), c0, c0, scratch, b0, b1);
+            cursors_.push_back(Cursor{(int)b0 + 1, row + 1, (int)b0 + 1});
+        }
+        edit_at_cursors(key);
+    }
+
+}
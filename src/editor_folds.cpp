@@ -0,0 +1,167 @@
+#include "termite/editor.hpp"
+
+#include "termite/brackets.hpp"
+#include "termite/buffer.hpp"
+#include "termite/folds.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace termite
+{
+
+    namespace
+    {
+        // Leading blanks of a line, -1 for a blank line (it belongs to whatever surrounds it)
+        int indent_of(const std::string &line)
+        {
+            size_t i = line.find_first_not_of(" \t");
+            return i == std::string::npos ? -1 : (int)i;
+        }
+
+        // A closing line with nothing else on it ("}", "};", "},") folds away with its block
+        bool only_closer(const std::string &line)
+        {
+            size_t i = line.find_first_not_of(" \t");
+            return i != std::string::npos && line.find_first_not_of("}); \t,", i) == std::string::npos;
+        }
+    }
+
+    bool Editor::fold_region(size_t row, size_t &last)
+    {
+        const std::string &line = buffer_->line(row);
+        // brace block: the first '{' of the line whose partner is on a later line
+        for (size_t c = line.find('{'); c != std::string::npos; c = line.find('{', c + 1))
+        {
+            if (!brackets_)
+                brackets_ = std::make_unique<BracketIndex>();
+            brackets_->sync(*buffer_);
+            BracketIndex::Pos p;
+            if (!brackets_->match(*buffer_, row, c, p) || p.row <= row)
+                continue;
+            last = only_closer(buffer_->line(p.row)) ? p.row : p.row - 1;
+            if (last > row)
+                return true;
+        }
+        // indentation: the lines below that are indented deeper, blank ones at the end stay out
+        int base = indent_of(line);
+        if (base < 0)
+            return false;
+        last = row;
+        size_t n = buffer_->line_count();
+        for (size_t r = row + 1; r < n; ++r)
+        {
+            int in = indent_of(buffer_->line(r));
+            if (in < 0)
+                continue;
+            if (in <= base)
+                break;
+            last = r;
+        }
+        return last > row;
+    }
+
+    void Editor::toggle_fold()
+    {
+        if (!folds_)
+            folds_ = std::make_unique<FoldIndex>();
+        folds_->sync(*buffer_);
+        int64_t screen_row = cursor_row() - row_off_;
+        size_t row = (size_t)(cy_ - 1);
+        size_t first = row;
+        size_t last = row;
+        if (folds_->unfold(row))
+        {
+            status_ = "Unfolded";
+        }
+        else
+        {
+            bool found = false;
+            if (selection_active() && anchor_cy_ != cy_)
+            {
+                first = (size_t)(std::min(anchor_cy_, cy_) - 1);
+                last = (size_t)(std::max(anchor_cy_, cy_) - 1);
+                clear_selection();
+                found = true;
+            }
+            else if (fold_region(row, last))
+            {
+                found = true;
+            }
+            else
+            {
+                // the innermost region around the cursor: headed by the line of the bracket still
+                // open here, else by the first less indented line above
+                size_t brow = 0, bcol = 0;
+                if (enclosing_bracket(brow, bcol) && fold_region(brow, last) && last >= row)
+                {
+                    first = brow;
+                    found = true;
+                }
+                else if (int in = indent_of(buffer_->line(row)); in > 0)
+                {
+                    for (size_t r = row; r-- > 0;)
+                    {
+                        int above = indent_of(buffer_->line(r));
+                        if (above < 0 || above >= in)
+                            continue;
+                        found = fold_region(r, last) && last >= row;
+                        first = r;
+                        break;
+                    }
+                }
+            }
+            if (!found || !folds_->fold(*buffer_, first, last))
+            {
+                status_ = "Nothing to fold";
+                return;
+            }
+            status_ = "Folded " + std::to_string(last - first) + " lines";
+            cy_ = (int)first + 1;
+            cx_ = std::min(cx_, (int)buffer_->line_length(first) + 1);
+        }
+        // the cursor stays on its screen row, whatever moved around it
+        row_off_ = (int)std::max<int64_t>(0, cursor_row() - screen_row);
+        drawn_row_off_ = -1;
+    }
+
+    void Editor::fold_all(bool fold)
+    {
+        if (!folds_)
+            folds_ = std::make_unique<FoldIndex>();
+        folds_->sync(*buffer_);
+        int64_t screen_row = cursor_row() - row_off_;
+        if (!fold)
+        {
+            folds_->clear();
+            status_ = "Unfolded all";
+        }
+        else
+        {
+            // top-level regions: each one is skipped as a whole, so nothing inside it is looked at
+            std::vector<FoldIndex::Fold> regions;
+            size_t n = buffer_->line_count();
+            for (size_t row = 0; row < n; ++row)
+            {
+                size_t last = 0;
+                if (!fold_region(row, last))
+                    continue;
+                regions.push_back({row, last});
+                row = last;
+            }
+            folds_->fold_all(*buffer_, std::move(regions));
+            status_ = "Folded " + std::to_string(folds_->count()) + " regions, " +
+                      std::to_string(folds_->visible_lines()) + " lines shown";
+            // a cursor inside a region goes to its header, the last line shown above it
+            size_t row = (size_t)(cy_ - 1);
+            if (folds_->hidden(row))
+            {
+                cy_ = (int)folds_->line_at(folds_->row_of_line(row) - 1) + 1;
+                cx_ = std::min(cx_, (int)buffer_->line_length((size_t)(cy_ - 1)) + 1);
+            }
+        }
+        row_off_ = (int)std::max<int64_t>(0, cursor_row() - screen_row);
+        drawn_row_off_ = -1;
+    }
+
+}
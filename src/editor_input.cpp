@@ -3,10 +3,15 @@
 #include "termite/buffer.hpp"
 #include "termite/input.hpp"
 #include "termite/file_io.hpp"
+#include "termite/follow.hpp"
+#include "termite/journal.hpp"
 #include "termite/screen.hpp"
+#include "termite/layout.hpp"
+#include "termite/unicode.hpp"
 
 #include <algorithm>
 #include <cctype>
+#include <filesystem>
 #include <string>
 
 namespace termite
@@ -31,9 +36,9 @@ namespace termite
             else if (k == input::KEY_BACKSPACE)
             {
                 if (!input.empty())
-                    input.pop_back();
+                    input.erase(unicode::prev_grapheme(input, input.size()));
             }
-            else if (k >= 32 && k <= 126)
+            else if ((k >= 32 && k <= 126) || (k >= 0x80 && k <= 0xFF))
             {
                 input.push_back(static_cast<char>(k));
             }
@@ -44,6 +49,11 @@ namespace termite
     {
         if (!selection_active())
             return;
+        if (block_)
+        {
+            delete_block();
+            return;
+        }
         // Normalize selection
         int aL = anchor_cy_ - 1, aC = anchor_cx_ - 1;
         int cL = cy_ - 1, cC = cx_ - 1;
@@ -55,7 +65,7 @@ namespace termite
         int line_count = (int)buffer_->line_count();
         if (line_count <= 0)
         {
-            selecting_ = false;
+            clear_selection();
             return;
         }
         aL = std::clamp(aL, 0, line_count - 1);
@@ -93,12 +103,27 @@ namespace termite
         }
         cy_ = aL + 1;
         cx_ = aC + 1;
-        selecting_ = false;
+        clear_selection();
         modified_ = true;
     }
 
     bool Editor::handle_input(int key)
     {
+        if (view_)
+            return handle_view_input(key);
+        if (filter_ && key == input::KEY_CTRL_C)
+        {
+            cancel_filter();
+            return true;
+        }
+        if (completing_ && handle_completion_key(key))
+            return true;
+        if (key == input::KEY_CTRL_SPACE)
+        {
+            start_completion();
+            return true;
+        }
+
         //Add different modes: normal mode, insert mode, command mode, visual mode (like vim)
 
         //GO to normalmode using ESC
@@ -113,6 +138,33 @@ namespace termite
             paste_from_clipboard();
             return true;
         }
+        if (key == input::KEY_F2)
+        {
+            run_command("profiler");
+            return true;
+        }
+        if (key == input::KEY_CTRL_E)
+        {
+            std::string cmd = prompt_input("Command: ");
+            if (!cmd.empty())
+                run_command(cmd);
+            scroll();
+            return true;
+        }
+        if (key == input::KEY_CTRL_W)
+        {
+            focus_pane(layout_->next(pane_));
+            return true;
+        }
+        if (key == input::KEY_CTRL_PAGE_UP || key == input::KEY_CTRL_PAGE_DOWN)
+        {
+            if (docs_.size() > 1)
+            {
+                size_t n = docs_.size();
+                switch_document(key == input::KEY_CTRL_PAGE_DOWN ? (doc_ + 1) % n : (doc_ + n - 1) % n);
+            }
+            return true;
+        }
         if (searching_ && (key == input::KEY_UP || key == input::KEY_DOWN))
         {
             if (!search_matches_.empty())
@@ -128,6 +180,25 @@ namespace termite
             }
             return true;
         }
+        if (key == input::KEY_CTRL_D)
+        {
+            add_cursor_at_next_match();
+            return true;
+        }
+        if (key == input::KEY_ALT_UP || key == input::KEY_ALT_DOWN)
+        {
+            add_cursor_column(key == input::KEY_ALT_UP ? -1 : 1, 1);
+            return true;
+        }
+        if (!cursors_.empty() && handle_cursors_key(key))
+            return true;
+        if (selecting_ && block_ &&
+            (key == input::KEY_BACKSPACE || key == input::KEY_DELETE || key == input::KEY_ENTER ||
+             (key >= 32 && key <= 126) || key == '\t' || (key >= 0x80 && key <= 0xFF)))
+        {
+            edit_block(key);
+            return true;
+        }
         if (key == input::KEY_CTRL_Q)
         {
             return false;
@@ -137,6 +208,17 @@ namespace termite
             copy_selection_to_clipboard();
             return true;
         }
+        if (key == input::KEY_CTRL_X)
+        {
+            if (selection_active())
+            {
+                copy_selection_to_clipboard();
+                delete_selection();
+                status_ = "Cut";
+                scroll();
+            }
+            return true;
+        }
         if (key == input::KEY_CTRL_S)
         {
             std::string target = filename_.empty() ? std::string("") : filename_;
@@ -154,6 +236,14 @@ namespace termite
             {
                 filename_ = target;
                 modified_ = false;
+                std::error_code ec;
+                file_bytes_ = std::filesystem::file_size(target, ec);
+                if (follow_)
+                    follow_->skip_to_end(); // our own write, not new data
+                if (journal_)
+                    journal_->checkpoint();
+                else if (journal_enabled_)
+                    start_journal(); // Save As of a new buffer
                 status_ = std::string("Saved: ") + target;
             }
             else
@@ -162,6 +252,10 @@ namespace termite
             }
         }
         const auto &lines = buffer_->lines();
+        // Display column before the key; vertical moves try to land on the same column
+        int prev_cy = cy_;
+        bool moved_visual = false; // soft wrap: cursor already placed by move_visual
+        int goal_col = (cy_ >= 1 && cy_ <= (int)lines.size()) ? layouts_->get(*buffer_, (size_t)(cy_ - 1)).col_of(cx_ - 1) : 0;
         auto clamp_col_to_line = [&](int y)
         {
             if (y < 1)
@@ -176,22 +270,28 @@ namespace termite
         switch (key)
         {
         case input::KEY_UP:
-            if (cy_ > 1)
-                cy_--;
+            if (soft_wrap_)
+            {
+                move_visual(-1);
+                moved_visual = true;
+            }
+            else
+                move_lines(-1);
             break;
         case input::KEY_DOWN:
-            if (cy_ < (int)lines.size())
-                cy_++;
+            if (soft_wrap_)
+            {
+                move_visual(1);
+                moved_visual = true;
+            }
+            else
+                move_lines(1);
             break;
         case input::KEY_CTRL_UP:
-            cy_ -= 6;
-            if (cy_ < 1)
-                cy_ = 1;
+            move_lines(-6);
             break;
         case input::KEY_CTRL_DOWN:
-            cy_ += 6;
-            if (cy_ > (int)lines.size())
-                cy_ = (int)lines.size();
+            move_lines(6);
             break;
         case input::KEY_HOME:
             cx_ = 1;
@@ -211,7 +311,7 @@ namespace termite
         case input::KEY_LEFT:
             if (cx_ > 1)
             {
-                cx_--;
+                cx_ = (int)unicode::prev_grapheme(lines[cy_ - 1], (size_t)(cx_ - 1)) + 1;
             }
             else if (cy_ > 1)
             {
@@ -225,7 +325,7 @@ namespace termite
             int len = (int)(cy_ >= 1 && cy_ <= (int)lines.size() ? lines[cy_ - 1].size() : 0);
             if (cx_ <= len)
             {
-                cx_++;
+                cx_ = (int)unicode::next_grapheme(lines[cy_ - 1], (size_t)(cx_ - 1)) + 1;
             }
             else if (cy_ < (int)lines.size())
             {
@@ -264,8 +364,11 @@ namespace termite
             int row = cy_ - 1;
             if (cx_ > 1)
             {
-                buffer_->delete_char((size_t)row, (size_t)(cx_ - 2));
-                cx_--;
+                // remove the whole grapheme left of the cursor
+                int start = (int)unicode::prev_grapheme(buffer_->line((size_t)row), (size_t)(cx_ - 1));
+                for (int n = cx_ - 1 - start; n > 0; --n)
+                    buffer_->delete_char((size_t)row, (size_t)start);
+                cx_ = start + 1;
                 modified_ = true;
             }
             else if (cy_ > 1)
@@ -292,7 +395,9 @@ namespace termite
             int len2 = (int)buffer_->line_length((size_t)row);
             if (cx_ <= len2)
             {
-                buffer_->delete_char((size_t)row, (size_t)(cx_ - 1));
+                int end = (int)unicode::next_grapheme(buffer_->line((size_t)row), (size_t)(cx_ - 1));
+                for (int n = end - (cx_ - 1); n > 0; --n)
+                    buffer_->delete_char((size_t)row, (size_t)(cx_ - 1));
                 modified_ = true;
             }
             else if (row + 1 < (int)buffer_->line_count())
@@ -322,8 +427,8 @@ namespace termite
             if (col > 0)
                 col--;
             auto is_word = [](char ch)
-            { return std::isalnum((signed char)ch) || ch == '_'; };
-            while (col > 0 && std::isspace((signed char)s[col]))
+            { return (unsigned char)ch >= 0x80 || std::isalnum((unsigned char)ch) || ch == '_'; };
+            while (col > 0 && std::isspace((unsigned char)s[col]))
                 col--;
             while (col > 0 && is_word(s[col - 1]))
                 col--;
@@ -348,20 +453,20 @@ namespace termite
             }
 
             auto is_word = [](char ch)
-            { return std::isalnum((signed char)ch) || ch == '_'; };
+            { return (unsigned char)ch >= 0x80 || std::isalnum((unsigned char)ch) || ch == '_'; };
             int n = (int)s.size();
             if (col < n && is_word(s[col]))
             {
                 while (col < n && is_word(s[col]))
                     col++;
             }
-            else if (col < n && !std::isspace((signed char)s[col]))
+            else if (col < n && !std::isspace((unsigned char)s[col]))
             {
-                while (col < n && !is_word(s[col]) && !std::isspace((signed char)s[col]))
+                while (col < n && !is_word(s[col]) && !std::isspace((unsigned char)s[col]))
                     col++;
             }
 
-            while (col < n && std::isspace((signed char)s[col]))
+            while (col < n && std::isspace((unsigned char)s[col]))
                 col++;
             cx_ = col + 1;
             break;
@@ -369,21 +474,19 @@ namespace termite
         case input::KEY_PAGE_UP:
         case input::KEY_PAGE_DOWN:
         {
-            auto sz = screen_->size();
-            int page = sz.rows - 1;
+            int page = pane_rect().rows;
             if (page < 1)
                 page = 1;
-            if (key == input::KEY_PAGE_UP)
+            if (soft_wrap_)
             {
-                cy_ -= page;
-                if (cy_ < 1)
-                    cy_ = 1;
+                // page through visual rows, a long wrapped line counts as many rows
+                move_visual(key == input::KEY_PAGE_UP ? -page : page);
+                moved_visual = true;
             }
             else
             {
-                cy_ += page;
-                if (cy_ > (int)lines.size())
-                    cy_ = (int)lines.size();
+                // folded lines do not count
+                move_lines(key == input::KEY_PAGE_UP ? -page : page);
             }
             break;
         }
@@ -408,7 +511,7 @@ namespace termite
             start_selection_if_needed();
             if (cx_ > 1)
             {
-                cx_--;
+                cx_ = (int)unicode::prev_grapheme(lines[cy_ - 1], (size_t)(cx_ - 1)) + 1;
             }
             else if (cy_ > 1)
             {
@@ -422,7 +525,7 @@ namespace termite
             int len = (int)(cy_ >= 1 && cy_ <= (int)lines.size() ? lines[cy_ - 1].size() : 0);
             if (cx_ <= len)
             {
-                cx_++;
+                cx_ = (int)unicode::next_grapheme(lines[cy_ - 1], (size_t)(cx_ - 1)) + 1;
             }
             else if (cy_ < (int)lines.size())
             {
@@ -433,13 +536,11 @@ namespace termite
         }
         case input::KEY_SHIFT_UP:
             start_selection_if_needed();
-            if (cy_ > 1)
-                cy_--;
+            move_lines(-1);
             break;
         case input::KEY_SHIFT_DOWN:
             start_selection_if_needed();
-            if (cy_ < (int)lines.size())
-                cy_++;
+            move_lines(1);
             break;
         case input::KEY_CTRL_SHIFT_LEFT:
         {
@@ -450,7 +551,7 @@ namespace termite
             int col = cx_ - 1;
             const auto &s = buffer_->lines()[row];
             auto is_word = [](char ch)
-            { return std::isalnum((unsigned char)ch) || ch == '_'; };
+            { return (unsigned char)ch >= 0x80 || std::isalnum((unsigned char)ch) || ch == '_'; };
             auto is_space = [](char ch)
             { return std::isspace((unsigned char)ch); };
             auto is_punct = [&](char ch)
@@ -483,7 +584,7 @@ namespace termite
             int col = cx_ - 1;
             const auto &s = buffer_->lines()[row];
             auto is_word = [](char ch)
-            { return std::isalnum((unsigned char)ch) || ch == '_'; };
+            { return (unsigned char)ch >= 0x80 || std::isalnum((unsigned char)ch) || ch == '_'; };
             auto is_space = [](char ch)
             { return std::isspace((unsigned char)ch); };
             auto is_punct = [&](char ch)
@@ -512,39 +613,38 @@ namespace termite
 
             debug_note("Ctrl-G");
 
-            // Jump to closest parenthesis on the right of the cursor in current line
-            int col = cx_ - 1;
-            int row = cy_ - 1;
-            const auto &s = buffer_->lines()[row];
-
-            size_t parenthesis_open_ct = 0;
-            auto is_parenthesis = [&parenthesis_open_ct](char ch)
+            // to the partner of the bracket at (or right before) the cursor, anywhere in the file;
+            // elsewhere to the bracket the cursor is inside of
+            size_t row, col, prow, pcol;
+            if (bracket_pair(row, col, prow, pcol) || enclosing_bracket(prow, pcol))
             {
-                if (ch == '(')
-                    parenthesis_open_ct++;
-                return (ch == ')' && parenthesis_open_ct >= 1);
-            };
-            int n = (int)s.size();
-            while (col < n && !is_parenthesis(s[col]))
-                col++;
-            cx_ = col + 1;
+                cy_ = (int)prow + 1;
+                cx_ = (int)pcol + 1;
+            }
+            else
+            {
+                status_ = "No matching bracket";
+            }
             break;
 
         } // add new cases from here on: ....
+        case input::KEY_ALT_SHIFT_UP:
+        case input::KEY_ALT_SHIFT_DOWN:
+        case input::KEY_ALT_SHIFT_LEFT:
+        case input::KEY_ALT_SHIFT_RIGHT:
+            extend_block(key);
+            break;
         case input::KEY_CTRL_SHIFT_UP:
             start_selection_if_needed();
-            cy_ -= 6;
-            if (cy_ < 1)
-                cy_ = 1;
+            move_lines(-6);
             break;
         case input::KEY_CTRL_SHIFT_DOWN:
             start_selection_if_needed();
-            cy_ += 6;
-            if (cy_ > (int)lines.size())
-                cy_ = (int)lines.size();
+            move_lines(6);
             break;
         default:
-            if ((key >= 32 && key <= 126) || key == '\t')
+            // bytes >= 0x80 are UTF-8 sequences coming in one byte at a time
+            if ((key >= 32 && key <= 126) || key == '\t' || (key >= 0x80 && key <= 0xFF))
             {
                 if (selection_active())
                 {
@@ -590,6 +690,10 @@ namespace termite
             case input::KEY_CTRL_SHIFT_RIGHT:
             case input::KEY_CTRL_SHIFT_UP:
             case input::KEY_CTRL_SHIFT_DOWN:
+            case input::KEY_ALT_SHIFT_UP:
+            case input::KEY_ALT_SHIFT_DOWN:
+            case input::KEY_ALT_SHIFT_LEFT:
+            case input::KEY_ALT_SHIFT_RIGHT:
             case input::KEY_UNKNOWN: // partial sequences; don't drop selection
                 return true;
             default:
@@ -597,7 +701,13 @@ namespace termite
             }
         };
         if (!is_nav_key(key))
-            selecting_ = false;
+            clear_selection();
+        bool vertical = key == input::KEY_UP || key == input::KEY_DOWN || key == input::KEY_CTRL_UP ||
+                        key == input::KEY_CTRL_DOWN || key == input::KEY_PAGE_UP || key == input::KEY_PAGE_DOWN ||
+                        key == input::KEY_SHIFT_UP || key == input::KEY_SHIFT_DOWN ||
+                        key == input::KEY_CTRL_SHIFT_UP || key == input::KEY_CTRL_SHIFT_DOWN;
+        if (vertical && !moved_visual && cy_ != prev_cy && cy_ >= 1 && cy_ <= (int)lines.size())
+            cx_ = layouts_->get(*buffer_, (size_t)(cy_ - 1)).byte_at(goal_col) + 1;
         clamp_col_to_line(cy_);
         scroll();
         return true;
@@ -635,7 +745,7 @@ namespace termite
             if (k == input::KEY_BACKSPACE)
             {
                 if (!query.empty())
-                    query.pop_back(); // TODO does'nt use cursor
+                    query.erase(unicode::prev_grapheme(query, query.size())); // TODO does'nt use cursor
                 search_query_ = query;
                 update_search_matches();
                 if (!search_matches_.empty())
@@ -669,7 +779,7 @@ namespace termite
                 }
                 continue;
             }
-            if (k >= 32 && k <= 126) // no utf8 characters
+            if ((k >= 32 && k <= 126) || (k >= 0x80 && k <= 0xFF))
             {
                 query.push_back(static_cast<char>(k));
                 search_query_ = query;
@@ -687,6 +797,11 @@ namespace termite
     {
         if (!selection_active())
             return;
+        if (block_)
+        {
+            copy_block();
+            return;
+        }
         int aL = anchor_cy_ - 1, aC = anchor_cx_ - 1;
         int cL = cy_ - 1, cC = cx_ - 1;
         if (aL > cL || (aL == cL && aC > cC))
@@ -767,13 +882,25 @@ namespace termite
         last_key_info_ = note;
     }
 
-    void Editor::update_search_matches()
+    void Editor::update_search_matches(int from_line)
     {
-        search_matches_.clear();
-        search_index_ = -1;
+        if (from_line <= 0)
+        {
+            search_matches_.clear();
+            search_index_ = -1;
+        }
+        else
+        {
+            // matches are in line order, drop the ones of the lines that get rescanned
+            auto keep = std::partition_point(search_matches_.begin(), search_matches_.end(),
+                                             [&](const Match &m) { return m.line < from_line; });
+            search_matches_.erase(keep, search_matches_.end());
+            if (search_index_ >= (int)search_matches_.size())
+                search_index_ = -1;
+        }
         if (search_query_.empty())
             return;
-        for (int li = 0; li < (int)buffer_->line_count(); ++li)
+        for (int li = std::max(0, from_line); li < (int)buffer_->line_count(); ++li)
         { // loop through every line
             const auto &s = buffer_->lines()[li];
             size_t pos = 0;
@@ -4,11 +4,18 @@
 #include "termite/buffer.hpp"
 #include "termite/ansi.hpp"
 #include "termite/debug.hpp"
+#include "termite/profiler.hpp"
 #include "termite/syntax.hpp"
+#include "termite/layout.hpp"
+#include "termite/wrap.hpp"
+#include "termite/folds.hpp"
+#include "termite/journal.hpp"
+#include "termite/unicode.hpp"
 
 #include <algorithm>
+#include <cstdlib>
+#include <optional>
 #include <string>
-#include <string_view>
 
 #ifndef _WIN32
 #include <sys/stat.h>
@@ -18,7 +25,14 @@ namespace termite
 {
     void Editor::render()
     {
-        screen_->clear();
+        if (view_)
+        {
+            render_view();
+            return;
+        }
+        std::optional<profiler::Scope> compose(std::in_place, profiler::Phase::Compose);
+        screen_->begin_frame();
+        layouts_->trim();
         auto perms_for = [&](const std::string& path) -> std::string
         {
 #ifndef _WIN32
@@ -58,11 +72,8 @@ namespace termite
 
         auto sz = screen_->size();
         int header_rows = 1;
-        int status_rows = 1;
-        int max_rows = sz.rows - header_rows - status_rows;
-        if (max_rows < 1) max_rows = 1;
         // Draw header line
-        screen_->move_cursor(1, 1);
+        screen_->begin_row(1);
 #ifdef TERMITE_VERSION
         std::string version = TERMITE_VERSION;
 #else
@@ -76,12 +87,105 @@ namespace termite
         if (cols > 0) pad_left = std::max(0, (cols - (int)header.size()) / 2);
         std::string style = ansi::bg_color256(15) + ansi::color256(18) + ansi::BOLD;
         screen_->write(style);
-        screen_->write(std::string(cols, ' '));
-        screen_->move_cursor(1, pad_left + 1);
+        screen_->write(std::string(pad_left, ' '));
         screen_->write(header);
+        screen_->write(std::string(std::max(0, cols - pad_left - (int)header.size()), ' '));
         screen_->write(ansi::RESET);
 
-        int max_cols = sz.cols;
+        // Text area between header and status line: one pane, or every pane in turn
+        int cur_row = header_rows + 1, cur_col = 1;
+        if (panes_.size() == 1)
+        {
+            render_pane(pane_rect(), true, cur_row, cur_col);
+        }
+        else
+        {
+            size_t focused = pane_;
+            layout_->place(text_area(), placed_scratch_, divider_scratch_);
+            for (const auto& placed : placed_scratch_)
+            {
+                focus_pane(placed.pane);
+                render_pane(pane_rect(), placed.pane == focused, cur_row, cur_col);
+            }
+            focus_pane(focused);
+            for (const auto& d : divider_scratch_)
+            {
+                for (int r = d.top; r < d.top + d.rows; ++r)
+                {
+                    screen_->begin_segment(r, d.left);
+                    screen_->write(ansi::color256(245));
+                    screen_->write("\xe2\x94\x82"); // U+2502 box drawings light vertical
+                }
+            }
+        }
+
+        std::string fname = filename_.empty() ? std::string("(untitled)") : filename_;
+        std::string mod = modified_ ? " *" : "";
+        std::string pos = " Ln " + std::to_string(cy_) + ", Col " + std::to_string(cx_);
+        if (buffer_->format().eol == LineEnding::CRLF) pos += " | CRLF";
+        if (follow_) pos += " | follow";
+        if (journal_ && journal_->failed()) pos += " | journal failed";
+        if (selecting_ && block_)
+            pos += " | block " + std::to_string(std::abs(cy_ - anchor_cy_) + 1) + "x" + std::to_string(std::abs(block_col_ - block_anchor_col_));
+        if (!cursors_.empty()) pos += " | " + std::to_string(cursors_.size() + 1) + " cursors";
+        if (docs_.size() > 1) pos += " | buffer " + std::to_string(doc_ + 1) + "/" + std::to_string(docs_.size());
+        std::string msg;
+        if (!status_.empty()) msg += std::string(" | ") + status_;
+        if (!last_key_info_.empty()) msg += std::string(" | last: ") + last_key_info_;
+        screen_->draw_status(fname + mod + " |" + pos + msg);
+
+        // completion list on top of the text, below the word (above it near the bottom)
+        if (completing_)
+        {
+            int n = (int)completions_.size();
+            int row = cur_row + n < sz.rows ? cur_row + 1 : std::max(header_rows + 1, cur_row - n);
+            int col = std::max(1, cur_col - 1 - (int)completion_prefix_.size());
+            screen_->draw_popup(row, col, completions_, completion_index_);
+        }
+
+        // profiler overlay (F2), numbers of the previous frame plus any debug notes
+        if (profiler::enabled())
+        {
+            auto overlay = profiler::overlay_lines();
+            overlay.insert(overlay.end(), g_debug_lines.begin(), g_debug_lines.end());
+            screen_->draw_debug_window(overlay);
+        }
+
+        compose.reset();
+        {
+            profiler::Scope flush(profiler::Phase::Flush);
+            auto flush_start = std::chrono::steady_clock::now();
+            screen_->end_frame();
+            screen_->move_cursor(cur_row, cur_col);
+            screen_->flush();
+            flush_time_ = std::chrono::steady_clock::now() - flush_start;
+        }
+        profiler::end_frame();
+
+        //clear debug lines after rendering
+        clear_debug_lines();
+    }
+
+    // Text rows of the focused view inside rect; with several panes also its title row below rect.
+    // cur_row/cur_col receive the screen position of the cursor if focused.
+    void Editor::render_pane(const PaneRect& rect, bool focused, int& cur_row, int& cur_col)
+    {
+        auto sz = screen_->size();
+        // panes side by side share screen rows, each one writes its segment of them
+        bool full_width = rect.left == 1 && rect.cols >= sz.cols;
+        auto begin_row = [&](int row)
+        {
+            if (full_width)
+                screen_->begin_row(row);
+            else
+                screen_->begin_segment(row, rect.left);
+        };
+        // Text rows moved by the scroll since the last frame: let the terminal shift them
+        if (full_width && drawn_row_off_ >= 0 && row_off_ != drawn_row_off_ && std::abs(row_off_ - drawn_row_off_) < rect.rows)
+            screen_->scroll_rows(rect.top, rect.top + rect.rows - 1, row_off_ - drawn_row_off_);
+        drawn_row_off_ = row_off_;
+
+        int max_cols = rect.cols;
         const auto& lines = buffer_->lines();
         auto digits = [](int n)
         {
@@ -95,76 +199,87 @@ namespace termite
         }; //calculate nr of digits in pos int to allocate mem
         int lnw = std::max(4, digits((int)lines.size())); // gutter width (at least 4)
         int prefix_cols = lnw + 2; // number + space + '|'
-        auto disp_col = [](const std::string& s, int char_col, int tabw)
-        {
-            if (char_col < 0) char_col = 0;
-            if (char_col > (int)s.size()) char_col = (int)s.size();
-            int col = 0;
-            for (int i = 0; i < char_col; ++i)
-            {
-                if (s[i] == '\t')
-                {
-                    int spaces = tabw - (col % tabw);
-                    col += spaces;
-                }
-                else
-                {
-                    col += 1;
-                }
-            }
-            return col;
-        };
-        auto expand_tabs = [](const std::string& s, int tabw)
-        {
-            std::string out;
-            out.reserve(s.size());
-            int col = 0;
-            for (char ch : s)
-            {
-                if (ch == '\t')
-                {
-                    int spaces = tabw - (col % tabw);
-                    out.append(spaces, ' ');
-                    col += spaces;
-                }
-                else
-                {
-                    out.push_back(ch);
-                    col += 1;
-                }
-            }
-            return out;
-        };
-        constexpr int TAB_W = 4;
-
         //TODO: debug windows
 
+        int text_cols = std::max(0, max_cols - prefix_cols);
+        // what text_width() gives for this pane, without asking the terminal and the layout per row
+        int wrap_w = std::max(1, text_cols);
+        // Folds: rows are visible lines, each row finds the next one in O(log n)
+        FoldIndex* folds = synced_folds();
+        int fold_line = folds && !soft_wrap_ ? (int)folds->line_at((size_t)row_off_) : 0;
+        // Soft wrap: row_off_ is a visual row, start at the line/sub row that contains it
+        int wrap_sub = 0;
+        int wrap_line = 0;
+        if (soft_wrap_)
+        {
+            wrap_->sync(*buffer_, wrap_w, folds);
+            wrap_line = (int)wrap_->line_at(row_off_, wrap_sub);
+            wrap_sub = std::min(wrap_sub, wrap_->measure(*buffer_, *layouts_, (size_t)wrap_line) - 1);
+        }
+
+        // the bracket at the cursor and its partner are highlighted (focused pane only)
+        size_t pair_row[2], pair_col[2];
+        bool has_pair = focused && bracket_pair(pair_row[0], pair_col[0], pair_row[1], pair_col[1]);
 
-        for (int i = 0; i < max_rows; ++i)
+        for (int i = 0; i < rect.rows; ++i)
         {
-            int file_row = row_off_ + i; // 0-based add scrolling
-            screen_->move_cursor(i + 1 + header_rows, 1);
+            int file_row = soft_wrap_ ? wrap_line : row_off_ + i; // 0-based add scrolling
+            if (folds && !soft_wrap_)
+            {
+                file_row = fold_line;
+                if (fold_line < (int)lines.size())
+                    fold_line = (int)folds->next_visible((size_t)fold_line);
+            }
+            begin_row(rect.top + i);
             // Draw line number gutter
             if (file_row < (int)lines.size())
             {
                 int lineno = file_row + 1;
                 std::string num = std::to_string(lineno);
                 if ((int)num.size() < lnw) num.insert(num.begin(), lnw - (int)num.size(), ' ');
+                if (soft_wrap_ && wrap_sub > 0) num.assign(lnw, ' '); // continuation row
                 screen_->write(ansi::color256(57)); //Color for row nr's grey: 245
                 screen_->write(num);
                 screen_->write(" ");
                 screen_->write(ansi::RESET);
-                screen_->write("|");
+                // '+' on the header of a fold
+                bool folded = folds && wrap_sub == 0 && folds->folded_below((size_t)file_row) > 0;
+                screen_->write(folded ? "+" : "|");
 
                 const std::string& line = lines[file_row];
-                int text_cols = std::max(0, max_cols - prefix_cols);
-                screen_->move_cursor(i + 1 + header_rows, lnw + 3);
-                std::string rendered = expand_tabs(line, TAB_W);
-                if (text_cols > 0 && col_off_ < (int)rendered.size())
+                LineLayout& lay = layouts_->get_mut(*buffer_, (size_t)file_row);
+                // window of display columns shown on this screen row
+                int win_c0 = col_off_;
+                int win_c1 = col_off_ + text_cols;
+                if (soft_wrap_)
+                {
+                    const auto& starts = wrap_rows(line, lay, wrap_w);
+                    win_c0 = starts[(size_t)wrap_sub];
+                    win_c1 = (size_t)wrap_sub + 1 < starts.size() ? starts[(size_t)wrap_sub + 1] : lay.width;
+                    if (++wrap_sub >= (int)starts.size())
+                    {
+                        // next line below the folds, or past EOF
+                        wrap_sub = 0;
+                        wrap_line = folds ? (int)folds->next_visible((size_t)wrap_line) : wrap_line + 1;
+                        if (wrap_line < (int)lines.size())
+                            wrap_->measure(*buffer_, *layouts_, (size_t)wrap_line);
+                    }
+                }
+                if (text_cols > 0 && !cursors_.empty() && render_cursor_row(line, lay, file_row, win_c0, win_c1, text_cols))
+                    continue;
+                if (text_cols > 0 && win_c0 < lay.width)
                 {
-                    //string_view to render
-                    std::string_view vis(rendered.c_str() + col_off_, rendered.size() - col_off_);
-                    if ((int)vis.size() > text_cols) vis = vis.substr(0, text_cols);
+                    // visible part is a view into the cached display text, columns [vt.c0, vt.c1)
+                    VisibleText vt = visible_text(line, lay, win_c0, win_c1);
+                    if (vt.lead > 0) screen_->write(" ");
+                    int vis_cols = vt.c1 - vt.c0;
+                    int vis_base = lay.offset(vt.c0);
+                    // cut [c0, c1) out of the view, columns relative to vt.c0
+                    auto vis_cut = [&](int c0, int c1)
+                    {
+                        int b0 = lay.offset(vt.c0 + c0) - vis_base;
+                        return vt.text.substr(b0, lay.offset(vt.c0 + c1) - vis_base - b0);
+                    };
 
                     bool has_sel = selecting_; //selection/ highlighting bool
                     if (has_sel)
@@ -184,7 +299,12 @@ namespace termite
                         {
                             int line_len = (int)line.size();
                             int s = 0, e = line_len;
-                            if (aL == cL)
+                            if (block_)
+                            {
+                                s = lay.byte_at(std::min(block_anchor_col_, block_col_));
+                                e = lay.byte_at(std::max(block_anchor_col_, block_col_));
+                            }
+                            else if (aL == cL)
                             {
                                 s = std::clamp(aC, 0, line_len);
                                 e = std::clamp(cC, 0, line_len);
@@ -205,43 +325,46 @@ namespace termite
                                 e = line_len;
                             }
 
-                            int s_disp = disp_col(line, s, TAB_W);
-                            int e_disp = disp_col(line, e, TAB_W);
-                            int vis_start = col_off_;
-                            int vis_end = col_off_ + (int)vis.size();
+                            int s_disp = lay.col_of(s);
+                            int e_disp = lay.col_of(e);
+                            int vis_start = vt.c0;
+                            int vis_end = vt.c1;
                             int hs = std::clamp(s_disp, vis_start, vis_end);
                             int he = std::clamp(e_disp, vis_start, vis_end);
                             int before = hs - vis_start;
                             int hlen = he - hs;
-                            if (before > 0) screen_->write(std::string(vis.substr(0, before)));
+                            if (before > 0) screen_->write(vis_cut(0, before));
                             if (hlen > 0)
                             {
                                 screen_->write(ansi::REVERSE);
-                                screen_->write(std::string(vis.substr(before, hlen)));
+                                screen_->write(vis_cut(before, before + hlen));
                                 screen_->write(ansi::RESET);
                             }
                             int after_start = before + std::max(0, hlen);
-                            if (after_start < (int)vis.size()) screen_->write(std::string(vis.substr(after_start)));
+                            if (after_start < vis_cols) screen_->write(vis_cut(after_start, vis_cols));
+                            if (vt.trail > 0) screen_->write(" ");
                             continue;
                         }
                     }
 
                     if (!has_sel && !search_query_.empty() && !search_matches_.empty())
                     {
-                        std::vector<std::pair<int, int>> spans;
+                        auto& spans = span_scratch_;
+                        spans.clear();
                         for (const auto& m : search_matches_)
                         {
                             if (m.line != file_row) continue;
-                            int s_disp = disp_col(line, m.start, TAB_W);
-                            int e_disp = disp_col(line, m.end, TAB_W);
-                            int vis_start = col_off_;
-                            int vis_end = col_off_ + (int)vis.size();
+                            int s_disp = lay.col_of(m.start);
+                            int e_disp = lay.col_of(m.end);
+                            int vis_start = vt.c0;
+                            int vis_end = vt.c1;
                             int hs = std::clamp(s_disp, vis_start, vis_end);
                             int he = std::clamp(e_disp, vis_start, vis_end);
                             if (he > hs) spans.emplace_back(hs - vis_start, he - vis_start);
                         }
                         std::sort(spans.begin(), spans.end());
-                        std::vector<std::pair<int, int>> merged;
+                        auto& merged = merged_scratch_;
+                        merged.clear();
                         for (auto& sp : spans)
                         {
                             if (merged.empty() || sp.first > merged.back().second) merged.push_back(sp);
@@ -250,13 +373,13 @@ namespace termite
                         int pos = 0;
                         for (auto& sp : merged)
                         {
-                            if (sp.first > pos) screen_->write(std::string(vis.substr(pos, sp.first - pos)));
+                            if (sp.first > pos) screen_->write(vis_cut(pos, sp.first));
                             screen_->write(ansi::bg_color256(11)); //yellow
-                            screen_->write(std::string(vis.substr(sp.first, sp.second - sp.first)));
+                            screen_->write(vis_cut(sp.first, sp.second));
                             screen_->write(ansi::RESET);
                             pos = sp.second;
                         }
-                        if (pos < (int)vis.size()) screen_->write(std::string(vis.substr(pos)));
+                        if (pos < vis_cols) screen_->write(vis_cut(pos, vis_cols));
                     }
                     else
                     {
@@ -267,12 +390,57 @@ namespace termite
                         // screen_->write(ansi::RESET);
 
                         // implement the syntax highlighting rendering here
-                        std::vector<SyntaxHighlight> highlights = get_syntax_highlights(line);
+                        // highlights are byte ranges of the line, cached in display columns with the layout
+                        if (!lay.syntax_valid)
+                        {
+                            profiler::Scope highlight(profiler::Phase::Highlight);
+                            for (const auto& h : get_syntax_highlights(line))
+                            {
+                                int c0 = lay.col_of(h.start);
+                                int c1 = lay.col_of(h.end);
+                                if (c1 > c0) lay.syntax.push_back({h.type, c0, c1});
+                            }
+                            lay.syntax_valid = true;
+                        }
+                        // move them onto the visible text
+                        auto& vis_highlights = highlight_scratch_;
+                        vis_highlights.clear();
+                        for (const auto& h : lay.syntax)
+                        {
+                            if (h.end <= vt.c0 || h.start >= vt.c1) continue;
+                            int c0 = std::max(h.start, vt.c0);
+                            int c1 = std::min(h.end, vt.c1);
+                            vis_highlights.push_back({h.type, lay.offset(c0) - vis_base, lay.offset(c1) - vis_base});
+                        }
+                        for (int k = 0; k < 2 && has_pair; ++k)
+                        {
+                            // cut the bracket's byte out of the span that covers it
+                            int c = lay.col_of((int)pair_col[k]);
+                            if (pair_row[k] != (size_t)file_row || c < vt.c0 || c >= vt.c1)
+                                continue;
+                            int b = lay.offset(c) - vis_base;
+                            for (size_t h = 0; h < vis_highlights.size(); ++h)
+                            {
+                                SyntaxHighlight span = vis_highlights[h];
+                                if (b < span.start || b >= span.end)
+                                    continue;
+                                SyntaxHighlight parts[3] = {{span.type, span.start, b},
+                                                            {SyntaxHighlight::Type::Match, b, b + 1},
+                                                            {span.type, b + 1, span.end}};
+                                vis_highlights.erase(vis_highlights.begin() + (std::ptrdiff_t)h);
+                                int at = (int)h;
+                                for (const auto& part : parts)
+                                    if (part.end > part.start)
+                                        vis_highlights.insert(vis_highlights.begin() + at++, part);
+                                break;
+                            }
+                        }
 
                         //is Block commented (only support c++ syntax)
-                        screen_->write_with_syntax_highlighting(highlights, std::string(vis));
+                        screen_->write_with_syntax_highlighting(vis_highlights, vt.text);
 
                     }
+                    if (vt.trail > 0) screen_->write(" ");
                 }
             }
             else
@@ -283,47 +451,114 @@ namespace termite
             }
         }
 
-        std::string fname = filename_.empty() ? std::string("(untitled)") : filename_;
-        std::string mod = modified_ ? " *" : "";
-        std::string pos = " Ln " + std::to_string(cy_) + ", Col " + std::to_string(cx_);
-        std::string msg;
-        if (!status_.empty()) msg += std::string(" | ") + status_;
-        if (!last_key_info_.empty()) msg += std::string(" | last: ") + last_key_info_;
-        screen_->draw_status(fname + mod + " |" + pos + msg);
-
-        //debug drawing
-        if (true)
+        if (panes_.size() > 1)
         {
-            add_debug_line("Debug Info:");
-            add_debug_line("Cursor: (" + std::to_string(cx_) + ", " + std::to_string(cy_) + ")");
-            add_debug_line("Row Off: " + std::to_string(row_off_) + ", Col Off: " + std::to_string(col_off_));
-            add_debug_line("Search: '" + search_query_ + "' (" + std::to_string(search_matches_.size()) + " matches)");
-            add_debug_line(last_key_info_);
-            add_debug_line("Custom DEBUG Notes:");
-            screen_->draw_debug_window(g_debug_lines);
+            std::string title(" ");
+            title += filename_.empty() ? std::string("(untitled)") : filename_;
+            title += std::string(modified_ ? " *" : "") + " | Ln " + std::to_string(cy_) + ", Col " + std::to_string(cx_);
+            if ((int)title.size() > rect.cols) title.resize((size_t)std::max(0, rect.cols));
+            begin_row(rect.top + rect.rows);
+            screen_->write(focused ? ansi::bg_color256(15) + ansi::color256(18) : ansi::bg_color256(240) + ansi::color256(231));
+            screen_->write(title);
+            screen_->write(std::string((size_t)std::max(0, rect.cols - (int)title.size()), ' '));
+            screen_->write(ansi::RESET);
         }
 
-
-        int screen_row = header_rows + (cy_ - row_off_);
-        if (screen_row < 1 + header_rows)
-            screen_row = 1 + header_rows;
-        if (screen_row > header_rows + max_rows)
-            screen_row = header_rows + max_rows;
-        int screen_col = lnw + 3; // start of content area
+        if (!focused)
+            return;
+        cur_row = rect.top - 1 + ((folds ? (int)folds->row_of_line((size_t)(cy_ - 1)) + 1 : cy_) - row_off_);
+        int cursor_row_start = col_off_;
+        if (soft_wrap_)
+        {
+            int64_t vrow = cursor_vrow();
+            cur_row = rect.top + (int)(vrow - row_off_);
+            auto& lay = layouts_->get_mut(*buffer_, (size_t)(cy_ - 1));
+            cursor_row_start = wrap_rows(lines[cy_ - 1], lay, wrap_w)[(size_t)(vrow - wrap_->row_of_line((size_t)(cy_ - 1)))];
+        }
+        cur_row = std::clamp(cur_row, rect.top, rect.top + std::max(0, rect.rows - 1));
+        cur_col = rect.left + lnw + 2; // start of content area
         if (cy_ >= 1 && cy_ <= (int)lines.size())
         {
-            const std::string& line = lines[cy_ - 1];
-            int c_disp = disp_col(line, cx_ - 1, TAB_W);
-            screen_col = lnw + 3 + (c_disp - col_off_);
+            int c_disp = layouts_->get(*buffer_, (size_t)(cy_ - 1)).col_of(cx_ - 1);
+            cur_col = rect.left + lnw + 2 + (c_disp - cursor_row_start);
         }
-        if (screen_col < 1)
-            screen_col = 1;
-        if (screen_col > max_cols)
-            screen_col = max_cols;
-        screen_->move_cursor(screen_row, screen_col);
-        screen_->flush();
+        cur_col = std::clamp(cur_col, rect.left, rect.left + std::max(0, rect.cols - 1));
+    }
 
-        //clear debug lines after rendering
-        clear_debug_lines();
+    bool Editor::render_cursor_row(const std::string& line, LineLayout& lay, int file_row, int win_c0, int win_c1, int text_cols)
+    {
+        // cursors_ is sorted: the ones on this row are one range of it
+        auto first = std::lower_bound(cursors_.begin(), cursors_.end(), file_row + 1,
+                                      [](const Cursor& c, int cy) { return c.cy < cy; });
+        if (first == cursors_.end() || first->cy != file_row + 1)
+            return false;
+        int len = (int)line.size();
+        // reversed cells in display columns: selections, and the glyph under every cursor without
+        // one (a cursor at the end of the line covers the column after it)
+        auto& spans = span_scratch_;
+        spans.clear();
+        bool eol = false;
+        auto add = [&](int a, int b)
+        {
+            a = std::clamp(a, 0, len);
+            b = std::clamp(b, 0, len);
+            if (a == b)
+            {
+                if (a == len)
+                {
+                    eol = true;
+                    return;
+                }
+                b = (int)unicode::next_grapheme(line, (size_t)a);
+            }
+            spans.emplace_back(lay.col_of(a), lay.col_of(b));
+        };
+        for (auto c = first; c != cursors_.end() && c->cy == file_row + 1; ++c)
+            add(std::min(c->cx, c->anchor_cx) - 1, std::max(c->cx, c->anchor_cx) - 1);
+        if (selection_active())
+        {
+            int aL = anchor_cy_ - 1, aC = anchor_cx_ - 1;
+            int cL = cy_ - 1, cC = cx_ - 1;
+            if (aL > cL || (aL == cL && aC > cC))
+            {
+                std::swap(aL, cL);
+                std::swap(aC, cC);
+            }
+            if (file_row >= aL && file_row <= cL)
+                spans.emplace_back(lay.col_of(std::clamp(file_row == aL ? aC : 0, 0, len)),
+                                   lay.col_of(file_row == cL ? std::clamp(cC, 0, len) : len));
+        }
+        std::sort(spans.begin(), spans.end());
+
+        VisibleText vt = visible_text(line, lay, win_c0, win_c1);
+        if (vt.lead > 0) screen_->write(" ");
+        int vis_base = lay.offset(vt.c0);
+        auto vis_cut = [&](int c0, int c1)
+        {
+            int b0 = lay.offset(c0) - vis_base;
+            return vt.text.substr(b0, lay.offset(c1) - vis_base - b0);
+        };
+        int pos = vt.c0;
+        for (const auto& sp : spans)
+        {
+            int hs = std::clamp(sp.first, pos, vt.c1);
+            int he = std::clamp(sp.second, pos, vt.c1);
+            if (he <= hs) continue;
+            screen_->write(vis_cut(pos, hs));
+            screen_->write(ansi::REVERSE);
+            screen_->write(vis_cut(hs, he));
+            screen_->write(ansi::RESET);
+            pos = he;
+        }
+        if (pos < vt.c1) screen_->write(vis_cut(pos, vt.c1));
+        if (vt.trail > 0) screen_->write(" ");
+        // soft wrap: only the last visual row of the line ends at its end
+        if (eol && lay.width >= win_c0 && lay.width - win_c0 < text_cols && win_c1 >= lay.width)
+        {
+            screen_->write(ansi::REVERSE);
+            screen_->write(" ");
+            screen_->write(ansi::RESET);
+        }
+        return true;
     }
 }
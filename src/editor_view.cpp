@@ -0,0 +1,410 @@
+#include "termite/editor.hpp"
+
+#include "termite/ansi.hpp"
+#include "termite/file_view.hpp"
+#include "termite/input.hpp"
+#include "termite/layout.hpp"
+#include "termite/profiler.hpp"
+#include "termite/screen.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+
+// --view: a pager over FileView. Nothing here reads more than the visible lines, so frames cost
+// the same on a 50 GB log as on a small file.
+
+namespace termite
+{
+    namespace
+    {
+        // 1234567 -> "1,234,567"
+        std::string grouped(uint64_t n)
+        {
+            std::string digits = std::to_string(n);
+            std::string s;
+            for (size_t i = 0; i < digits.size(); ++i)
+            {
+                if (i > 0 && (digits.size() - i) % 3 == 0)
+                    s.push_back(',');
+                s.push_back(digits[i]);
+            }
+            return s;
+        }
+
+        std::string human_size(uint64_t bytes)
+        {
+            const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+            double v = (double)bytes;
+            size_t u = 0;
+            while (v >= 1024.0 && u + 1 < std::size(units))
+            {
+                v /= 1024.0;
+                ++u;
+            }
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), u == 0 ? "%.0f %s" : "%.1f %s", v, units[u]);
+            return buf;
+        }
+
+        // Bytes per row of the hex view
+        constexpr size_t HEX_ROW = 16;
+    }
+
+    int Editor::render_hex_rows(int first_row, int rows, int cols)
+    {
+        static const char digit[] = "0123456789abcdef";
+        // 8 offset digits, more for files past 4 GB
+        int width = 8;
+        while (width < 16 && (view_->size() >> (4 * width)) != 0)
+            ++width;
+        // the whole screen is one piece of the mapping, formatted straight from it
+        std::string_view data = view_->bytes(hex_top_, (size_t)rows * HEX_ROW);
+        std::string text;
+        for (int i = 0; i < rows; ++i)
+        {
+            screen_->begin_row(first_row + i);
+            size_t at = (size_t)i * HEX_ROW;
+            if (at >= data.size())
+            {
+                screen_->write(std::string(width, ' '));
+                screen_->write(" |");
+                continue;
+            }
+            char offset[24];
+            std::snprintf(offset, sizeof(offset), "%0*llx ", width, (unsigned long long)(hex_top_ + at));
+            screen_->write(ansi::color256(57));
+            screen_->write(offset);
+            screen_->write(ansi::RESET);
+            screen_->write("|");
+
+            // " 7f 45 4c 46 ...  ..." : two groups of 8 bytes, then the printable ASCII ones
+            std::string_view bytes = data.substr(at, HEX_ROW);
+            text.clear();
+            for (size_t k = 0; k < HEX_ROW; ++k)
+            {
+                text += k == HEX_ROW / 2 ? "  " : " ";
+                if (k < bytes.size())
+                {
+                    auto b = (unsigned char)bytes[k];
+                    text += digit[b >> 4];
+                    text += digit[b & 15];
+                }
+                else
+                {
+                    text += "  ";
+                }
+            }
+            text += "  ";
+            for (char c : bytes)
+                text += c >= 0x20 && c < 0x7f ? c : '.';
+            text.resize(std::min(text.size(), (size_t)std::max(0, cols - width - 2)));
+            screen_->write(text);
+        }
+        return width + 4;
+    }
+
+    void Editor::scroll_hex(int64_t n)
+    {
+        uint64_t total = (view_->size() + HEX_ROW - 1) / HEX_ROW;
+        uint64_t shown = (uint64_t)view_rows();
+        uint64_t last_top = total > shown ? total - shown : 0;
+        uint64_t top = hex_top_ / HEX_ROW;
+        uint64_t next = n < 0 ? top - std::min(top, (uint64_t)-n) : std::max(top, std::min(last_top, top + (uint64_t)n));
+        int64_t moved = (int64_t)(next - top);
+        if (std::abs(moved) < (int64_t)shown)
+            view_shift_ += (int)moved;
+        else
+            drawn_row_off_ = -1;
+        hex_top_ = next * HEX_ROW;
+    }
+
+    void Editor::goto_hex_offset()
+    {
+        // "0x1f00" or "7936" goes to the row of a byte offset, "37.5%" to a share of the file
+        std::string where = prompt_input("Go to offset or percent: ");
+        if (where.empty())
+            return;
+        char* end = nullptr;
+        uint64_t off = 0;
+        if (where.back() == '%')
+        {
+            double p = std::strtod(where.c_str(), &end);
+            if (end == where.c_str() || p < 0)
+            {
+                status_ = "Not an offset or percentage: " + where;
+                return;
+            }
+            off = (uint64_t)(std::min(p, 100.0) / 100.0 * (double)view_->size());
+        }
+        else
+        {
+            bool hex = where.size() > 2 && where[0] == '0' && (where[1] == 'x' || where[1] == 'X');
+            off = std::strtoull(where.c_str(), &end, hex ? 16 : 10);
+            if (end == where.c_str() || *end != '\0')
+            {
+                status_ = "Not an offset or percentage: " + where;
+                return;
+            }
+        }
+        hex_top_ = 0;
+        scroll_hex((int64_t)std::min<uint64_t>(off / HEX_ROW, INT64_MAX));
+        drawn_row_off_ = -1;
+        status_.clear();
+    }
+
+    int Editor::view_rows() const
+    {
+        return std::max(1, screen_->size().rows - 2); // header and status line
+    }
+
+    void Editor::render_view()
+    {
+        std::optional<profiler::Scope> compose(std::in_place, profiler::Phase::Compose);
+        screen_->begin_frame();
+        auto sz = screen_->size();
+        int header_rows = 1;
+        int max_rows = view_rows();
+        if (view_->shrank() && !view_shrank_)
+        {
+            // truncated under us: whatever was on screen past the new end is stale
+            view_shrank_ = true;
+            status_ = "File shrank to " + human_size(view_->size()) + " while viewing";
+            if (view_->top() >= view_->size()) view_->jump_end((size_t)max_rows);
+            hex_top_ = std::min(hex_top_, view_->size() / HEX_ROW * HEX_ROW);
+            view_shift_ = 0;
+            drawn_row_off_ = -1;
+        }
+        if (drawn_row_off_ >= 0 && view_shift_ != 0 && std::abs(view_shift_) < max_rows)
+            screen_->scroll_rows(header_rows + 1, header_rows + max_rows, view_shift_);
+        drawn_row_off_ = 0;
+        view_shift_ = 0;
+
+        screen_->begin_row(1);
+#ifdef TERMITE_VERSION
+        std::string version = TERMITE_VERSION;
+#else
+        std::string version = "0.1";
+#endif
+        std::string header = std::string("Termite v") + version + " | " + view_path_ + (view_hex_ ? " | hex view, " : " | view, ") +
+                             human_size(view_->size());
+        int cols = sz.cols;
+        if ((int)header.size() > cols) header.resize(cols);
+        int pad_left = std::max(0, (cols - (int)header.size()) / 2);
+        screen_->write(ansi::bg_color256(15) + ansi::color256(18) + ansi::BOLD);
+        screen_->write(std::string(pad_left, ' '));
+        screen_->write(header);
+        screen_->write(std::string(std::max(0, cols - pad_left - (int)header.size()), ' '));
+        screen_->write(ansi::RESET);
+
+        int cursor_col = 1;
+        if (view_hex_)
+        {
+            cursor_col = render_hex_rows(header_rows + 1, max_rows, cols);
+            char pos[96];
+            std::snprintf(pos, sizeof(pos), " Offset 0x%llx of 0x%llx | %.1f%%", (unsigned long long)hex_top_,
+                          (unsigned long long)view_->size(),
+                          view_->size() ? 100.0 * (double)hex_top_ / (double)view_->size() : 0.0);
+            screen_->draw_status(view_path_ + " |" + pos + (status_.empty() ? std::string() : " | " + status_));
+        }
+        else
+        {
+            bool count_exact = false;
+            uint64_t total = view_->line_count(count_exact);
+            bool top_exact = false;
+            uint64_t top_line = view_->top_line(top_exact);
+            int lnw = std::max(4, (int)std::to_string(std::max(total, top_line + (uint64_t)max_rows)).size());
+            int text_cols = std::max(0, sz.cols - (lnw + 2));
+            cursor_col = lnw + 3;
+
+            // reused for every row: the line is copied out of the mapping, at most FileView::MAX_LINE bytes
+            std::string text;
+            LineLayout lay;
+            for (int i = 0; i < max_rows; ++i)
+            {
+                screen_->begin_row(i + 1 + header_rows);
+                uint64_t start = view_->row((size_t)i);
+                if (start == FileView::npos)
+                {
+                    screen_->write(std::string(lnw, ' '));
+                    screen_->write(" |");
+                    continue;
+                }
+                std::string num = std::to_string(top_line + (uint64_t)i + 1);
+                if ((int)num.size() < lnw) num.insert(num.begin(), lnw - (int)num.size(), ' ');
+                screen_->write(ansi::color256(57));
+                screen_->write(num);
+                screen_->write(" ");
+                screen_->write(ansi::RESET);
+                screen_->write("|");
+
+                text.assign(view_->line(start));
+                build_layout(text, lay);
+                if (text_cols > 0 && col_off_ < lay.width)
+                {
+                    VisibleText vt = visible_text(text, lay, col_off_, col_off_ + text_cols);
+                    if (vt.lead > 0) screen_->write(" ");
+                    screen_->write(vt.text);
+                    if (vt.trail > 0) screen_->write(" ");
+                }
+            }
+
+            // line numbers that are not counted yet are estimates from the byte offset: marked with ~
+            std::string pos = " Ln " + std::string(top_exact ? "" : "~") + grouped(top_line + 1) + " of " +
+                              (count_exact ? "" : "~") + grouped(total);
+            char pct[48];
+            double at = view_->size() ? 100.0 * (double)view_->top() / (double)view_->size() : 0.0;
+            std::snprintf(pct, sizeof(pct), " | %.1f%%", at);
+            pos += pct;
+            if (!count_exact)
+            {
+                std::snprintf(pct, sizeof(pct), " | counting lines %.0f%%", 100.0 * view_->count_progress());
+                pos += pct;
+            }
+            std::string msg;
+            if (!status_.empty()) msg += std::string(" | ") + status_;
+            screen_->draw_status(view_path_ + " |" + pos + msg);
+        }
+
+        if (profiler::enabled())
+            screen_->draw_debug_window(profiler::overlay_lines());
+
+        compose.reset();
+        {
+            profiler::Scope flush(profiler::Phase::Flush);
+            auto flush_start = std::chrono::steady_clock::now();
+            screen_->end_frame();
+            screen_->move_cursor(header_rows + 1, std::min(cursor_col, std::max(1, sz.cols)));
+            screen_->flush();
+            flush_time_ = std::chrono::steady_clock::now() - flush_start;
+        }
+        profiler::end_frame();
+    }
+
+    bool Editor::handle_view_input(int key)
+    {
+        size_t rows = (size_t)view_rows();
+        auto scroll_by = [&](int64_t n)
+        {
+            if (view_hex_)
+                scroll_hex(n);
+            else
+                view_shift_ += (int)view_->scroll(n, rows);
+        };
+        switch (key)
+        {
+        case input::KEY_CTRL_Q:
+            return false;
+        case input::KEY_F2:
+            run_command("profiler");
+            break;
+        case input::KEY_CTRL_E:
+        {
+            std::string cmd = prompt_input("Command: ");
+            if (!cmd.empty())
+                run_command(cmd);
+            break;
+        }
+        case input::KEY_UP:
+            scroll_by(-1);
+            break;
+        case input::KEY_DOWN:
+            scroll_by(1);
+            break;
+        case input::KEY_CTRL_UP:
+            scroll_by(-6);
+            break;
+        case input::KEY_CTRL_DOWN:
+            scroll_by(6);
+            break;
+        case input::KEY_PAGE_UP:
+            scroll_by(-(int64_t)rows);
+            break;
+        case input::KEY_PAGE_DOWN:
+            scroll_by((int64_t)rows);
+            break;
+        case input::KEY_CTRL_HOME:
+            if (view_hex_)
+                hex_top_ = 0;
+            else
+                view_->jump(0);
+            drawn_row_off_ = -1;
+            break;
+        case input::KEY_CTRL_END:
+            if (view_hex_)
+                scroll_hex(INT64_MAX);
+            else
+                view_->jump_end(rows);
+            drawn_row_off_ = -1;
+            break;
+        case 27: // ESC: back from a binary file opened in place of a buffer
+            if (view_over_buffers_)
+            {
+                view_.reset();
+                view_hex_ = false;
+                view_over_buffers_ = false;
+                drawn_row_off_ = -1;
+                status_ = document_list();
+                return true;
+            }
+            break;
+        case input::KEY_LEFT:
+            col_off_ = std::max(0, col_off_ - 1);
+            break;
+        case input::KEY_RIGHT:
+            col_off_ = std::min((int)FileView::MAX_LINE, col_off_ + 1);
+            break;
+        case input::KEY_CTRL_LEFT:
+            col_off_ = std::max(0, col_off_ - 8);
+            break;
+        case input::KEY_CTRL_RIGHT:
+            col_off_ = std::min((int)FileView::MAX_LINE, col_off_ + 8);
+            break;
+        case input::KEY_HOME:
+            col_off_ = 0;
+            break;
+        case input::KEY_CTRL_G:
+        {
+            if (view_hex_)
+            {
+                goto_hex_offset();
+                break;
+            }
+            // "1200" goes to a line, "37.5%" to a byte offset; both take one window of reading
+            std::string where = prompt_input("Go to line or percent: ");
+            if (where.empty())
+                break;
+            char* end = nullptr;
+            if (where.back() == '%')
+            {
+                double p = std::strtod(where.c_str(), &end);
+                if (end == where.c_str() || p < 0)
+                {
+                    status_ = "Not a line or percentage: " + where;
+                    break;
+                }
+                view_->jump((uint64_t)(std::min(p, 100.0) / 100.0 * (double)view_->size()));
+            }
+            else
+            {
+                unsigned long long line = std::strtoull(where.c_str(), &end, 10);
+                if (end == where.c_str() || *end != '\0' || line == 0)
+                {
+                    status_ = "Not a line or percentage: " + where;
+                    break;
+                }
+                view_->jump_line(line - 1);
+            }
+            drawn_row_off_ = -1;
+            status_.clear();
+            break;
+        }
+        default:
+            break;
+        }
+        return true;
+    }
+}
@@ -1,27 +1,66 @@
 #include "termite/file_io.hpp"
 #include "termite/buffer.hpp"
+#include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <sstream>
 #include <stdexcept>
 
 namespace termite::file_io {
 
+namespace {
+// Bytes looked at by looks_binary
+constexpr size_t SNIFF_BYTES = 8000;
+// First read of a file whose size is unknown
+constexpr size_t READ_STEP = size_t{64} << 10;
+}
+
 std::string read_file(const std::string& path) {
     std::ifstream in(path, std::ios::binary);
     if (!in) throw std::runtime_error("failed to open file");
-    std::ostringstream ss;
-    ss << in.rdbuf();
-    return ss.str();
+    // read straight into the result, no stringstream copy in between. The size is only a hint:
+    // pipes cannot seek and procfs files report 0, those are read until EOF in growing steps.
+    std::streamoff size = -1;
+    if (in.seekg(0, std::ios::end)) size = in.tellg();
+    in.clear();
+    if (size > 0) in.seekg(0);
+    std::string data;
+    // one byte more than the size, so a file read completely ends with a short read
+    data.resize(size > 0 ? static_cast<size_t>(size) + 1 : READ_STEP);
+    size_t got = 0;
+    for (;;) {
+        in.read(data.data() + got, static_cast<std::streamsize>(data.size() - got));
+        got += static_cast<size_t>(in.gcount());
+        if (got < data.size()) break;
+        data.resize(data.size() * 2);
+    }
+    data.resize(got);
+    return data;
+}
+
+bool looks_binary(const std::string& path) {
+    // a pipe or FIFO would lose the bytes read here to the real read that follows
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) return false;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    char head[SNIFF_BYTES];
+    in.read(head, sizeof(head));
+    return std::memchr(head, '\0', static_cast<size_t>(in.gcount())) != nullptr;
 }
 
 bool save_file(const Buffer& buffer, const std::string& path) {
     std::ofstream out(path, std::ios::binary | std::ios::trunc);
     if (!out) return false;
-    const auto& lines = buffer.lines();
-    for (size_t i = 0; i < lines.size(); ++i) {
-        out.write(lines[i].data(), static_cast<std::streamsize>(lines[i].size()));
-        if (i + 1 < lines.size()) out.put('\n');
-    }
+    const auto& fmt = buffer.format();
+    const char* eol = fmt.eol == LineEnding::CRLF ? "\r\n" : "\n";
+    std::streamsize eol_len = fmt.eol == LineEnding::CRLF ? 2 : 1;
+    if (fmt.utf8_bom) out.write("\xEF\xBB\xBF", 3);
+    auto snap = buffer.snapshot();
+    size_t remaining = snap.line_count();
+    snap.for_each_line([&](const std::string& line) {
+        out.write(line.data(), static_cast<std::streamsize>(line.size()));
+        if (--remaining > 0 || fmt.trailing_newline) out.write(eol, eol_len);
+    });
     return static_cast<bool>(out);
 }
 
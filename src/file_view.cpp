@@ -0,0 +1,304 @@
+#include "termite/file_view.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace termite {
+
+namespace {
+
+// Read size of the background count; checkpoint strides are multiples of it
+constexpr uint64_t COUNT_CHUNK = uint64_t{1} << 20;
+// Bytes looked at per map() call while scanning for line ends
+constexpr size_t SCAN_STEP = FileView::WINDOW_BYTES / 2;
+// Windows start at multiples of this
+constexpr uint64_t WINDOW_ALIGN = 4096;
+
+} // namespace
+
+FileView::~FileView() {
+    stop_.store(true, std::memory_order_relaxed);
+    if (counter_.joinable()) counter_.join();
+#ifdef _WIN32
+    if (file_ != -1) CloseHandle(reinterpret_cast<HANDLE>(file_));
+#else
+    if (file_ != -1) ::close(static_cast<int>(file_));
+#endif
+}
+
+bool FileView::open(const std::string& path, bool with_lines) {
+#ifdef _WIN32
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER sz{};
+    if (!GetFileSizeEx(f, &sz)) {
+        CloseHandle(f);
+        return false;
+    }
+    size_ = static_cast<uint64_t>(sz.QuadPart);
+    file_ = reinterpret_cast<intptr_t>(f);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    size_ = static_cast<uint64_t>(st.st_size);
+    file_ = fd;
+#endif
+    stride_ = COUNT_CHUNK;
+    while (size_ / stride_ >= CHECKPOINTS) stride_ *= 2;
+    if (with_lines) counter_ = std::thread(&FileView::count_lines, this, path, size_);
+    return true;
+}
+
+std::string_view FileView::bytes(uint64_t off, size_t n) {
+    if (off >= size_) return {};
+    n = static_cast<size_t>(std::min<uint64_t>(n, size_ - off));
+    return std::string_view(map(off, n), n);
+}
+
+const char* FileView::map(uint64_t off, size_t n) {
+    if (win_len_ > 0 && off >= win_off_ && off + n <= win_off_ + win_len_) return window_.data() + (off - win_off_);
+    uint64_t base = off - off % WINDOW_ALIGN;
+    size_t len = base < size_ ? static_cast<size_t>(std::min<uint64_t>(WINDOW_BYTES, size_ - base)) : 0;
+    window_.resize(WINDOW_BYTES);
+    size_t got = read_at(base, window_.data(), len);
+    if (got < len) {
+        // truncated under the view: what is left is the file now, the caller gets zeros past it
+        std::memset(window_.data() + got, 0, window_.size() - got);
+        size_ = base + got;
+        shrank_ = true;
+    }
+    win_off_ = base;
+    win_len_ = got;
+    return window_.data() + (off - base);
+}
+
+size_t FileView::read_at(uint64_t off, char* buf, size_t n) const {
+    size_t done = 0;
+    while (done < n) {
+#ifdef _WIN32
+        OVERLAPPED ov{};
+        ov.Offset = static_cast<DWORD>(off + done);
+        ov.OffsetHigh = static_cast<DWORD>((off + done) >> 32);
+        DWORD got = 0;
+        if (!ReadFile(reinterpret_cast<HANDLE>(file_), buf + done, static_cast<DWORD>(n - done), &got, &ov) || got == 0)
+            break;
+#else
+        ssize_t got = ::pread(static_cast<int>(file_), buf + done, n - done, static_cast<off_t>(off + done));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+#endif
+        done += static_cast<size_t>(got);
+    }
+    return done;
+}
+
+uint64_t FileView::next_line(uint64_t start) {
+    for (uint64_t pos = start; pos < size_;) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(size_ - pos, SCAN_STEP));
+        const char* p = map(pos, n);
+        if (auto* nl = static_cast<const char*>(std::memchr(p, '\n', n))) return pos + static_cast<uint64_t>(nl - p) + 1;
+        pos += n;
+    }
+    return size_;
+}
+
+uint64_t FileView::line_start(uint64_t off) {
+    for (uint64_t end = off; end > 0;) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(end, SCAN_STEP));
+        const char* p = map(end - n, n);
+        for (size_t i = n; i-- > 0;)
+            if (p[i] == '\n') return end - n + i + 1;
+        end -= n;
+    }
+    return 0;
+}
+
+uint64_t FileView::count_newlines(uint64_t from, uint64_t to) {
+    uint64_t count = 0;
+    while (from < to) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(to - from, SCAN_STEP));
+        const char* p = map(from, n);
+        count += static_cast<uint64_t>(std::count(p, p + n, '\n'));
+        from += n;
+    }
+    return count;
+}
+
+uint64_t FileView::row(size_t i) {
+    while (top_ + i >= starts_.size()) {
+        if (starts_.back() >= size_) return npos;
+        starts_.push_back(next_line(starts_.back()));
+    }
+    uint64_t start = starts_[top_ + i];
+    return start < size_ ? start : npos;
+}
+
+int64_t FileView::scroll(int64_t n, size_t rows) {
+    int64_t moved = 0;
+    while (moved < n && row(rows) != npos) {
+        ++top_;
+        ++moved;
+    }
+    while (moved > n && (top_ > 0 || starts_.front() > 0)) {
+        if (top_ == 0) {
+            starts_.push_front(line_start(starts_.front() - 1));
+            ++top_;
+        }
+        --top_;
+        --moved;
+    }
+    top_line_ = static_cast<uint64_t>(std::max<int64_t>(0, static_cast<int64_t>(top_line_) + moved));
+    if (top() == 0) {
+        top_line_ = 0;
+        top_exact_ = true;
+    }
+    trim();
+    return moved;
+}
+
+void FileView::jump(uint64_t off) {
+    off = std::min(off, size_ > 0 ? size_ - 1 : 0);
+    starts_.assign(1, line_start(off));
+    top_ = 0;
+    top_line_ = number_at(starts_.front(), top_exact_);
+}
+
+void FileView::jump_line(uint64_t line) {
+    bool counted = counted_.load(std::memory_order_acquire);
+    if (counted && total_lines_ > 0) line = std::min(line, total_lines_ - 1);
+    uint64_t scanned = scanned_.load(std::memory_order_acquire);
+    if (!counted && line > newlines_.load(std::memory_order_relaxed)) {
+        // not counted that far yet
+        jump(static_cast<uint64_t>(static_cast<double>(line) * bytes_per_line()));
+        return;
+    }
+    // last checkpoint at or before the line, the line containing its offset has number checkpoints_[k]
+    auto first = checkpoints_.begin();
+    auto known = static_cast<std::ptrdiff_t>(scanned / stride_) + 1;
+    auto k = static_cast<size_t>(std::upper_bound(first, first + known, line) - first) - 1;
+    uint64_t pos = k * stride_;
+    uint64_t skip = line - checkpoints_[k];
+    // the line starts right after the skip-th newline from there
+    while (skip > 0 && pos < size_) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(size_ - pos, SCAN_STEP));
+        const char* p = map(pos, n);
+        const char* q = p;
+        while (skip > 0) {
+            auto* nl = static_cast<const char*>(std::memchr(q, '\n', static_cast<size_t>(p + n - q)));
+            if (!nl) break;
+            q = nl + 1;
+            --skip;
+        }
+        pos += skip == 0 ? static_cast<uint64_t>(q - p) : n;
+    }
+    jump(pos);
+}
+
+void FileView::jump_end(size_t rows) {
+    jump(size_);
+    scroll(-static_cast<int64_t>(rows > 0 ? rows - 1 : 0), rows);
+}
+
+std::string_view FileView::line(uint64_t start) {
+    if (start >= size_) return {};
+    size_t n = static_cast<size_t>(std::min<uint64_t>(size_ - start, MAX_LINE + 1));
+    const char* p = map(start, n);
+    auto* nl = static_cast<const char*>(std::memchr(p, '\n', n));
+    size_t len = nl ? static_cast<size_t>(nl - p) : std::min(n, MAX_LINE);
+    if (len > 0 && p[len - 1] == '\r') --len;
+    return {p, len};
+}
+
+uint64_t FileView::number_at(uint64_t start, bool& exact) {
+    uint64_t scanned = scanned_.load(std::memory_order_acquire);
+    if (start <= scanned) {
+        uint64_t k = start / stride_;
+        exact = true;
+        return checkpoints_[static_cast<size_t>(k)] + count_newlines(k * stride_, start);
+    }
+    exact = false;
+    auto estimate = static_cast<uint64_t>(static_cast<double>(start) / bytes_per_line());
+    return std::max(estimate, newlines_.load(std::memory_order_relaxed));
+}
+
+uint64_t FileView::top_line(bool& exact) {
+    if (!top_exact_) top_line_ = number_at(top(), top_exact_);
+    exact = top_exact_;
+    return top_line_;
+}
+
+uint64_t FileView::line_count(bool& exact) const {
+    exact = counted_.load(std::memory_order_acquire);
+    if (exact) return total_lines_;
+    auto estimate = static_cast<uint64_t>(static_cast<double>(size_) / bytes_per_line());
+    return std::max<uint64_t>({estimate, newlines_.load(std::memory_order_relaxed), 1});
+}
+
+double FileView::count_progress() const {
+    if (size_ == 0 || counted_.load(std::memory_order_acquire)) return 1.0;
+    return static_cast<double>(scanned_.load(std::memory_order_relaxed)) / static_cast<double>(size_);
+}
+
+double FileView::bytes_per_line() const {
+    uint64_t scanned = scanned_.load(std::memory_order_acquire);
+    uint64_t lines = newlines_.load(std::memory_order_relaxed);
+    if (scanned == 0) return 80.0; // nothing counted yet, guess
+    return static_cast<double>(scanned) / static_cast<double>(std::max<uint64_t>(lines, 1));
+}
+
+// Runs on counter_: reads the file front to back with its own stream (the window belongs to
+// the UI thread), leaving a checkpoint at every stride_. size is the size at open, size_ may
+// shrink meanwhile.
+void FileView::count_lines(std::string path, uint64_t size) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> chunk(COUNT_CHUNK);
+    uint64_t pos = 0;
+    uint64_t lines = 0;
+    char last = '\n';
+    while (in && pos < size && !stop_.load(std::memory_order_relaxed)) {
+        in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        auto n = static_cast<size_t>(in.gcount());
+        if (n == 0) break;
+        lines += static_cast<uint64_t>(std::count(chunk.data(), chunk.data() + n, '\n'));
+        last = chunk[n - 1];
+        pos += n;
+        if (pos % stride_ == 0 && pos / stride_ < CHECKPOINTS) checkpoints_[static_cast<size_t>(pos / stride_)] = lines;
+        newlines_.store(lines, std::memory_order_relaxed);
+        scanned_.store(pos, std::memory_order_release);
+        std::this_thread::yield(); // background work: let the UI go first on a busy (or single) core
+    }
+    if (pos >= size) {
+        total_lines_ = lines + (size > 0 && last != '\n' ? 1 : 0);
+        counted_.store(true, std::memory_order_release);
+    }
+}
+
+void FileView::trim() {
+    while (starts_.size() > LINE_CACHE) {
+        if (top_ > starts_.size() / 2) {
+            starts_.pop_front();
+            --top_;
+        } else {
+            starts_.pop_back();
+        }
+    }
+}
+
+} // namespace termite
@@ -0,0 +1,273 @@
+#include "termite/filter.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace termite {
+
+namespace {
+// Lines handed to one writev, and bytes taken from stdout per pump round
+constexpr size_t WRITE_LINES = 256;
+constexpr size_t READ_BYTES = size_t{64} << 10;
+constexpr size_t READS_PER_ROUND = 64;
+// Of stderr only the start is kept, for the message when the command fails
+constexpr size_t STDERR_KEEP = 4096;
+}
+
+FilterProcess::~FilterProcess() { cancel(); }
+
+#ifndef _WIN32
+
+bool FilterProcess::start(const std::string& command, Snapshot input, size_t first, size_t count) {
+    int in[2], out[2], err[2];
+    if (::pipe(in) != 0) return false;
+    if (::pipe(out) != 0) {
+        ::close(in[0]);
+        ::close(in[1]);
+        return false;
+    }
+    if (::pipe(err) != 0) {
+        for (int fd : {in[0], in[1], out[0], out[1]}) ::close(fd);
+        return false;
+    }
+    for (int fd : {in[0], in[1], out[0], out[1], err[0], err[1]}) ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    // a command that stops reading early must not take the editor down with SIGPIPE
+    std::signal(SIGPIPE, SIG_IGN);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+    // own process group, so cancel() gets everything the shell started; default SIGPIPE for it
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    sigaddset(&defaults, SIGINT);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+    std::string sh = "sh", dash_c = "-c", cmd = command;
+    char* argv[] = {sh.data(), dash_c.data(), cmd.data(), nullptr};
+    pid_t pid = -1;
+    int rc = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    for (int fd : {in[0], out[1], err[1]}) ::close(fd);
+    if (rc != 0) {
+        for (int fd : {in[1], out[0], err[0]}) ::close(fd);
+        error_ = std::strerror(rc);
+        return false;
+    }
+    pid_ = pid;
+    in_ = in[1];
+    out_ = out[0];
+    err_ = err[0];
+    for (int fd : {in_, out_, err_}) ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef F_SETPIPE_SZ
+    // bigger pipes, fewer round trips through poll (best effort)
+    ::fcntl(in_, F_SETPIPE_SZ, 1 << 20);
+    ::fcntl(out_, F_SETPIPE_SZ, 1 << 20);
+#endif
+    input_ = std::move(input);
+    first_ = next_row_ = std::min(first, input_.line_count());
+    count_ = std::min(count, input_.line_count() - first_);
+    next_col_ = 0;
+    if (count_ == 0) close_fd(in_);
+    return true;
+}
+
+void FilterProcess::feed() {
+    static const char newline = '\n';
+    size_t end = first_ + count_;
+    while (in_ >= 0) {
+        // the lines as they are in the snapshot, each one followed by its '\n'
+        iovec iov[2 * WRITE_LINES];
+        int n = 0;
+        size_t col = next_col_;
+        for (size_t row = next_row_; row < end && n + 2 <= (int)(2 * WRITE_LINES); ++row, col = 0) {
+            const std::string& line = input_.line(row);
+            if (col < line.size()) iov[n++] = {const_cast<char*>(line.data()) + col, line.size() - col};
+            iov[n++] = {const_cast<char*>(&newline), 1};
+        }
+        ssize_t w = ::writev(in_, iov, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            // EAGAIN: full, wait for poll; EPIPE: the command does not want the rest
+            if (errno != EAGAIN && errno != EWOULDBLOCK) close_fd(in_);
+            return;
+        }
+        bytes_in_ += static_cast<uint64_t>(w);
+        auto left = static_cast<size_t>(w);
+        while (left > 0) {
+            size_t rest = input_.line(next_row_).size() + 1 - next_col_;
+            if (left < rest) {
+                next_col_ += left;
+                break;
+            }
+            left -= rest;
+            ++next_row_;
+            next_col_ = 0;
+        }
+        if (next_row_ == end) close_fd(in_); // EOF for the command
+    }
+}
+
+void FilterProcess::drain(int& fd, bool keep) {
+    char buf[READ_BYTES];
+    for (size_t round = 0; fd >= 0 && round < READS_PER_ROUND; ++round) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) close_fd(fd);
+            return;
+        }
+        if (n == 0) {
+            close_fd(fd);
+            return;
+        }
+        if (!keep) {
+            stderr_.append(buf, std::min(static_cast<size_t>(n), STDERR_KEEP - std::min(STDERR_KEEP, stderr_.size())));
+            continue;
+        }
+        bytes_out_ += static_cast<uint64_t>(n);
+        const char* p = buf;
+        const char* end = buf + n;
+        while (const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)))) {
+            if (partial_.empty()) {
+                lines_.emplace_back(p, nl);
+            } else {
+                partial_.append(p, nl);
+                lines_.push_back(std::move(partial_));
+                partial_.clear();
+            }
+            p = nl + 1;
+        }
+        partial_.append(p, end);
+    }
+}
+
+void FilterProcess::close_fd(int& fd) {
+    if (fd < 0) return;
+    ::close(fd);
+    if (&fd == &in_) input_ = Snapshot(); // all written: the buffer need not keep the old lines
+    fd = -1;
+}
+
+FilterProcess::State FilterProcess::pump(std::chrono::milliseconds budget) {
+    using clock = std::chrono::steady_clock;
+    auto deadline = clock::now() + budget;
+    while (pid_ > 0) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now()).count();
+        int wait_ms = static_cast<int>(std::max<long long>(0, left));
+        pollfd fds[3];
+        int* owner[3];
+        nfds_t n = 0;
+        if (in_ >= 0) {
+            fds[n] = {in_, POLLOUT, 0};
+            owner[n++] = &in_;
+        }
+        if (out_ >= 0) {
+            fds[n] = {out_, POLLIN, 0};
+            owner[n++] = &out_;
+        }
+        if (err_ >= 0) {
+            fds[n] = {err_, POLLIN, 0};
+            owner[n++] = &err_;
+        }
+        if (n == 0) {
+            // all pipes closed: wait for the exit, a little at a time
+            int status = 0;
+            pid_t r = ::waitpid(pid_, &status, WNOHANG);
+            if (r == pid_) return finish(status);
+            if (r < 0 && errno != EINTR) {
+                pid_ = -1;
+                error_ = std::strerror(errno);
+                return State::Failed;
+            }
+            if (wait_ms == 0) return State::Running;
+            ::usleep(static_cast<useconds_t>(std::min(wait_ms, 5)) * 1000);
+            continue;
+        }
+        int ready = ::poll(fds, n, wait_ms);
+        if (ready < 0 && errno != EINTR) {
+            error_ = std::strerror(errno);
+            cancel();
+            return State::Failed;
+        }
+        for (nfds_t i = 0; ready > 0 && i < n; ++i) {
+            if (!fds[i].revents) continue;
+            if (owner[i] == &in_)
+                feed();
+            else
+                drain(*owner[i], owner[i] == &out_);
+        }
+        if (ready <= 0 && wait_ms == 0) return State::Running;
+        if (clock::now() >= deadline) return State::Running;
+    }
+    return error_.empty() ? State::Done : State::Failed;
+}
+
+FilterProcess::State FilterProcess::finish(int status) {
+    pid_ = -1;
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        if (!partial_.empty()) lines_.push_back(std::move(partial_));
+        partial_.clear();
+        return State::Done;
+    }
+    error_ = WIFEXITED(status) ? "exit " + std::to_string(WEXITSTATUS(status))
+                               : "killed by signal " + std::to_string(WTERMSIG(status));
+    std::string first_line = stderr_.substr(0, stderr_.find('\n'));
+    if (!first_line.empty()) error_ += ": " + first_line;
+    return State::Failed;
+}
+
+void FilterProcess::cancel() {
+    if (pid_ > 0) {
+        ::kill(-pid_, SIGKILL);
+        ::waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+        if (error_.empty()) error_ = "canceled";
+    }
+    close_fd(in_);
+    close_fd(out_);
+    close_fd(err_);
+}
+
+#else
+
+bool FilterProcess::start(const std::string&, Snapshot, size_t, size_t) {
+    error_ = "not supported on this platform";
+    return false;
+}
+
+FilterProcess::State FilterProcess::pump(std::chrono::milliseconds) { return State::Failed; }
+
+void FilterProcess::cancel() {}
+
+void FilterProcess::feed() {}
+
+void FilterProcess::drain(int&, bool) {}
+
+void FilterProcess::close_fd(int&) {}
+
+FilterProcess::State FilterProcess::finish(int) { return State::Failed; }
+
+#endif
+
+} // namespace termite
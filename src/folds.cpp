@@ -0,0 +1,228 @@
+#include "termite/folds.hpp"
+
+#include "termite/buffer.hpp"
+
+#include <algorithm>
+
+namespace termite {
+
+namespace {
+
+bool before(const FoldIndex::Fold& a, const FoldIndex::Fold& b) {
+    return a.first != b.first ? a.first < b.first : a.last > b.last;
+}
+
+} // namespace
+
+void FoldIndex::attach(const Buffer& buf) {
+    if (!folds_.empty()) return;
+    lines_ = buf.line_count();
+    revision_ = buf.revision();
+    hidden_.assign(lines_, 0);
+    hidden_.settle();
+}
+
+void FoldIndex::sync(const Buffer& buf) {
+    if (folds_.empty()) {
+        lines_ = buf.line_count();
+        revision_ = buf.revision();
+        return;
+    }
+    if (buf.revision() == revision_) return;
+    std::vector<LineEdit> edits;
+    if (!buf.edits_since(revision_, edits)) {
+        // too many edits to follow: the folds stay where they were, as far as the lines still exist
+        lines_ = buf.line_count();
+        revision_ = buf.revision();
+        folds_.erase(std::remove_if(folds_.begin(), folds_.end(), [&](const Fold& f) { return f.last >= lines_; }),
+                     folds_.end());
+        if (folds_.empty())
+            clear();
+        else
+            rebuild();
+        return;
+    }
+    // edits inside lines leave the folds alone; structural ones move them or open them
+    bool opened = false;
+    for (const auto& e : edits)
+        if ((e.removed != 0 || e.added != 0) && !folds_.empty()) opened |= follow(e);
+    hidden_.settle();
+    revision_ = buf.revision();
+    if (folds_.empty()) {
+        lines_ = buf.line_count();
+        clear();
+        return;
+    }
+    if (lines_ != buf.line_count()) {
+        lines_ = buf.line_count();
+        folds_.erase(std::remove_if(folds_.begin(), folds_.end(), [&](const Fold& f) { return f.last >= lines_; }),
+                     folds_.end());
+        if (folds_.empty())
+            clear();
+        else
+            rebuild();
+        return;
+    }
+    if (opened) ++version_;
+}
+
+bool FoldIndex::follow(const LineEdit& e) {
+    size_t end = e.row + e.removed;
+    // the folds from `after` on start below the edit and move along; of the ones before, those
+    // that reach into it open (lines inserted into a fold, its header removed)
+    size_t after = first_from(end);
+    std::vector<size_t> which;
+    covering(1, 0, leaves_, e.row, after, which);
+    drop(which);
+    after -= which.size();
+    hidden_.splice(e.row, e.removed, e.added, 0);
+    lines_ = lines_ - std::min(e.removed, lines_) + e.added;
+    for (size_t i = after; i < folds_.size(); ++i) {
+        folds_[i].first = folds_[i].first - e.removed + e.added;
+        folds_[i].last = folds_[i].last - e.removed + e.added;
+    }
+    if (!which.empty() || after < folds_.size()) rebuild_intervals();
+    return !which.empty();
+}
+
+bool FoldIndex::fold(const Buffer& buf, size_t first, size_t last) {
+    attach(buf);
+    if (last <= first || last >= lines_) return false;
+    Fold f{first, last};
+    auto at = std::lower_bound(folds_.begin(), folds_.end(), f, before);
+    if (at != folds_.end() && at->first == first && at->last == last) return false;
+    folds_.insert(at, f);
+    hide(first, last, 1);
+    rebuild_intervals();
+    ++version_;
+    return true;
+}
+
+void FoldIndex::fold_all(const Buffer& buf, std::vector<Fold> folds) {
+    lines_ = buf.line_count();
+    revision_ = buf.revision();
+    folds.erase(std::remove_if(folds.begin(), folds.end(),
+                               [&](const Fold& f) { return f.last <= f.first || f.last >= lines_; }),
+                folds.end());
+    folds_ = std::move(folds);
+    if (folds_.empty())
+        clear();
+    else
+        rebuild();
+}
+
+bool FoldIndex::unfold(size_t row) {
+    auto at = std::lower_bound(folds_.begin(), folds_.end(), Fold{row, SIZE_MAX}, before);
+    std::vector<size_t> which;
+    for (; at != folds_.end() && at->first == row; ++at) which.push_back(static_cast<size_t>(at - folds_.begin()));
+    if (which.empty()) return false;
+    remove(which);
+    return true;
+}
+
+void FoldIndex::reveal(size_t row) {
+    if (!hidden(row)) return;
+    // only folds that start above row can hide it
+    std::vector<size_t> which;
+    covering(1, 0, leaves_, row, first_from(row), which);
+    remove(which);
+}
+
+void FoldIndex::clear() {
+    folds_.clear();
+    max_last_.clear();
+    hidden_.clear();
+    ++version_;
+}
+
+size_t FoldIndex::folded_below(size_t row) const {
+    auto at = std::lower_bound(folds_.begin(), folds_.end(), Fold{row, SIZE_MAX}, before);
+    return at != folds_.end() && at->first == row ? at->last - row : 0;
+}
+
+size_t FoldIndex::visible_lines() const {
+    return folds_.empty() ? lines_ : static_cast<size_t>(hidden_.total().n);
+}
+
+size_t FoldIndex::row_of_line(size_t line) const {
+    return folds_.empty() ? std::min(line, lines_) : static_cast<size_t>(hidden_.prefix(line).n);
+}
+
+size_t FoldIndex::line_at(size_t vrow) const {
+    if (folds_.empty()) return std::min(vrow, lines_);
+    // down the tree: the first line with more than vrow visible ones up to it
+    int64_t seen = 0;
+    size_t line = hidden_.seek_forward(
+        0, [&](const Visible& v) { return seen + v.n > static_cast<int64_t>(vrow); }, [&](const Visible& v) { seen += v.n; });
+    return line == decltype(hidden_)::NONE ? lines_ : line;
+}
+
+void FoldIndex::rebuild() {
+    std::sort(folds_.begin(), folds_.end(), before);
+    folds_.erase(std::unique(folds_.begin(), folds_.end(),
+                             [](const Fold& a, const Fold& b) { return a.first == b.first && a.last == b.last; }),
+                 folds_.end());
+    // +1 where a fold starts hiding, -1 after its last line
+    std::vector<int32_t> diff(lines_ + 1, 0);
+    for (const auto& f : folds_) {
+        ++diff[f.first + 1];
+        --diff[f.last + 1];
+    }
+    hidden_.assign(lines_, 0);
+    int32_t depth = 0;
+    hidden_.update(0, lines_, [&](size_t i, uint32_t& h) {
+        depth += diff[i];
+        h = static_cast<uint32_t>(depth);
+    });
+    hidden_.settle();
+    rebuild_intervals();
+    ++version_;
+}
+
+void FoldIndex::rebuild_intervals() {
+    leaves_ = 1;
+    while (leaves_ < folds_.size()) leaves_ *= 2;
+    max_last_.assign(2 * leaves_, 0);
+    for (size_t i = 0; i < folds_.size(); ++i) max_last_[leaves_ + i] = folds_[i].last;
+    for (size_t i = leaves_ - 1; i > 0; --i) max_last_[i] = std::max(max_last_[2 * i], max_last_[2 * i + 1]);
+}
+
+void FoldIndex::hide(size_t first, size_t last, int delta) {
+    hidden_.update(first + 1, last - first,
+                   [&](size_t, uint32_t& h) { h = static_cast<uint32_t>(static_cast<int64_t>(h) + delta); });
+    hidden_.settle();
+}
+
+size_t FoldIndex::first_from(size_t row) const {
+    return static_cast<size_t>(std::lower_bound(folds_.begin(), folds_.end(), Fold{row, SIZE_MAX}, before) - folds_.begin());
+}
+
+void FoldIndex::covering(size_t node, size_t lo, size_t hi, size_t row, size_t end, std::vector<size_t>& out) const {
+    if (lo >= end || max_last_[node] < row) return;
+    if (hi - lo == 1) {
+        out.push_back(lo);
+        return;
+    }
+    size_t mid = (lo + hi) / 2;
+    covering(2 * node, lo, mid, row, end, out);
+    covering(2 * node + 1, mid, hi, row, end, out);
+}
+
+void FoldIndex::drop(std::vector<size_t>& which) {
+    for (size_t i : which) hide(folds_[i].first, folds_[i].last, -1);
+    std::sort(which.begin(), which.end());
+    for (size_t k = which.size(); k-- > 0;) folds_.erase(folds_.begin() + static_cast<std::ptrdiff_t>(which[k]));
+}
+
+void FoldIndex::remove(std::vector<size_t>& which) {
+    if (which.empty()) return;
+    drop(which);
+    if (folds_.empty()) {
+        clear();
+        return;
+    }
+    rebuild_intervals();
+    ++version_;
+}
+
+} // namespace termite
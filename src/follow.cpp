@@ -0,0 +1,120 @@
+#include "termite/follow.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace termite {
+
+FileFollower::~FileFollower() {
+#ifdef __linux__
+    if (inotify_ >= 0) ::close(inotify_);
+#endif
+}
+
+bool FileFollower::start(const std::string& path, uint64_t from) {
+    in_.open(path, std::ios::binary);
+    if (!in_) return false;
+    path_ = path;
+    offset_ = from;
+    size_ = file_size();
+#ifndef _WIN32
+    struct stat st {};
+    if (::stat(path.c_str(), &st) == 0) {
+        dev_ = static_cast<uint64_t>(st.st_dev);
+        ino_ = static_cast<uint64_t>(st.st_ino);
+    }
+#endif
+#ifdef __linux__
+    std::filesystem::path p(path);
+    name_ = p.filename().string();
+    std::string dir = p.has_parent_path() ? p.parent_path().string() : std::string(".");
+    inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_ >= 0) {
+        // the file for writes and for being moved away, the directory for the next one coming in
+        uint32_t file_events = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+        bool watched = inotify_add_watch(inotify_, path.c_str(), file_events) >= 0;
+        if (watched) dir_watch_ = inotify_add_watch(inotify_, dir.c_str(), IN_CREATE | IN_MOVED_TO);
+        if (!watched || dir_watch_ < 0) {
+            ::close(inotify_);
+            inotify_ = -1; // no watch (e.g. out of watches): fall back to looking at the size
+        }
+    }
+#endif
+    return true;
+}
+
+bool FileFollower::changed() {
+#ifdef __linux__
+    if (inotify_ >= 0) {
+        // the kind of event does not matter, only that one was about the followed file
+        alignas(inotify_event) char events[4096];
+        bool any = false;
+        ssize_t n;
+        while ((n = ::read(inotify_, events, sizeof(events))) > 0) {
+            for (char* p = events; p < events + n;) {
+                auto* ev = reinterpret_cast<inotify_event*>(p);
+                p += sizeof(inotify_event) + ev->len;
+                // the directory reports every file in it
+                if (ev->wd == dir_watch_ && (ev->len == 0 || name_ != ev->name)) continue;
+                any = true;
+            }
+        }
+        return any;
+    }
+#endif
+    return true;
+}
+
+bool FileFollower::replaced() const {
+#ifndef _WIN32
+    // no file under the name (moved away, the next not created yet): keep to the old one
+    struct stat st {};
+    return ::stat(path_.c_str(), &st) == 0 &&
+           (static_cast<uint64_t>(st.st_dev) != dev_ || static_cast<uint64_t>(st.st_ino) != ino_);
+#else
+    return false;
+#endif
+}
+
+uint64_t FileFollower::file_size() const {
+    std::error_code ec;
+    auto n = std::filesystem::file_size(path_, ec);
+    return ec ? size_ : static_cast<uint64_t>(n);
+}
+
+FileFollower::Change FileFollower::poll(std::string& out, size_t max) {
+    if (changed()) {
+        if (replaced()) return Change::Rotated;
+        size_ = file_size();
+    }
+    if (size_ < offset_) return Change::Truncated;
+    if (size_ == offset_) return Change::None;
+    size_t n = static_cast<size_t>(std::min<uint64_t>(size_ - offset_, max));
+    out.resize(n);
+    in_.clear(); // a read that hit the old end left eof set
+    in_.seekg(static_cast<std::streamoff>(offset_));
+    in_.read(out.data(), static_cast<std::streamsize>(n));
+    out.resize(static_cast<size_t>(in_.gcount()));
+    offset_ += out.size();
+    if (out.empty()) {
+        size_ = offset_; // could not read it after all, wait for the next change
+        return Change::None;
+    }
+    return Change::Appended;
+}
+
+void FileFollower::skip_to_end() {
+    changed();
+    offset_ = size_ = file_size();
+}
+
+} // namespace termite
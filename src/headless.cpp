@@ -0,0 +1,316 @@
+#include "termite/headless.hpp"
+
+#include "termite/unicode.hpp"
+
+#include <algorithm>
+
+namespace termite::headless {
+
+namespace {
+
+Terminal* g_terminal = nullptr;
+
+// Length of the UTF-8 sequence a lead byte announces (1 for anything unexpected)
+size_t utf8_length(unsigned char c) {
+    if ((c & 0xE0) == 0xC0) return 2;
+    if ((c & 0xF0) == 0xE0) return 3;
+    if ((c & 0xF8) == 0xF0) return 4;
+    return 1;
+}
+
+std::vector<int> parse_params(std::string_view p) {
+    std::vector<int> out;
+    int v = 0;
+    bool any = false;
+    for (char ch : p) {
+        if (ch >= '0' && ch <= '9') {
+            v = v * 10 + (ch - '0');
+            any = true;
+        } else if (ch == ';') {
+            out.push_back(any ? v : 0);
+            v = 0;
+            any = false;
+        }
+    }
+    if (any || !out.empty()) out.push_back(any ? v : 0);
+    return out;
+}
+
+} // namespace
+
+Terminal::Terminal(int rows, int cols)
+    : rows_(std::max(1, rows)), cols_(std::max(1, cols)),
+      grid_(static_cast<size_t>(rows_ * cols_)), bottom_(rows_ - 1) {}
+
+void Terminal::resize(int rows, int cols) {
+    rows_ = std::max(1, rows);
+    cols_ = std::max(1, cols);
+    grid_.assign(static_cast<size_t>(rows_ * cols_), Cell{});
+    cur_row_ = cur_col_ = 0;
+    wrap_pending_ = false;
+    top_ = 0;
+    bottom_ = rows_ - 1;
+}
+
+std::string Terminal::row_text(int row) const {
+    std::string s;
+    for (int c = 0; c < cols_; ++c) s += cell(row, c).text;
+    return s;
+}
+
+void Terminal::feed(std::string_view bytes) {
+    bytes_ += bytes.size();
+    ++writes_;
+    pending_.append(bytes);
+    const std::string& s = pending_;
+    size_t i = 0;
+    while (i < s.size()) {
+        auto c = static_cast<unsigned char>(s[i]);
+        if (c == 0x1b) {
+            if (i + 1 >= s.size()) break;
+            if (s[i + 1] != '[') {
+                i += 2; // ESC x: nothing Screen uses
+                continue;
+            }
+            size_t j = i + 2;
+            bool priv = j < s.size() && s[j] == '?';
+            if (priv) ++j;
+            size_t p0 = j;
+            while (j < s.size() && ((s[j] >= '0' && s[j] <= '9') || s[j] == ';' || s[j] == '$')) ++j;
+            if (j >= s.size()) break; // sequence continues in the next write
+            csi(s[j], std::string_view(s).substr(p0, j - p0), priv);
+            i = j + 1;
+            continue;
+        }
+        if (c == '\r') {
+            cur_col_ = 0;
+            wrap_pending_ = false;
+            ++i;
+            continue;
+        }
+        if (c == '\n') {
+            line_feed();
+            ++i;
+            continue;
+        }
+        if (c == '\b') {
+            cur_col_ = std::max(0, cur_col_ - 1);
+            wrap_pending_ = false;
+            ++i;
+            continue;
+        }
+        if (c < 0x20 || c == 0x7f) {
+            ++i;
+            continue;
+        }
+        if (i + utf8_length(c) > s.size()) break;
+        size_t len;
+        char32_t cp = unicode::decode(s, i, len);
+        int w = unicode::char_width(cp);
+        if (w == 0) {
+            // combining mark: belongs to the glyph left of the cursor
+            int col = wrap_pending_ ? cur_col_ : cur_col_ - 1;
+            if (col > 0 && cell(cur_row_, col).text.empty()) --col;
+            if (col >= 0) at(cur_row_, col).text.append(s, i, len);
+        } else {
+            put(std::string_view(s).substr(i, len), w);
+        }
+        i += len;
+    }
+    pending_.erase(0, i);
+}
+
+void Terminal::put(std::string_view glyph, int width) {
+    if (wrap_pending_ || (width == 2 && cur_col_ == cols_ - 1)) {
+        cur_col_ = 0;
+        wrap_pending_ = false;
+        line_feed();
+    }
+    // overwriting half of a wide glyph blanks the other half
+    auto claim = [&](int col) {
+        Cell& old = at(cur_row_, col);
+        if (old.text.empty() && col > 0) at(cur_row_, col - 1).text.assign(1, ' ');
+        else if (col + 1 < cols_ && at(cur_row_, col + 1).text.empty()) at(cur_row_, col + 1).text.assign(1, ' ');
+        old = pen_;
+    };
+    claim(cur_col_);
+    at(cur_row_, cur_col_).text.assign(glyph);
+    if (width == 2) {
+        claim(cur_col_ + 1);
+        at(cur_row_, cur_col_ + 1).text.clear();
+    }
+    cur_col_ += width;
+    if (cur_col_ >= cols_) {
+        cur_col_ = cols_ - 1;
+        wrap_pending_ = true;
+    }
+}
+
+void Terminal::line_feed() {
+    if (cur_row_ == bottom_) scroll_up(top_, bottom_, 1);
+    else if (cur_row_ < rows_ - 1) ++cur_row_;
+}
+
+void Terminal::scroll_up(int top, int bottom, int n) {
+    n = std::min(n, bottom - top + 1);
+    for (int r = top; r <= bottom; ++r) {
+        for (int c = 0; c < cols_; ++c) {
+            if (r + n <= bottom) at(r, c) = cell(r + n, c);
+            else at(r, c) = Cell{};
+        }
+    }
+}
+
+void Terminal::scroll_down(int top, int bottom, int n) {
+    n = std::min(n, bottom - top + 1);
+    for (int r = bottom; r >= top; --r) {
+        for (int c = 0; c < cols_; ++c) {
+            if (r - n >= top) at(r, c) = cell(r - n, c);
+            else at(r, c) = Cell{};
+        }
+    }
+}
+
+void Terminal::erase(int row, int c0, int c1) {
+    Cell blank;
+    blank.bg = pen_.bg;
+    for (int c = std::max(0, c0); c < std::min(c1, cols_); ++c) at(row, c) = blank;
+}
+
+void Terminal::csi(char final, std::string_view params, bool priv) {
+    std::vector<int> p = parse_params(params);
+    auto arg = [&](size_t i, int def) { return i < p.size() && p[i] != 0 ? p[i] : def; };
+    if (priv) {
+        if (final != 'h' && final != 'l') return;
+        for (int mode : p) {
+            if (mode == 25) cursor_visible_ = final == 'h';
+            else if (mode == 2026 && final == 'l') ++sync_frames_;
+            else if (mode == 1049) resize(rows_, cols_);
+        }
+        return;
+    }
+    switch (final) {
+    case 'H':
+    case 'f':
+        cur_row_ = std::clamp(arg(0, 1) - 1, 0, rows_ - 1);
+        cur_col_ = std::clamp(arg(1, 1) - 1, 0, cols_ - 1);
+        wrap_pending_ = false;
+        break;
+    case 'A': cur_row_ = std::max(0, cur_row_ - arg(0, 1)); wrap_pending_ = false; break;
+    case 'B': cur_row_ = std::min(rows_ - 1, cur_row_ + arg(0, 1)); wrap_pending_ = false; break;
+    case 'C': cur_col_ = std::min(cols_ - 1, cur_col_ + arg(0, 1)); wrap_pending_ = false; break;
+    case 'D': cur_col_ = std::max(0, cur_col_ - arg(0, 1)); wrap_pending_ = false; break;
+    case 'G': cur_col_ = std::clamp(arg(0, 1) - 1, 0, cols_ - 1); wrap_pending_ = false; break;
+    case 'J': {
+        int mode = p.empty() ? 0 : p[0];
+        int r0 = mode == 0 ? cur_row_ + 1 : 0;
+        int r1 = mode == 1 ? cur_row_ : rows_;
+        for (int r = r0; r < r1; ++r) erase(r, 0, cols_);
+        if (mode == 0) erase(cur_row_, cur_col_, cols_);
+        if (mode == 1) erase(cur_row_, 0, cur_col_ + 1);
+        break;
+    }
+    case 'K': {
+        int mode = p.empty() ? 0 : p[0];
+        if (mode == 0) erase(cur_row_, cur_col_, cols_);
+        else if (mode == 1) erase(cur_row_, 0, cur_col_ + 1);
+        else erase(cur_row_, 0, cols_);
+        break;
+    }
+    case 'm':
+        if (p.empty()) p.push_back(0);
+        for (size_t i = 0; i < p.size(); ++i) {
+            int v = p[i];
+            if (v == 0) pen_ = Cell{};
+            else if (v == 1) pen_.bold = true;
+            else if (v == 22) pen_.bold = false;
+            else if (v == 7) pen_.reverse = true;
+            else if (v == 27) pen_.reverse = false;
+            else if (v >= 30 && v <= 37) pen_.fg = v - 30;
+            else if (v >= 90 && v <= 97) pen_.fg = v - 90 + 8;
+            else if (v == 39) pen_.fg = -1;
+            else if (v >= 40 && v <= 47) pen_.bg = v - 40;
+            else if (v >= 100 && v <= 107) pen_.bg = v - 100 + 8;
+            else if (v == 49) pen_.bg = -1;
+            else if ((v == 38 || v == 48) && i + 2 < p.size() && p[i + 1] == 5) {
+                (v == 38 ? pen_.fg : pen_.bg) = p[i + 2];
+                i += 2;
+            }
+        }
+        break;
+    case 'r': {
+        int t = arg(0, 1) - 1;
+        int b = arg(1, rows_) - 1;
+        if (t < b && b < rows_) {
+            top_ = t;
+            bottom_ = b;
+        } else {
+            top_ = 0;
+            bottom_ = rows_ - 1;
+        }
+        cur_row_ = cur_col_ = 0;
+        wrap_pending_ = false;
+        break;
+    }
+    case 'S': scroll_up(top_, bottom_, arg(0, 1)); break;
+    case 'T': scroll_down(top_, bottom_, arg(0, 1)); break;
+    default: break;
+    }
+}
+
+void Terminal::push_key(std::string bytes) {
+    if (!bytes.empty()) keys_.push_back(std::move(bytes));
+}
+
+void Terminal::push_text(std::string_view text) {
+    for (auto& k : split_keys(text)) keys_.push_back(std::move(k));
+}
+
+bool Terminal::input_pending() {
+    if (!current_.empty()) return true;
+    if (!idle_reported_) {
+        // the key is over, give the editor its idle moment
+        idle_reported_ = true;
+        return false;
+    }
+    if (keys_.empty() && !quit_at_end_) return false;
+    current_ = keys_.empty() ? std::string("\x11") : std::move(keys_.front());
+    if (!keys_.empty()) keys_.pop_front();
+    idle_reported_ = false;
+    return true;
+}
+
+int Terminal::read_byte() {
+    if (current_.empty() && !input_pending()) return -1; // like the read timeout of a real tty
+    auto c = static_cast<unsigned char>(current_.front());
+    current_.erase(0, 1);
+    return c;
+}
+
+void attach(Terminal* term) { g_terminal = term; }
+
+Terminal* attached() { return g_terminal; }
+
+std::vector<std::string> split_keys(std::string_view bytes) {
+    std::vector<std::string> keys;
+    size_t i = 0;
+    while (i < bytes.size()) {
+        auto c = static_cast<unsigned char>(bytes[i]);
+        size_t n = 1;
+        if (c == 0x1b && i + 1 < bytes.size() && bytes[i + 1] == '[') {
+            // CSI: parameters, then one final byte in 0x40..0x7e
+            n = 2;
+            while (i + n < bytes.size() && (bytes[i + n] < 0x40 || bytes[i + n] > 0x7e)) ++n;
+            n = std::min(n + 1, bytes.size() - i);
+        } else if (c == 0x1b && i + 2 < bytes.size() && bytes[i + 1] == 'O') {
+            n = 3;
+        } else if (c >= 0xC0) {
+            n = std::min(utf8_length(c), bytes.size() - i);
+        }
+        keys.emplace_back(bytes.substr(i, n));
+        i += n;
+    }
+    return keys;
+}
+
+} // namespace termite::headless
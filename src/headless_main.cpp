@@ -0,0 +1,81 @@
+// termite_headless: runs the editor on an in-memory terminal with scripted keys and prints the
+// final screen plus output statistics. For CI checks and measurements without a tty.
+//
+//   termite_headless [--size ROWSxCOLS] [--keys KEYS] [--replay LOG] [file]
+//
+// KEYS is a byte string with C style escapes (\e \n \r \t \\ \xHH); Ctrl-Q is typed at the end.
+// --replay plays a key log recorded with termite --record instead.
+
+#include "termite/editor.hpp"
+#include "termite/headless.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string unescape(const std::string& s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] != '\\' || i + 1 == s.size()) {
+            out.push_back(s[i]);
+            continue;
+        }
+        char c = s[++i];
+        switch (c) {
+        case 'e': out.push_back('\x1b'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'x':
+            if (i + 2 < s.size()) {
+                out.push_back(static_cast<char>(std::strtol(s.substr(i + 1, 2).c_str(), nullptr, 16)));
+                i += 2;
+            }
+            break;
+        default: out.push_back(c); break;
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int rows = 24, cols = 80;
+    std::string keys;
+    bool replay = false; // keys come from a --replay log (passed on to the editor)
+    std::vector<char*> args{argv[0]};
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--size" && i + 1 < argc) {
+            std::sscanf(argv[++i], "%dx%d", &rows, &cols);
+        } else if (a == "--keys" && i + 1 < argc) {
+            keys = unescape(argv[++i]);
+        } else {
+            if (a == "--replay") replay = true;
+            args.push_back(argv[i]);
+        }
+    }
+
+    termite::headless::Terminal term(rows, cols);
+    term.push_text(keys);
+    term.set_quit_at_end(!replay);
+    termite::headless::attach(&term);
+
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        termite::Editor editor;
+        editor.run(static_cast<int>(args.size()), args.data());
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+    termite::headless::attach(nullptr);
+
+    for (int r = 0; r < term.rows(); ++r) std::printf("%s\n", term.row_text(r).c_str());
+    std::printf("cursor %d,%d  frames %zu  writes %zu  bytes %zu  time %lld us\n", term.cursor_row() + 1,
+                term.cursor_col() + 1, term.sync_frames(), term.writes(), term.bytes(), static_cast<long long>(us));
+    return 0;
+}
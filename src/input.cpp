@@ -1,11 +1,98 @@
 #include "termite/input.hpp"
 #include "termite/platform.hpp"
 
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
 namespace termite::input {
 
+using clock = std::chrono::steady_clock;
+
+namespace {
+
+struct LoggedKey { long long us; int key; };
+
+// --record
+std::FILE* g_record = nullptr;
+clock::time_point g_record_start;
+
+// --replay
+bool g_replaying = false;
+std::vector<LoggedKey> g_replay;
+size_t g_replay_pos = 0;
+clock::time_point g_replay_start;
+
+clock::time_point replay_due() {
+    return g_replay_start + std::chrono::microseconds(g_replay[g_replay_pos].us);
+}
+
+// Ctrl-Q typed on the real keyboard ends a replay
+bool replay_aborted() {
+    return platform::input_pending(0) && platform::read_key() == KEY_CTRL_Q;
+}
+
+} // namespace
+
 static int read_byte() { return platform::read_key(); }
 
+static int decode_key();
+
+bool key_pending(int timeout_ms) {
+    if (!g_replaying) return platform::input_pending(timeout_ms);
+    if (g_replay_pos >= g_replay.size()) return true; // Ctrl-Q comes next
+    auto now = clock::now();
+    auto due = replay_due();
+    if (due <= now) return true;
+    if (timeout_ms == 0) return false;
+    auto wait = due - now;
+    if (timeout_ms > 0) wait = std::min<clock::duration>(wait, std::chrono::milliseconds(timeout_ms));
+    std::this_thread::sleep_for(wait);
+    return clock::now() >= due;
+}
+
 int read_key() {
+    if (g_replaying) {
+        if (g_replay_pos >= g_replay.size() || replay_aborted()) return KEY_CTRL_Q;
+        std::this_thread::sleep_until(replay_due());
+        return g_replay[g_replay_pos++].key;
+    }
+    int k = decode_key();
+    if (g_record && k != KEY_UNKNOWN) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - g_record_start).count();
+        std::fprintf(g_record, "%lld %d\n", static_cast<long long>(us), k);
+        std::fflush(g_record); // the log is most useful right before a crash
+    }
+    return k;
+}
+
+bool record_to(const std::string& path) {
+    if (g_record) std::fclose(g_record);
+    g_record = std::fopen(path.c_str(), "w");
+    if (!g_record) return false;
+    std::fprintf(g_record, "# termite key log: <microseconds since start> <key code>\n");
+    g_record_start = clock::now();
+    return true;
+}
+
+bool replay_from(const std::string& path) {
+    std::FILE* f = std::fopen(path.c_str(), "r");
+    if (!f) return false;
+    g_replay.clear();
+    char line[128];
+    while (std::fgets(line, sizeof(line), f)) {
+        LoggedKey k{};
+        if (line[0] != '#' && std::sscanf(line, "%lld %d", &k.us, &k.key) == 2) g_replay.push_back(k);
+    }
+    std::fclose(f);
+    g_replay_pos = 0;
+    g_replay_start = clock::now();
+    g_replaying = true;
+    return true;
+}
+
+static int decode_key() {
     int c = read_byte();
     if (c == '\r' || c == '\n') return KEY_ENTER;
     if (c == 127 || c == 8) return KEY_BACKSPACE;
@@ -75,6 +162,10 @@ int read_key() {
                             case 'D': return KEY_CTRL_LEFT;
                             case 'H': return KEY_CTRL_HOME;
                             case 'F': return KEY_CTRL_END;
+                            case '~': // ESC [ 5 ; 5 ~
+                                if (p1 == 5) return KEY_CTRL_PAGE_UP;
+                                if (p1 == 6) return KEY_CTRL_PAGE_DOWN;
+                                break;
                             default: break;
                         }
                     } else if (p2 == 2) { // Shift modifier
@@ -85,6 +176,20 @@ int read_key() {
                             case 'D': return KEY_SHIFT_LEFT;
                             default: break;
                         }
+                    } else if (p2 == 3) { // Alt modifier
+                        switch (ch) {
+                            case 'A': return KEY_ALT_UP;
+                            case 'B': return KEY_ALT_DOWN;
+                            default: break;
+                        }
+                    } else if (p2 == 4) { // Alt+Shift
+                        switch (ch) {
+                            case 'A': return KEY_ALT_SHIFT_UP;
+                            case 'B': return KEY_ALT_SHIFT_DOWN;
+                            case 'C': return KEY_ALT_SHIFT_RIGHT;
+                            case 'D': return KEY_ALT_SHIFT_LEFT;
+                            default: break;
+                        }
                     } else if (p2 == 6) { // Ctrl+Shift
                         switch (ch) {
                             case 'A': return KEY_CTRL_SHIFT_UP;
@@ -0,0 +1,458 @@
+#include "termite/journal.hpp"
+
+#include "termite/file_io.hpp"
+
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace termite {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr char MAGIC[8] = {'T', 'M', 'J', 'R', 'N', 'L', '1', '\n'};
+// Group commit: after the first record of a batch, wait this long for more before writing
+constexpr auto COMMIT_DELAY = std::chrono::milliseconds(50);
+// Compact once the records outweigh the contents they apply to, but not below this
+constexpr uint64_t COMPACT_MIN_BYTES = uint64_t{8} << 20;
+// Record kind of a compaction snapshot, next to the BufferOp kinds
+constexpr uint8_t CONTENTS = 0x10;
+
+void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+bool get_varint(std::string_view& in, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+        auto b = static_cast<unsigned char>(in.front());
+        in.remove_prefix(1);
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+void put_u32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+uint32_t get_u32(std::string_view in) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<unsigned char>(in[static_cast<size_t>(i)])) << (8 * i);
+    return v;
+}
+
+// h: the hash so far, to hash data that arrives in pieces
+uint32_t fnv1a(std::string_view data, uint32_t h = 2166136261u) {
+    for (char c : data) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+bool sync_file(std::FILE* f) {
+    if (std::fflush(f) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+// Permission bits of the journal of file: the file's own, its contents end up in the journal
+// (owner only if there is no file to take them from)
+uint32_t mode_of(const std::string& file) {
+#ifdef _WIN32
+    (void)file;
+    return 0600;
+#else
+    struct stat st;
+    return ::stat(file.c_str(), &st) == 0 ? static_cast<uint32_t>(st.st_mode & 0666) : 0600;
+#endif
+}
+
+// Journal file for writing with the given permission bits, truncated or appended to
+std::FILE* open_file(const std::string& path, uint32_t mode, bool append) {
+#ifdef _WIN32
+    (void)mode;
+    return std::fopen(path.c_str(), append ? "ab" : "wb");
+#else
+    int fd = ::open(path.c_str(), O_CREAT | O_WRONLY | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), static_cast<mode_t>(mode));
+    if (fd < 0) return nullptr;
+    // the bits only apply to a new file: one left by an older version may be readable by others
+    std::FILE* f = ::fchmod(fd, static_cast<mode_t>(mode)) == 0 ? ::fdopen(fd, append ? "ab" : "wb") : nullptr;
+    if (!f) ::close(fd);
+    return f;
+#endif
+}
+
+// Magic and base, the part of a journal that is there before the first frame
+std::FILE* start_file(const std::string& path, const Journal::Base& base, uint32_t mode) {
+    std::FILE* f = open_file(path, mode, false);
+    if (!f) return nullptr;
+    std::string header(MAGIC, sizeof(MAGIC));
+    put_varint(header, base.size);
+    put_varint(header, base.mtime);
+    if (std::fwrite(header.data(), 1, header.size(), f) != header.size()) {
+        std::fclose(f);
+        return nullptr;
+    }
+    return f;
+}
+
+// One record into buf; false if the data ends early or the kind is unknown
+bool replay_record(std::string_view& in, Buffer& buf) {
+    if (in.empty()) return false;
+    auto kind = static_cast<uint8_t>(in.front());
+    in.remove_prefix(1);
+    uint64_t row = 0, col = 0, len = 0;
+    switch (kind) {
+    case BufferOp::InsertChar:
+        if (!get_varint(in, row) || !get_varint(in, col) || in.empty()) return false;
+        buf.apply({BufferOp::InsertChar, row, col, in.substr(0, 1)});
+        in.remove_prefix(1);
+        return true;
+    case BufferOp::DeleteChar:
+    case BufferOp::SplitLine:
+        if (!get_varint(in, row) || !get_varint(in, col)) return false;
+        buf.apply({static_cast<BufferOp::Kind>(kind), row, col, {}});
+        return true;
+    case BufferOp::JoinLine:
+    case BufferOp::DeleteLine:
+        if (!get_varint(in, row)) return false;
+        buf.apply({static_cast<BufferOp::Kind>(kind), row, 0, {}});
+        return true;
+    case BufferOp::Append:
+        if (!get_varint(in, len) || len > in.size()) return false;
+        buf.apply({BufferOp::Append, 0, 0, in.substr(0, len)});
+        in.remove_prefix(len);
+        return true;
+    case CONTENTS: {
+        if (in.empty()) return false;
+        auto flags = static_cast<uint8_t>(in.front());
+        in.remove_prefix(1);
+        if (!get_varint(in, len) || len > in.size()) return false;
+        buf.set_contents(std::string(in.substr(0, len)));
+        buf.set_format({flags & 1 ? LineEnding::CRLF : LineEnding::LF, (flags & 2) != 0, (flags & 4) != 0});
+        in.remove_prefix(len);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+std::string Journal::path_for(const std::string& file) {
+    fs::path p(file);
+    std::string name = ".";
+    name += p.filename().string();
+    name += ".termite-journal";
+    return (p.parent_path() / name).string();
+}
+
+Journal::Base Journal::base_of(const std::string& file) {
+    Base b;
+    std::error_code ec;
+    auto size = fs::file_size(file, ec);
+    if (!ec) b.size = static_cast<uint64_t>(size);
+    auto t = fs::last_write_time(file, ec);
+    if (!ec) b.mtime = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count());
+    return b;
+}
+
+Journal::Recovery Journal::recover(const std::string& file, Buffer& buf) {
+    Recovery r;
+    std::string path = path_for(file);
+    std::error_code ec;
+    if (!fs::exists(path, ec)) return r;
+#ifndef _WIN32
+    // edits someone else put next to the file are not ours to replay
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || st.st_uid != ::geteuid()) return r;
+#endif
+    std::string data;
+    try {
+        data = file_io::read_file(path);
+    } catch (...) {
+        return r;
+    }
+    r.found = true;
+    std::string_view in(data);
+    Base base;
+    if (in.substr(0, sizeof(MAGIC)) != std::string_view(MAGIC, sizeof(MAGIC))) return r;
+    in.remove_prefix(sizeof(MAGIC));
+    if (!get_varint(in, base.size) || !get_varint(in, base.mtime) || !(base == base_of(file))) return r;
+    r.matches = true;
+    r.valid_bytes = data.size() - in.size();
+    // frames: u32 length, u32 checksum, records; a torn or corrupt frame ends the journal
+    while (in.size() >= 8) {
+        uint32_t len = get_u32(in);
+        uint32_t sum = get_u32(in.substr(4));
+        if (len > in.size() - 8) break;
+        std::string_view frame = in.substr(8, len);
+        if (fnv1a(frame) != sum) break;
+        while (!frame.empty() && replay_record(frame, buf)) ++r.records;
+        in.remove_prefix(8 + static_cast<size_t>(len));
+        r.valid_bytes = data.size() - in.size();
+    }
+    return r;
+}
+
+bool Journal::lock(const std::string& file) {
+#ifdef _WIN32
+    (void)file;
+    return true;
+#else
+    std::string path = path_for(file) + ".lock";
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        int fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, static_cast<mode_t>(mode_of(file)));
+        if (fd < 0) return true; // no lock file where no journal can be written either
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            int err = errno;
+            ::close(fd);
+            if (err == EWOULDBLOCK) return false;
+            return true; // no locks on this file system
+        }
+        // the session before may have removed the lock file in between: ours has to be the one at path
+        struct stat held, now;
+        if (::fstat(fd, &held) == 0 && ::stat(path.c_str(), &now) == 0 && held.st_dev == now.st_dev &&
+            held.st_ino == now.st_ino) {
+            lock_fd_ = fd;
+            lock_path_ = path;
+            return true;
+        }
+        ::close(fd);
+    }
+    return false;
+#endif
+}
+
+Journal::~Journal() {
+    stop();
+#ifndef _WIN32
+    if (lock_fd_ >= 0) {
+        ::unlink(lock_path_.c_str());
+        ::close(lock_fd_);
+    }
+#endif
+}
+
+void Journal::open(const std::string& file, uint64_t keep_bytes) {
+    file_ = file;
+    path_ = path_for(file);
+    base_ = base_of(file);
+    mode_ = mode_of(file);
+    keep_bytes_ = keep_bytes;
+    record_bytes_ = keep_bytes;
+    contents_bytes_ = base_.size;
+    writer_ = std::thread(&Journal::writer_loop, this);
+}
+
+void Journal::applied(const BufferOp& op) {
+    std::lock_guard<std::mutex> lk(mu_);
+    bool first = pending_.empty();
+    size_t before = pending_.size();
+    pending_.push_back(static_cast<char>(op.kind));
+    switch (op.kind) {
+    case BufferOp::InsertChar:
+        put_varint(pending_, op.row);
+        put_varint(pending_, op.col);
+        pending_.push_back(op.text.empty() ? '\0' : op.text[0]);
+        break;
+    case BufferOp::DeleteChar:
+    case BufferOp::SplitLine:
+        put_varint(pending_, op.row);
+        put_varint(pending_, op.col);
+        break;
+    case BufferOp::JoinLine:
+    case BufferOp::DeleteLine:
+        put_varint(pending_, op.row);
+        break;
+    case BufferOp::Append:
+        put_varint(pending_, op.text.size());
+        pending_.append(op.text);
+        break;
+    }
+    record_bytes_.fetch_add(pending_.size() - before, std::memory_order_relaxed);
+    if (first) cv_.notify_one();
+}
+
+void Journal::checkpoint() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        pending_.clear();
+        compact_ = false;
+        compact_snap_ = Snapshot();
+        reset_ = true;
+        base_ = base_of(file_);
+        contents_bytes_ = base_.size;
+    }
+    record_bytes_ = 0;
+    cv_.notify_one();
+}
+
+bool Journal::wants_compaction() const {
+    uint64_t records = record_bytes_.load(std::memory_order_relaxed);
+    return records > COMPACT_MIN_BYTES && records > contents_bytes_;
+}
+
+void Journal::compact(Snapshot contents, const FileFormat& format) {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        // the snapshot already holds everything the pending records would do
+        pending_.clear();
+        reset_ = false;
+        compact_ = true;
+        compact_snap_ = std::move(contents);
+        compact_format_ = format;
+    }
+    record_bytes_ = 0;
+    cv_.notify_one();
+}
+
+void Journal::discard() {
+    stop();
+    std::error_code ec;
+    fs::remove(path_, ec);
+}
+
+void Journal::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (writer_.joinable()) writer_.join();
+    if (out_) {
+        std::fclose(out_);
+        out_ = nullptr;
+    }
+}
+
+bool Journal::write_frame(std::FILE* f, const std::string& payload) {
+    std::string head;
+    put_u32(head, static_cast<uint32_t>(payload.size()));
+    put_u32(head, fnv1a(payload));
+    return std::fwrite(head.data(), 1, head.size(), f) == head.size() &&
+           std::fwrite(payload.data(), 1, payload.size(), f) == payload.size() && sync_file(f);
+}
+
+bool Journal::write_contents(std::FILE* f, const Snapshot& snap, const FileFormat& format, uint64_t& text_bytes) {
+    // the lines go from the snapshot straight into the file, no copy of the text in between: the
+    // length is counted first, the checksum is kept running and filled into the frame at the end
+    size_t lines = snap.line_count();
+    text_bytes = lines > 0 ? lines - 1 : 0;
+    snap.for_each_line([&](const std::string& line) { text_bytes += line.size(); });
+    std::string record(1, static_cast<char>(CONTENTS));
+    record.push_back(static_cast<char>((format.eol == LineEnding::CRLF ? 1 : 0) | (format.trailing_newline ? 2 : 0) |
+                                       (format.utf8_bom ? 4 : 0)));
+    put_varint(record, text_bytes);
+    uint64_t payload = record.size() + text_bytes;
+    if (payload > UINT32_MAX) return false; // does not fit a frame
+    long at = std::ftell(f);
+    std::string head;
+    put_u32(head, static_cast<uint32_t>(payload));
+    put_u32(head, 0);
+    bool ok = at >= 0 && std::fwrite(head.data(), 1, head.size(), f) == head.size() &&
+              std::fwrite(record.data(), 1, record.size(), f) == record.size();
+    uint32_t sum = fnv1a(record);
+    size_t left = lines;
+    snap.for_each_line([&](const std::string& line) {
+        if (!ok) return;
+        ok = std::fwrite(line.data(), 1, line.size(), f) == line.size();
+        sum = fnv1a(line, sum);
+        if (--left > 0) {
+            ok = ok && std::fputc('\n', f) != EOF;
+            sum = fnv1a("\n", sum);
+        }
+    });
+    std::string check;
+    put_u32(check, sum);
+    return ok && std::fseek(f, at + 4, SEEK_SET) == 0 && std::fwrite(check.data(), 1, check.size(), f) == check.size() &&
+           sync_file(f);
+}
+
+void Journal::writer_loop() {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (true) {
+        cv_.wait(lk, [&] { return stop_ || reset_ || compact_ || !pending_.empty(); });
+        // group commit: keys typed meanwhile go into the same frame; stopping cuts the wait short
+        if (!stop_) cv_.wait_for(lk, COMMIT_DELAY, [&] { return stop_; });
+        std::string batch;
+        batch.swap(pending_);
+        bool reset = std::exchange(reset_, false);
+        bool compact = std::exchange(compact_, false);
+        Snapshot snap = std::move(compact_snap_);
+        compact_snap_ = Snapshot();
+        FileFormat format = compact_format_;
+        Base base = base_;
+        bool stopping = stop_;
+        lk.unlock();
+
+        if (!failed_.load(std::memory_order_relaxed)) {
+            bool ok = true;
+            std::error_code ec;
+            if (reset) {
+                // saved: nothing to recover until the next edit
+                if (out_) std::fclose(out_);
+                out_ = nullptr;
+                keep_bytes_ = 0;
+                fs::remove(path_, ec);
+            }
+            if (compact) {
+                // new journal next to the old one, swapped in once it is on disk
+                std::string tmp = path_ + ".tmp";
+                std::FILE* f = start_file(tmp, base, mode_);
+                uint64_t text_bytes = 0;
+                ok = f && write_contents(f, snap, format, text_bytes);
+                if (f) std::fclose(f);
+                if (ok) {
+                    if (out_) std::fclose(out_);
+                    fs::rename(tmp, path_, ec);
+                    out_ = ec ? nullptr : open_file(path_, mode_, true);
+                    ok = out_ != nullptr;
+                    keep_bytes_ = 0;
+                    contents_bytes_ = text_bytes;
+                }
+            }
+            if (ok && !batch.empty()) {
+                if (!out_ && keep_bytes_ > 0) {
+                    // continue a recovered journal after its last intact frame
+                    fs::resize_file(path_, keep_bytes_, ec);
+                    out_ = ec ? nullptr : open_file(path_, mode_, true);
+                    keep_bytes_ = 0;
+                } else if (!out_) {
+                    out_ = start_file(path_, base, mode_);
+                }
+                ok = out_ && write_frame(out_, batch);
+            }
+            if (!ok) failed_.store(true, std::memory_order_relaxed);
+        }
+
+        lk.lock();
+        if (stopping) break;
+    }
+}
+
+} // namespace termite
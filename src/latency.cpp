@@ -0,0 +1,69 @@
+#include "termite/latency.hpp"
+
+#include <bit>
+#include <cstdio>
+
+namespace termite {
+
+void LatencyHistogram::add(uint64_t ns) {
+    size_t idx;
+    if (ns < SUB) {
+        idx = static_cast<size_t>(ns);
+    } else {
+        int msb = std::bit_width(ns) - 1;
+        int shift = msb - SUB_BITS;
+        idx = static_cast<size_t>((shift + 1) * SUB + ((ns >> shift) - SUB));
+    }
+    ++buckets_[idx];
+    ++count_;
+    if (ns > max_) max_ = ns;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    if (count_ == 0) return 0;
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(count_ - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+        seen += buckets_[i];
+        if (seen < rank) continue;
+        if (i < SUB) return i;
+        size_t shift = i / SUB - 1;
+        uint64_t top = ((SUB + i % SUB + 1) << shift) - 1;
+        return top < max_ ? top : max_;
+    }
+    return max_;
+}
+
+void KeyLatency::key(clock::time_point read_start, clock::duration decode, clock::duration handle) {
+    phases_[Decode].add(static_cast<uint64_t>(std::chrono::nanoseconds(decode).count()));
+    phases_[Handle].add(static_cast<uint64_t>(std::chrono::nanoseconds(handle).count()));
+    waiting_.push_back(read_start);
+}
+
+void KeyLatency::frame(clock::duration render, clock::duration flush, clock::time_point end) {
+    for (auto start : waiting_) {
+        phases_[Render].add(static_cast<uint64_t>(std::chrono::nanoseconds(render).count()));
+        phases_[Flush].add(static_cast<uint64_t>(std::chrono::nanoseconds(flush).count()));
+        phases_[Total].add(static_cast<uint64_t>(std::chrono::nanoseconds(end - start).count()));
+    }
+    waiting_.clear();
+}
+
+std::string KeyLatency::report() const {
+    static const char* names[] = {"decode", "handle_input", "render", "flush", "key-to-flush"};
+    std::string out;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-14s %8s %10s %10s %10s %10s\n", "latency (us)", "keys", "p50", "p99",
+                  "p999", "max");
+    out += line;
+    for (int p = 0; p < PhaseCount; ++p) {
+        const auto& h = phases_[static_cast<size_t>(p)];
+        std::snprintf(line, sizeof(line), "%-14s %8llu %10.1f %10.1f %10.1f %10.1f\n", names[p],
+                      static_cast<unsigned long long>(h.count()), h.percentile(0.50) / 1e3, h.percentile(0.99) / 1e3,
+                      h.percentile(0.999) / 1e3, h.max() / 1e3);
+        out += line;
+    }
+    return out;
+}
+
+} // namespace termite
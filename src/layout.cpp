@@ -0,0 +1,147 @@
+#include "termite/layout.hpp"
+
+#include "termite/buffer.hpp"
+#include "termite/unicode.hpp"
+
+#include <algorithm>
+
+namespace termite {
+
+namespace {
+
+constexpr size_t MAX_CACHED_LINES = 4096;
+
+bool is_control(unsigned char c) { return c < 0x20 || c == 0x7f; }
+
+} // namespace
+
+int LineLayout::col_of(int byte) const {
+    if (plain) return std::clamp(byte, 0, width);
+    auto it = std::lower_bound(bytes.begin(), bytes.end(), byte);
+    if (it == bytes.end()) return width;
+    return cols[static_cast<size_t>(it - bytes.begin())];
+}
+
+int LineLayout::byte_at(int col) const {
+    if (plain) return std::clamp(col, 0, width);
+    if (col >= width) return bytes.back();
+    auto it = std::upper_bound(cols.begin(), cols.end(), col);
+    if (it == cols.begin()) return 0;
+    return bytes[static_cast<size_t>(it - cols.begin()) - 1];
+}
+
+void build_layout(const std::string& line, LineLayout& out) {
+    out.bytes.clear();
+    out.cols.clear();
+    out.text.clear();
+    out.text_off.clear();
+    out.syntax.clear();
+    out.syntax_valid = false;
+    out.wrap_width = 0;
+    out.wrap_starts.clear();
+    if (unicode::is_plain_ascii(line.data(), line.size())) {
+        out.plain = true;
+        out.width = static_cast<int>(line.size());
+        return;
+    }
+    out.plain = false;
+    out.text.reserve(line.size());
+    int col = 0;
+    size_t i = 0;
+    while (i < line.size()) {
+        auto c = static_cast<unsigned char>(line[i]);
+        size_t next;
+        int w;
+        out.bytes.push_back(static_cast<int>(i));
+        out.cols.push_back(col);
+        if (c == '\t') {
+            next = i + 1;
+            w = TAB_WIDTH - (col % TAB_WIDTH);
+            for (int k = 0; k < w; ++k) {
+                out.text_off.push_back(static_cast<int>(out.text.size()));
+                out.text.push_back(' ');
+            }
+        } else if (is_control(c)) {
+            next = i + 1;
+            w = 2;
+            out.text_off.push_back(static_cast<int>(out.text.size()));
+            out.text.push_back('^');
+            out.text_off.push_back(static_cast<int>(out.text.size()));
+            out.text.push_back(static_cast<char>(c ^ 0x40));
+        } else {
+            if (c < 0x80 && (i + 1 == line.size() || static_cast<unsigned char>(line[i + 1]) < 0x80)) {
+                next = i + 1;
+                w = 1;
+            } else {
+                next = unicode::next_grapheme(line, i);
+                w = unicode::grapheme_width(line, i, next);
+            }
+            out.text_off.push_back(static_cast<int>(out.text.size()));
+            for (int k = 1; k < w; ++k) out.text_off.push_back(-1);
+            size_t len;
+            if (c >= 0x80 && unicode::decode(line, i, len) == 0xFFFD && len == 1) {
+                out.text.append("\xEF\xBF\xBD"); // invalid UTF-8 byte
+                out.text.append(line, i + 1, next - i - 1);
+            } else {
+                out.text.append(line, i, next - i);
+            }
+        }
+        col += w;
+        i = next;
+    }
+    out.bytes.push_back(static_cast<int>(line.size()));
+    out.cols.push_back(col);
+    out.text_off.push_back(static_cast<int>(out.text.size()));
+    out.width = col;
+}
+
+VisibleText visible_text(const std::string& line, const LineLayout& lay, int c0, int c1) {
+    VisibleText v;
+    c1 = std::min(c1, lay.width);
+    if (c0 >= c1) {
+        v.c0 = v.c1 = std::min(c0, lay.width);
+        return v;
+    }
+    if (lay.plain) {
+        v.c0 = c0;
+        v.c1 = c1;
+        v.text = std::string_view(line).substr(static_cast<size_t>(c0), static_cast<size_t>(c1 - c0));
+        return v;
+    }
+    // a wide glyph cut by an edge shows as spaces
+    while (c0 < c1 && lay.text_off[static_cast<size_t>(c0)] < 0) {
+        ++v.lead;
+        ++c0;
+    }
+    int e = c1;
+    while (e > c0 && lay.text_off[static_cast<size_t>(e)] < 0) --e;
+    v.trail = c1 - e;
+    v.c0 = c0;
+    v.c1 = e;
+    int b0 = lay.offset(c0);
+    v.text = std::string_view(lay.text).substr(static_cast<size_t>(b0), static_cast<size_t>(lay.offset(e) - b0));
+    return v;
+}
+
+LineLayout& LayoutCache::get_mut(const Buffer& buf, size_t row) {
+    uint64_t stamp = buf.line_stamp(row);
+    auto& lay = entries_[stamp];
+    if (lay.stamp != stamp) {
+        build_layout(buf.line(row), lay);
+        lay.stamp = stamp;
+    }
+    lay.last_used = frame_;
+    return lay;
+}
+
+void LayoutCache::trim() {
+    ++frame_;
+    if (entries_.size() <= MAX_CACHED_LINES) return;
+    // keep what the last frame drew, the rest is cheap to rebuild
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->second.last_used + 1 < frame_) it = entries_.erase(it);
+        else ++it;
+    }
+}
+
+} // namespace termite
@@ -0,0 +1,155 @@
+#include "termite/line_sort.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+
+namespace termite {
+
+namespace {
+// Entries per run below which another thread is not worth starting
+constexpr size_t MIN_RUN = size_t{1} << 15;
+
+struct Entry {
+    uint64_t prefix; // lexical: the first 8 key bytes after the part all keys share, big endian
+    std::string_view key;
+    double number;
+    size_t row;
+};
+
+bool is_blank(char c) { return c == ' ' || c == '\t'; }
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Key of a line: from the start of blank separated field `field` (1-based) to the end
+std::string_view key_of(const std::string& line, size_t field) {
+    std::string_view s(line);
+    if (field == 0) return s;
+    size_t i = 0;
+    for (size_t f = 1;; ++f) {
+        while (i < s.size() && is_blank(s[i])) ++i;
+        if (f == field || i == s.size()) break;
+        while (i < s.size() && !is_blank(s[i])) ++i;
+    }
+    return s.substr(i);
+}
+
+// Number a key starts with, like sort -n: a sign, digits and a fraction. Exponents, "inf" and
+// "nan" are not read (a NaN would break the ordering), a key without digits counts as 0.
+double number_of(std::string_view key) {
+    size_t i = 0;
+    while (i < key.size() && is_blank(key[i])) ++i;
+    bool minus = i < key.size() && key[i] == '-';
+    if (i < key.size() && (key[i] == '+' || key[i] == '-')) ++i;
+    size_t begin = i;
+    while (i < key.size() && is_digit(key[i])) ++i;
+    size_t digits = i - begin;
+    if (i < key.size() && key[i] == '.') {
+        size_t fraction = ++i;
+        while (i < key.size() && is_digit(key[i])) ++i;
+        digits += i - fraction;
+    }
+    if (digits == 0) return 0;
+    double v = 0;
+    std::from_chars(key.data() + begin, key.data() + i, v, std::chars_format::fixed);
+    return minus ? -v : v;
+}
+
+// Stable merge sort over all cores: sorted runs, then rounds of pairwise merges between two buffers
+template <class Less>
+void parallel_sort(std::vector<Entry>& v, Less less) {
+    size_t runs = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), v.size() / MIN_RUN);
+    if (runs <= 1) {
+        std::stable_sort(v.begin(), v.end(), less);
+        return;
+    }
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= runs; ++i) bounds.push_back(v.size() * i / runs);
+    auto spread = [](size_t n, auto&& fn) {
+        std::vector<std::thread> pool;
+        for (size_t i = 1; i < n; ++i) pool.emplace_back(fn, i);
+        fn(0);
+        for (auto& t : pool) t.join();
+    };
+    spread(runs, [&](size_t i) {
+        std::stable_sort(v.begin() + static_cast<std::ptrdiff_t>(bounds[i]), v.begin() + static_cast<std::ptrdiff_t>(bounds[i + 1]), less);
+    });
+    std::vector<Entry> other(v.size());
+    std::vector<Entry>* src = &v;
+    std::vector<Entry>* dst = &other;
+    while (bounds.size() > 2) {
+        size_t pairs = (bounds.size() - 1) / 2;
+        spread((bounds.size()) / 2, [&](size_t i) {
+            auto at = [&](size_t b) { return src->begin() + static_cast<std::ptrdiff_t>(bounds[b]); };
+            auto out = dst->begin() + static_cast<std::ptrdiff_t>(bounds[2 * i]);
+            if (i < pairs)
+                std::merge(at(2 * i), at(2 * i + 1), at(2 * i + 1), at(2 * i + 2), out, less); // stable: left run first
+            else
+                std::copy(at(2 * i), at(2 * i + 1), out); // odd one out
+        });
+        std::vector<size_t> next;
+        for (size_t i = 0; i < bounds.size(); i += 2) next.push_back(bounds[i]);
+        if (next.back() != bounds.back()) next.push_back(bounds.back());
+        bounds.swap(next);
+        std::swap(src, dst);
+    }
+    if (src != &v) v.swap(other);
+}
+}
+
+std::vector<size_t> sorted_rows(const Snapshot& snap, size_t first, size_t count, const SortSpec& spec) {
+    std::vector<Entry> entries;
+    entries.reserve(count);
+    size_t row = first;
+    snap.for_each_line(first, count, [&](const std::string& line) {
+        std::string_view key = key_of(line, spec.field);
+        entries.push_back({0, key, spec.numeric ? number_of(key) : 0.0, row++});
+    });
+    if (spec.numeric) {
+        parallel_sort(entries, [&](const Entry& a, const Entry& b) {
+            return spec.reverse ? b.number < a.number : a.number < b.number;
+        });
+    } else {
+        // most comparisons are settled by the integer prefix without touching the lines (keys like
+        // log lines tend to start alike, so it is taken after what they all have in common)
+        size_t common = entries.empty() ? 0 : entries[0].key.size();
+        for (const auto& e : entries) {
+            size_t n = std::min(common, e.key.size());
+            common = static_cast<size_t>(std::mismatch(e.key.begin(), e.key.begin() + static_cast<std::ptrdiff_t>(n), entries[0].key.begin()).first - e.key.begin());
+        }
+        for (auto& e : entries) {
+            for (size_t i = common; i < common + 8; ++i)
+                e.prefix = e.prefix << 8 | (i < e.key.size() ? static_cast<unsigned char>(e.key[i]) : 0);
+        }
+        auto less = [](const Entry& a, const Entry& b) { return a.prefix != b.prefix ? a.prefix < b.prefix : a.key < b.key; };
+        if (spec.reverse)
+            parallel_sort(entries, [&](const Entry& a, const Entry& b) { return less(b, a); });
+        else
+            parallel_sort(entries, less);
+    }
+    std::vector<size_t> rows;
+    rows.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (spec.unique && i > 0 &&
+            (spec.numeric ? entries[i].number == entries[i - 1].number : entries[i].key == entries[i - 1].key))
+            continue;
+        rows.push_back(entries[i].row);
+    }
+    return rows;
+}
+
+std::vector<size_t> unique_rows(const Snapshot& snap, size_t first, size_t count) {
+    std::unordered_set<std::string_view> seen;
+    seen.reserve(count);
+    std::vector<size_t> rows;
+    size_t row = first;
+    snap.for_each_line(first, count, [&](const std::string& line) {
+        if (seen.insert(line).second) rows.push_back(row);
+        ++row;
+    });
+    return rows;
+}
+
+} // namespace termite
@@ -0,0 +1,128 @@
+#include "termite/panes.hpp"
+
+#include <algorithm>
+
+namespace termite {
+
+PaneLayout::PaneLayout() : nodes_(1) {}
+
+int PaneLayout::find(size_t pane) const {
+    // walk from the root: nodes of closed panes wait in nodes_ for reuse
+    std::vector<int> todo{root_};
+    while (!todo.empty()) {
+        int n = todo.back();
+        todo.pop_back();
+        const Node& node = nodes_[static_cast<size_t>(n)];
+        if (node.leaf) {
+            if (node.pane == pane) return n;
+        } else {
+            todo.push_back(node.b);
+            todo.push_back(node.a);
+        }
+    }
+    return -1;
+}
+
+int PaneLayout::add(const Node& node) {
+    if (free_.empty()) {
+        nodes_.push_back(node);
+        return static_cast<int>(nodes_.size()) - 1;
+    }
+    int n = free_.back();
+    free_.pop_back();
+    nodes_[static_cast<size_t>(n)] = node;
+    return n;
+}
+
+size_t PaneLayout::split(size_t pane, bool vertical) {
+    int n = find(pane);
+    if (n < 0) return pane;
+    size_t added = count_++;
+    int a = add({true, pane, false, -1, -1, n});
+    int b = add({true, added, false, -1, -1, n});
+    Node& split = nodes_[static_cast<size_t>(n)];
+    split.leaf = false;
+    split.vertical = vertical;
+    split.a = a;
+    split.b = b;
+    placed_valid_ = false;
+    return added;
+}
+
+void PaneLayout::close(size_t pane) {
+    int n = find(pane);
+    if (n < 0 || count_ == 1) return;
+    int p = nodes_[static_cast<size_t>(n)].parent;
+    const Node& parent = nodes_[static_cast<size_t>(p)];
+    int sibling = parent.a == n ? parent.b : parent.a;
+    // the sibling takes the place of the split
+    Node moved = nodes_[static_cast<size_t>(sibling)];
+    moved.parent = parent.parent;
+    nodes_[static_cast<size_t>(p)] = moved;
+    if (!moved.leaf) {
+        nodes_[static_cast<size_t>(moved.a)].parent = p;
+        nodes_[static_cast<size_t>(moved.b)].parent = p;
+    }
+    free_.push_back(n);
+    free_.push_back(sibling);
+    for (auto& node : nodes_)
+        if (node.leaf && node.pane > pane) --node.pane;
+    --count_;
+    placed_valid_ = false;
+}
+
+const std::vector<PaneLayout::Placed>& PaneLayout::placed(const PaneRect& area) const {
+    if (!placed_valid_ || !(placed_area_ == area)) {
+        placed_.clear();
+        dividers_.clear();
+        place(root_, area, placed_, &dividers_);
+        placed_area_ = area;
+        placed_valid_ = true;
+    }
+    return placed_;
+}
+
+void PaneLayout::place(int node, const PaneRect& area, std::vector<Placed>& panes,
+                       std::vector<PaneRect>* dividers) const {
+    const Node& n = nodes_[static_cast<size_t>(node)];
+    if (n.leaf) {
+        panes.push_back({n.pane, area});
+        return;
+    }
+    PaneRect a = area, b = area;
+    if (n.vertical) {
+        // left | right with a divider column in between
+        a.cols = std::max(0, (area.cols - 1) / 2);
+        b.left = area.left + a.cols + 1;
+        b.cols = std::max(0, area.cols - a.cols - 1);
+        if (dividers) dividers->push_back({area.top, area.left + a.cols, area.rows, 1});
+    } else {
+        a.rows = area.rows / 2;
+        b.top = area.top + a.rows;
+        b.rows = area.rows - a.rows;
+    }
+    place(n.a, a, panes, dividers);
+    place(n.b, b, panes, dividers);
+}
+
+void PaneLayout::place(const PaneRect& area, std::vector<Placed>& panes, std::vector<PaneRect>& dividers) const {
+    // copies: the caller keeps its lists while looking up rectangles, which may place again
+    panes = placed(area);
+    dividers = dividers_;
+}
+
+PaneRect PaneLayout::rect_of(size_t pane, const PaneRect& area) const {
+    for (const auto& p : placed(area))
+        if (p.pane == pane) return p.rect;
+    return area;
+}
+
+size_t PaneLayout::next(size_t pane) const {
+    // the order does not depend on the area: any placement will do
+    const auto& panes = placed(placed_valid_ ? placed_area_ : PaneRect{});
+    for (size_t i = 0; i < panes.size(); ++i)
+        if (panes[i].pane == pane) return panes[(i + 1) % panes.size()].pane;
+    return pane;
+}
+
+} // namespace termite
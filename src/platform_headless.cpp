@@ -0,0 +1,51 @@
+// platform layer of the headless build: the terminal is a headless::Terminal in memory
+
+#include "termite/platform.hpp"
+#include "termite/headless.hpp"
+
+namespace termite::platform
+{
+
+    bool init()
+    {
+        return headless::attached() != nullptr;
+    }
+
+    void shutdown()
+    {
+    }
+
+    int read_key()
+    {
+        auto* term = headless::attached();
+        return term ? term->read_byte() : -1;
+    }
+
+    bool input_pending(int timeout_ms)
+    {
+        // scripted input never arrives later, so there is nothing to wait for
+        (void)timeout_ms;
+        auto* term = headless::attached();
+        return term && term->input_pending();
+    }
+
+    void write_output(const char* data, size_t n)
+    {
+        if (auto* term = headless::attached())
+            term->feed(std::string_view(data, n));
+    }
+
+    std::optional<WinSize> window_size()
+    {
+        auto* term = headless::attached();
+        if (!term)
+            return std::nullopt;
+        return WinSize{.rows = term->rows(), .cols = term->cols()};
+    }
+
+    bool query_private_mode(int mode)
+    {
+        return mode == 2026; // the emulator counts synchronized updates
+    }
+
+} // namespace termite::platform
@@ -4,10 +4,13 @@
 
 #include <termios.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <chrono>
 #include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <string>
 
 namespace termite::platform
 {
@@ -24,6 +27,9 @@ namespace termite::platform
         {
             if (raw)
             {
+                // leave the alternate screen entered by init()
+                std::printf("\033[?1049l");
+                std::fflush(stdout);
                 tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig);
                 raw = false;
             }
@@ -34,6 +40,20 @@ namespace termite::platform
             restore();
             ::_exit(130);
         }
+
+        // Primary device attributes reply: ESC [ ? <params> c
+        bool has_da1_reply(const std::string& s)
+        {
+            for (size_t p = s.find("\x1b[?"); p != std::string::npos; p = s.find("\x1b[?", p + 1))
+            {
+                size_t i = p + 3;
+                while (i < s.size() && ((s[i] >= '0' && s[i] <= '9') || s[i] == ';'))
+                    ++i;
+                if (i < s.size() && s[i] == 'c')
+                    return true;
+            }
+            return false;
+        }
     }
 
     bool init()
@@ -81,6 +101,53 @@ namespace termite::platform
         return static_cast<int>(c);
     }
 
+    bool query_private_mode(int mode)
+    {
+        if (!raw)
+            return false;
+        // DECRQM followed by DA1: every terminal answers DA1, so we know when to stop waiting
+        std::string query = "\x1b[?" + std::to_string(mode) + "$p\x1b[c";
+        if (::write(STDOUT_FILENO, query.data(), query.size()) != (ssize_t)query.size())
+            return false;
+
+        std::string reply;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+        while (!has_da1_reply(reply))
+        {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0)
+                break;
+            pollfd pfd{STDIN_FILENO, POLLIN, 0};
+            if (::poll(&pfd, 1, (int)left.count()) <= 0)
+                break;
+            char buf[64];
+            ssize_t n = ::read(STDIN_FILENO, buf, sizeof(buf));
+            if (n <= 0)
+                break;
+            reply.append(buf, (size_t)n);
+        }
+
+        // ESC [ ? <mode> ; <state> $ y   with state 1 = set, 2 = reset, 0 / 4 = unknown / permanent
+        std::string prefix = "\x1b[?" + std::to_string(mode) + ";";
+        size_t p = reply.find(prefix);
+        if (p == std::string::npos || p + prefix.size() >= reply.size())
+            return false;
+        char state = reply[p + prefix.size()];
+        return state == '1' || state == '2';
+    }
+
+    bool input_pending(int timeout_ms)
+    {
+        pollfd pfd{STDIN_FILENO, POLLIN, 0};
+        return ::poll(&pfd, 1, timeout_ms) > 0;
+    }
+
+    void write_output(const char* data, size_t n)
+    {
+        std::fwrite(data, 1, n, stdout);
+        std::fflush(stdout);
+    }
+
     std::optional<WinSize> window_size()
     {
         winsize ws{};
@@ -5,6 +5,8 @@
 
 #include <windows.h>
 
+#include <cstdio>
+
 namespace termite::platform {
 
 static DWORD orig_mode = 0;
@@ -40,6 +42,17 @@ int read_key() {
     return -1;
 }
 
+bool input_pending(int timeout_ms) {
+    HANDLE hIn = GetStdHandle(STD_INPUT_HANDLE);
+    DWORD wait = timeout_ms < 0 ? INFINITE : static_cast<DWORD>(timeout_ms);
+    return WaitForSingleObject(hIn, wait) == WAIT_OBJECT_0;
+}
+
+void write_output(const char* data, size_t n) {
+    std::fwrite(data, 1, n, stdout);
+    std::fflush(stdout);
+}
+
 std::optional<WinSize> window_size() {
     CONSOLE_SCREEN_BUFFER_INFO info{};
     HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
@@ -49,6 +62,12 @@ std::optional<WinSize> window_size() {
     return WinSize{.rows = rows, .cols = cols};
 }
 
+bool query_private_mode(int mode) {
+    // console replies arrive as key events, not worth parsing here
+    (void)mode;
+    return false;
+}
+
 } // namespace termite::platform
 
 #endif // _WIN32
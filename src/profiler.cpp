@@ -0,0 +1,166 @@
+#include "termite/profiler.hpp"
+
+#ifdef TERMITE_PROFILER
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h> // _aligned_malloc
+#endif
+
+namespace termite::profiler {
+
+namespace {
+
+struct FrameStats {
+    std::array<std::chrono::steady_clock::duration, static_cast<size_t>(Phase::Count)> phases{};
+    size_t bytes {0};
+    uint64_t allocs {0};
+};
+
+constexpr const char* PHASE_NAMES[] = {"scroll", "highlight", "compose", "flush"};
+
+std::atomic<bool> g_enabled {false};
+std::atomic<uint64_t> g_allocs {0};
+
+FrameStats g_current;
+FrameStats g_last;
+uint64_t g_allocs_at_frame_start {0};
+
+} // namespace
+
+bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+void set_enabled(bool on) {
+    g_current = FrameStats{};
+    g_last = FrameStats{};
+    g_allocs_at_frame_start = g_allocs.load(std::memory_order_relaxed);
+    g_enabled.store(on, std::memory_order_relaxed);
+}
+
+void add_time(Phase phase, std::chrono::steady_clock::duration d) {
+    g_current.phases[static_cast<size_t>(phase)] += d;
+}
+
+void add_bytes(size_t n) {
+    if (enabled()) g_current.bytes += n;
+}
+
+void end_frame() {
+    if (!enabled()) return;
+    uint64_t allocs = g_allocs.load(std::memory_order_relaxed);
+    g_current.allocs = allocs - g_allocs_at_frame_start;
+    g_allocs_at_frame_start = allocs;
+    g_last = g_current;
+    g_current = FrameStats{};
+}
+
+std::vector<std::string> overlay_lines() {
+    std::vector<std::string> lines;
+    char buf[64];
+    lines.emplace_back(" profiler (last frame) ");
+    for (size_t i = 0; i < static_cast<size_t>(Phase::Count); ++i) {
+        double ms = std::chrono::duration<double, std::milli>(g_last.phases[i]).count();
+        std::snprintf(buf, sizeof(buf), " %-10s %9.3f ms ", PHASE_NAMES[i], ms);
+        lines.emplace_back(buf);
+    }
+    std::snprintf(buf, sizeof(buf), " %-10s %9zu B  ", "bytes", g_last.bytes);
+    lines.emplace_back(buf);
+    std::snprintf(buf, sizeof(buf), " %-10s %9llu    ", "allocs", static_cast<unsigned long long>(g_last.allocs));
+    lines.emplace_back(buf);
+    return lines;
+}
+
+} // namespace termite::profiler
+
+// Count heap allocations while the overlay is shown. Every replaceable form is replaced: a form
+// left to the library would pair its own allocation with these deallocations (or the other way
+// round), which is undefined and which ASan reports as alloc-dealloc-mismatch.
+namespace {
+
+void* counted(std::size_t n) {
+    if (termite::profiler::enabled())
+        termite::profiler::g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(n ? n : 1);
+}
+
+void* counted(std::size_t n, std::align_val_t al) {
+    if (termite::profiler::enabled())
+        termite::profiler::g_allocs.fetch_add(1, std::memory_order_relaxed);
+    auto align = static_cast<std::size_t>(al);
+    std::size_t size = (n ? n : 1) + align - 1;
+    size -= size % align; // aligned_alloc wants a multiple of the alignment
+#ifdef _WIN32
+    return _aligned_malloc(size, align);
+#else
+    return std::aligned_alloc(align, size);
+#endif
+}
+
+void release(void* p, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+} // namespace
+
+void* operator new(std::size_t n) {
+    if (void* p = counted(n)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n) {
+    if (void* p = counted(n)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept { return counted(n); }
+
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return counted(n); }
+
+void* operator new(std::size_t n, std::align_val_t al) {
+    if (void* p = counted(n, al)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n, std::align_val_t al) {
+    if (void* p = counted(n, al)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t n, std::align_val_t al, const std::nothrow_t&) noexcept { return counted(n, al); }
+
+void* operator new[](std::size_t n, std::align_val_t al, const std::nothrow_t&) noexcept { return counted(n, al); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete[](void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+void operator delete(void* p, std::align_val_t al) noexcept { release(p, al); }
+
+void operator delete[](void* p, std::align_val_t al) noexcept { release(p, al); }
+
+void operator delete(void* p, std::size_t, std::align_val_t al) noexcept { release(p, al); }
+
+void operator delete[](void* p, std::size_t, std::align_val_t al) noexcept { release(p, al); }
+
+void operator delete(void* p, std::align_val_t al, const std::nothrow_t&) noexcept { release(p, al); }
+
+void operator delete[](void* p, std::align_val_t al, const std::nothrow_t&) noexcept { release(p, al); }
+
+#endif // TERMITE_PROFILER
@@ -3,12 +3,16 @@
 #include "termite/ansi.hpp"
 #include "termite/platform.hpp"
 #include "termite/debug.hpp"
+#include "termite/profiler.hpp"
+#include "termite/unicode.hpp"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 
 namespace termite
 {
-    Screen::Screen()
+    Screen::Screen() : target_(&out_)
     {
     }
 
@@ -18,39 +22,177 @@ namespace termite
 
     void Screen::clear()
     {
-        std::fwrite(ansi::HIDE_CURSOR, 1, 6, stdout);
-        std::fwrite(ansi::CLEAR_SCREEN, 1, 4, stdout);
-        auto home = ansi::cursor_pos(1, 1);
-        std::fwrite(home.c_str(), 1, home.size(), stdout);
+        open_sync();
+        out_ += ansi::HIDE_CURSOR;
+        out_ += ansi::CLEAR_SCREEN;
+        out_ += ansi::cursor_pos(1, 1);
+        std::fill(prev_valid_.begin(), prev_valid_.end(), false);
+    }
+
+    void Screen::begin_frame()
+    {
+        open_sync();
+        Size sz = size();
+        if (prev_.empty() || sz.rows != frame_size_.rows || sz.cols != frame_size_.cols)
+        {
+            // resized: nothing on the terminal can be trusted anymore
+            frame_size_ = sz;
+            // 1-based rows, index 0 swallows writes to rows that are off screen
+            prev_.assign(sz.rows + 1, std::string());
+            prev_valid_.assign(sz.rows + 1, false);
+            next_.assign(sz.rows + 1, std::string());
+            next_set_.assign(sz.rows + 1, false);
+            out_ += ansi::CLEAR_SCREEN;
+        }
+        out_ += ansi::HIDE_CURSOR;
+        in_frame_ = true;
+        target_ = &out_;
+    }
+
+    void Screen::begin_row(int row)
+    {
+        if (!in_frame_) return;
+        if (row < 1 || row > frame_size_.rows) row = 0;
+        next_[row].clear();
+        next_set_[row] = true;
+        target_ = &next_[row];
+    }
+
+    void Screen::begin_segment(int row, int col)
+    {
+        if (!in_frame_) return;
+        if (row < 1 || row > frame_size_.rows) row = 0;
+        if (!next_set_[row])
+        {
+            next_[row].clear();
+            next_set_[row] = true;
+        }
+        target_ = &next_[row];
+        *target_ += ansi::RESET;
+        *target_ += ansi::cursor_pos(row, col);
+    }
+
+    void Screen::scroll_rows(int top, int bottom, int n)
+    {
+        if (!in_frame_) return;
+        top = std::max(top, 1);
+        bottom = std::min(bottom, frame_size_.rows);
+        int height = bottom - top + 1;
+        if (n == 0 || height <= 1 || std::abs(n) >= height) return;
+        // let the terminal move the rows, exposed rows get blanked with the default background
+        out_ += ansi::RESET;
+        out_ += ansi::scroll_region(top, bottom);
+        out_ += n > 0 ? ansi::scroll_up(n) : ansi::scroll_down(-n);
+        out_ += ansi::RESET_SCROLL_REGION;
+        // and move our copy of the last frame the same way
+        if (n > 0)
+        {
+            for (int r = top; r + n <= bottom; ++r)
+            {
+                std::swap(prev_[r], prev_[r + n]);
+                prev_valid_[r] = prev_valid_[r + n];
+            }
+            for (int r = bottom - n + 1; r <= bottom; ++r) prev_valid_[r] = false;
+        }
+        else
+        {
+            for (int r = bottom; r + n >= top; --r)
+            {
+                std::swap(prev_[r], prev_[r + n]);
+                prev_valid_[r] = prev_valid_[r + n];
+            }
+            for (int r = top; r < top - n; ++r) prev_valid_[r] = false;
+        }
+    }
+
+    void Screen::end_frame()
+    {
+        if (!in_frame_) return;
+        target_ = &out_;
+        for (int r = 1; r <= frame_size_.rows; ++r)
+        {
+            if (!next_set_[r]) continue;
+            next_set_[r] = false;
+            if (prev_valid_[r] && prev_[r] == next_[r]) continue;
+            out_ += ansi::cursor_pos(r, 1);
+            out_ += ansi::RESET;
+            out_ += ansi::CLEAR_LINE;
+            out_ += next_[r];
+            out_ += ansi::RESET;
+            std::swap(prev_[r], next_[r]);
+            prev_valid_[r] = true;
+        }
+        // overlays are painted on top every frame, the rows below them need a repaint next time
+        out_ += overlay_;
+        for (int r : overlay_rows_) invalidate_row(r);
+        overlay_.clear();
+        overlay_rows_.clear();
+        in_frame_ = false;
+    }
+
+    void Screen::open_sync()
+    {
+        if (!sync_output_ || sync_open_) return;
+        out_.insert(0, ansi::BEGIN_SYNC);
+        sync_open_ = true;
+    }
+
+    void Screen::invalidate_row(int row)
+    {
+        if (row >= 1 && row < (int)prev_valid_.size()) prev_valid_[row] = false;
     }
 
     void Screen::move_cursor(int row, int col)
     {
-        auto seq = ansi::cursor_pos(row, col);
         //low level terminal output
-        std::fwrite(seq.c_str(), 1, seq.size(), stdout);
+        *target_ += ansi::cursor_pos(row, col);
     }
 
-    void Screen::write(const std::string& s)
+    void Screen::write(std::string_view s)
     {
-        std::fwrite(s.c_str(), 1, s.size(), stdout);
+        target_->append(s);
     }
 
     void Screen::flush()
     {
-        std::fwrite(ansi::SHOW_CURSOR, 1, 6, stdout);
-        std::fflush(stdout);
+        out_ += ansi::SHOW_CURSOR;
+        if (sync_open_)
+        {
+            out_ += ansi::END_SYNC;
+            sync_open_ = false;
+        }
+        profiler::add_bytes(out_.size());
+        platform::write_output(out_.data(), out_.size());
+        out_.clear();
     }
 
     void Screen::draw_status(const std::string& status)
     {
-        auto szOpt = platform::window_size();
-        int rows = szOpt ? szOpt->rows : 24;
-        int cols = szOpt ? szOpt->cols : 80;
-        (void)cols;
-        move_cursor(rows, 1);
+        int rows = size().rows;
+        if (in_frame_)
+        {
+            begin_row(rows);
+        }
+        else
+        {
+            // drawn outside a frame (prompts): clear the row and repaint it with the next frame
+            target_ = &out_;
+            move_cursor(rows, 1);
+            write(ansi::CLEAR_LINE);
+            invalidate_row(rows);
+        }
         write(ansi::color256(245));
-        write(status);
+        // never run past the last column: on the bottom row the terminal would scroll
+        int cols = size().cols;
+        size_t end = 0;
+        for (int w = 0; end < status.size();)
+        {
+            size_t next = unicode::next_grapheme(status, end);
+            w += unicode::grapheme_width(status, end, next);
+            if (w > cols) break;
+            end = next;
+        }
+        write(std::string_view(status).substr(0, end));
         write(ansi::RESET);
     }
 
@@ -86,19 +228,70 @@ namespace termite
         if (lines.empty()) return;
         int startRow = 2;
 
-        std::size_t  col_index = platform::window_size()->cols - get_size_of_biggest_debug_line(lines);
+        int cols = size().cols;
+        int widest = (int)get_size_of_biggest_debug_line(lines);
+        int col_index = std::max(1, cols - widest);
+        if (in_frame_) target_ = &overlay_;
         for (size_t i = 0; i < lines.size(); ++i)
         {
+            if (in_frame_) overlay_rows_.push_back(startRow + (int)i);
             move_cursor(startRow + i, col_index); //coll must be max width - size of biggest debug line;
             write(ansi::bg_color256(52)); //dark red background
             write(ansi::color256(231)); //white text
             write(lines[i]);
             write(ansi::RESET);
         }
+        target_ = &out_;
+    }
+
+    void Screen::draw_popup(int row, int col, const std::vector<std::string>& items, int selected)
+    {
+        Size sz = size();
+        // as wide as the widest item (cut at the right edge), one space on both sides
+        int width = 0;
+        for (const auto& item : items)
+        {
+            int w = 0;
+            for (size_t i = 0; i < item.size();)
+            {
+                size_t next = unicode::next_grapheme(item, i);
+                w += unicode::grapheme_width(item, i, next);
+                i = next;
+            }
+            width = std::max(width, w);
+        }
+        width = std::min(width + 2, sz.cols - col + 1);
+        if (items.empty() || width < 3)
+            return;
+        if (in_frame_) target_ = &overlay_;
+        for (size_t i = 0; i < items.size() && row + (int)i <= sz.rows; ++i)
+        {
+            if (in_frame_) overlay_rows_.push_back(row + (int)i);
+            move_cursor(row + (int)i, col);
+            write((int)i == selected ? ansi::bg_color256(25) : ansi::bg_color256(237));
+            write(ansi::color256(231));
+            // cut at a grapheme that still fits, pad the rest
+            const std::string& item = items[i];
+            size_t end = 0;
+            int w = 0;
+            while (end < item.size())
+            {
+                size_t next = unicode::next_grapheme(item, end);
+                int gw = unicode::grapheme_width(item, end, next);
+                if (w + gw > width - 2) break;
+                w += gw;
+                end = next;
+            }
+            write(" ");
+            write(std::string_view(item).substr(0, end));
+            write(std::string((size_t)(width - 1 - w), ' '));
+            write(ansi::RESET);
+        }
+        target_ = &out_;
     }
 
     void Screen::write_with_syntax_highlighting(const std::vector<SyntaxHighlight>& highlights,
-                                            const std::string& text)
+                                            std::string_view text)
     {
         // std::fwrite(s.c_str(), 1, s.size(), stdout);
         //print highlights
@@ -113,7 +306,6 @@ namespace termite
 
         for (const auto& highlight : highlights)
         {
-            add_debug_line("H: " + std::to_string(static_cast<int>(highlight.type)) + " [" + std::to_string(highlight.start) + ", " + std::to_string(highlight.end) + "]");
             if (highlight.type == SyntaxHighlight::Type::Normal)
             {
                 write(text.substr(highlight.start, highlight.end - highlight.start));
@@ -155,6 +347,12 @@ namespace termite
 
     }
 
+    bool Screen::resized() const
+    {
+        Size sz = size();
+        return sz.rows != frame_size_.rows || sz.cols != frame_size_.cols;
+    }
+
     Size Screen::size() const
     {
         auto szOpt = platform::window_size();
@@ -33,4 +33,69 @@ namespace termite
         return highlights;
     }
 
-}
\ No newline at end of file
+    LexState lex_line(const std::string& line, LexState in, std::vector<BracketToken>* brackets,
+                      std::vector<WordToken>* words)
+    {
+        size_t n = line.size();
+        size_t i = 0;
+        LexState state = in;
+        while (i < n)
+        {
+            if (state == LexState::BlockComment)
+            {
+                size_t end = line.find("*/", i);
+                if (end == std::string::npos)
+                    return state;
+                i = end + 2;
+                state = LexState::Code;
+                continue;
+            }
+            char c = line[i];
+            switch (c)
+            {
+            case '/':
+                if (i + 1 < n && line[i + 1] == '/')
+                    return state; // the rest is a line comment
+                if (i + 1 < n && line[i + 1] == '*')
+                {
+                    state = LexState::BlockComment;
+                    i += 2;
+                    continue;
+                }
+                break;
+            case '"':
+            case '\'':
+                // up to the closing quote, or the end of the line if it is missing
+                ++i;
+                while (i < n && line[i] != c)
+                    i += line[i] == '\\' ? 2 : 1;
+                break;
+            case '(':
+            case ')':
+            case '[':
+            case ']':
+            case '{':
+            case '}':
+                if (brackets)
+                    brackets->push_back({(int)i, c});
+                break;
+            default:
+                if (words && is_word_byte(c))
+                {
+                    // a whole run, so "0x1f" does not turn into the word "x1f"
+                    size_t end = i + 1;
+                    while (end < n && is_word_byte(line[end]))
+                        ++end;
+                    if (c < '0' || c > '9')
+                        words->push_back({(int)i, (int)(end - i)});
+                    i = end;
+                    continue;
+                }
+                break;
+            }
+            ++i;
+        }
+        return state;
+    }
+
+}
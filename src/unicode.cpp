@@ -0,0 +1,220 @@
+#include "termite/unicode.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TERMITE_SSE2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define TERMITE_NEON 1
+#endif
+
+namespace termite::unicode {
+
+namespace {
+
+struct Range { char32_t lo, hi; };
+
+// Combining marks, zero width spaces/joiners, variation selectors, emoji skin tones, tags.
+constexpr Range ZERO_WIDTH[] = {
+    {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x05BF, 0x05BF}, {0x05C1, 0x05C2},
+    {0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0610, 0x061A}, {0x064B, 0x065F}, {0x0670, 0x0670},
+    {0x06D6, 0x06DC}, {0x06DF, 0x06E4}, {0x06E7, 0x06E8}, {0x06EA, 0x06ED}, {0x0711, 0x0711},
+    {0x0730, 0x074A}, {0x07A6, 0x07B0}, {0x0900, 0x0902}, {0x093A, 0x093A}, {0x093C, 0x093C},
+    {0x0941, 0x0948}, {0x094D, 0x094D}, {0x0951, 0x0957}, {0x0E31, 0x0E31}, {0x0E34, 0x0E3A},
+    {0x0E47, 0x0E4E}, {0x1AB0, 0x1AFF}, {0x1DC0, 0x1DFF}, {0x200B, 0x200F}, {0x202A, 0x202E},
+    {0x2060, 0x2064}, {0x20D0, 0x20FF}, {0x302A, 0x302D}, {0x3099, 0x309A}, {0xFE00, 0xFE0F},
+    {0xFE20, 0xFE2F}, {0xFEFF, 0xFEFF}, {0x1F3FB, 0x1F3FF}, {0xE0000, 0xE0FFF},
+};
+
+// East Asian wide / fullwidth and emoji presentation code points.
+constexpr Range WIDE[] = {
+    {0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC}, {0x23F0, 0x23F0},
+    {0x23F3, 0x23F3}, {0x25FD, 0x25FE}, {0x2614, 0x2615}, {0x2648, 0x2653}, {0x267F, 0x267F},
+    {0x2693, 0x2693}, {0x26A1, 0x26A1}, {0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5},
+    {0x26CE, 0x26CE}, {0x26D4, 0x26D4}, {0x26EA, 0x26EA}, {0x26F2, 0x26F3}, {0x26F5, 0x26F5},
+    {0x26FA, 0x26FA}, {0x26FD, 0x26FD}, {0x2705, 0x2705}, {0x270A, 0x270B}, {0x2728, 0x2728},
+    {0x274C, 0x274C}, {0x274E, 0x274E}, {0x2753, 0x2755}, {0x2757, 0x2757}, {0x2795, 0x2797},
+    {0x27B0, 0x27B0}, {0x27BF, 0x27BF}, {0x2B1B, 0x2B1C}, {0x2B50, 0x2B50}, {0x2B55, 0x2B55},
+    {0x2E80, 0x303E}, {0x3041, 0x33FF}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF}, {0xA000, 0xA4CF},
+    {0xA960, 0xA97F}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF}, {0xFE10, 0xFE19}, {0xFE30, 0xFE6F},
+    {0xFF00, 0xFF60}, {0xFFE0, 0xFFE6}, {0x16FE0, 0x16FE4}, {0x17000, 0x18AFF}, {0x1B000, 0x1B2FF},
+    {0x1F004, 0x1F004}, {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A}, {0x1F200, 0x1F202},
+    {0x1F210, 0x1F23B}, {0x1F240, 0x1F248}, {0x1F250, 0x1F251}, {0x1F260, 0x1F265}, {0x1F300, 0x1F320},
+    {0x1F32D, 0x1F335}, {0x1F337, 0x1F37C}, {0x1F37E, 0x1F393}, {0x1F3A0, 0x1F3CA}, {0x1F3CF, 0x1F3D3},
+    {0x1F3E0, 0x1F3F0}, {0x1F3F4, 0x1F3F4}, {0x1F3F8, 0x1F43E}, {0x1F440, 0x1F440}, {0x1F442, 0x1F4FC},
+    {0x1F4FF, 0x1F53D}, {0x1F54B, 0x1F54E}, {0x1F550, 0x1F567}, {0x1F57A, 0x1F57A}, {0x1F595, 0x1F596},
+    {0x1F5A4, 0x1F5A4}, {0x1F5FB, 0x1F64F}, {0x1F680, 0x1F6C5}, {0x1F6CC, 0x1F6CC}, {0x1F6D0, 0x1F6D2},
+    {0x1F6D5, 0x1F6D7}, {0x1F6EB, 0x1F6EC}, {0x1F6F4, 0x1F6FC}, {0x1F7E0, 0x1F7EB}, {0x1F90C, 0x1F93A},
+    {0x1F93C, 0x1F945}, {0x1F947, 0x1F9FF}, {0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD},
+};
+
+template <size_t N>
+bool in_table(const Range (&table)[N], char32_t cp) {
+    auto it = std::upper_bound(std::begin(table), std::end(table), cp,
+                               [](char32_t c, const Range& r) { return c < r.lo; });
+    return it != std::begin(table) && cp <= (it - 1)->hi;
+}
+
+int lookup_width(char32_t cp) {
+    if (in_table(ZERO_WIDTH, cp)) return 0;
+    if (in_table(WIDE, cp)) return 2;
+    return 1;
+}
+
+// Widths of the whole BMP, filled once on first use (64 KiB) so the common case is one load.
+const std::array<uint8_t, 0x10000>& bmp_widths() {
+    static const auto table = [] {
+        std::array<uint8_t, 0x10000> t{};
+        for (char32_t cp = 0; cp < 0x10000; ++cp) t[cp] = static_cast<uint8_t>(lookup_width(cp));
+        return t;
+    }();
+    return table;
+}
+
+constexpr char32_t ZWJ = 0x200D;
+
+bool is_regional_indicator(char32_t cp) { return cp >= 0x1F1E6 && cp <= 0x1F1FF; }
+
+// Code points that attach to the preceding base instead of starting a new cluster.
+bool is_extender(char32_t cp) { return cp >= 0x300 && char_width(cp) == 0; }
+
+size_t prev_code_point(const std::string& s, size_t i) {
+    if (i == 0) return 0;
+    size_t j = i - 1;
+    // step over at most 3 continuation bytes
+    while (j > 0 && i - j < 4 && (static_cast<unsigned char>(s[j]) & 0xC0) == 0x80) --j;
+    size_t len;
+    decode(s, j, len);
+    return j + len == i ? j : i - 1;
+}
+
+} // namespace
+
+bool is_plain_ascii(const char* p, size_t n) {
+    size_t i = 0;
+#if defined(TERMITE_SSE2)
+    // signed compare: bytes >= 0x80 are negative, so "< 0x20" catches controls and UTF-8 at once
+    const __m128i lo = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i bad = _mm_or_si128(_mm_cmplt_epi8(v, lo), _mm_cmpeq_epi8(v, del));
+        if (_mm_movemask_epi8(bad) != 0) return false;
+    }
+#elif defined(TERMITE_NEON)
+    const uint8x16_t lo = vdupq_n_u8(0x20);
+    const uint8x16_t hi = vdupq_n_u8(0x7f);
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p + i));
+        uint8x16_t bad = vorrq_u8(vcltq_u8(v, lo), vcgeq_u8(v, hi));
+        if (vmaxvq_u8(bad) != 0) return false;
+    }
+#endif
+    for (; i < n; ++i) {
+        auto c = static_cast<unsigned char>(p[i]);
+        if (c < 0x20 || c >= 0x7f) return false;
+    }
+    return true;
+}
+
+char32_t decode(const std::string& s, size_t i, size_t& len) {
+    auto b0 = static_cast<unsigned char>(s[i]);
+    len = 1;
+    if (b0 < 0x80) return b0;
+    int n;
+    char32_t cp;
+    if ((b0 & 0xE0) == 0xC0) { n = 2; cp = b0 & 0x1F; }
+    else if ((b0 & 0xF0) == 0xE0) { n = 3; cp = b0 & 0x0F; }
+    else if ((b0 & 0xF8) == 0xF0) { n = 4; cp = b0 & 0x07; }
+    else return 0xFFFD;
+    if (i + static_cast<size_t>(n) > s.size()) return 0xFFFD;
+    for (int k = 1; k < n; ++k) {
+        auto b = static_cast<unsigned char>(s[i + static_cast<size_t>(k)]);
+        if ((b & 0xC0) != 0x80) return 0xFFFD;
+        cp = (cp << 6) | (b & 0x3F);
+    }
+    // reject overlong forms, surrogates and out of range values
+    if ((n == 2 && cp < 0x80) || (n == 3 && cp < 0x800) || (n == 4 && cp < 0x10000) ||
+        (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+        return 0xFFFD;
+    len = static_cast<size_t>(n);
+    return cp;
+}
+
+int char_width(char32_t cp) {
+    if (cp < 0x300) return 1;
+    if (cp < 0x10000) return bmp_widths()[cp];
+    return lookup_width(cp);
+}
+
+size_t next_grapheme(const std::string& s, size_t i) {
+    if (i >= s.size()) return s.size();
+    size_t len;
+    char32_t base = decode(s, i, len);
+    i += len;
+    bool ri_pair_open = is_regional_indicator(base);
+    while (i < s.size()) {
+        char32_t cp = decode(s, i, len);
+        if (cp == ZWJ) {
+            // ZWJ glues the next code point (emoji sequences)
+            i += len;
+            if (i < s.size()) { decode(s, i, len); i += len; }
+            continue;
+        }
+        if (ri_pair_open && is_regional_indicator(cp)) {
+            ri_pair_open = false;
+            i += len;
+            continue;
+        }
+        if (!is_extender(cp)) break;
+        i += len;
+    }
+    return i;
+}
+
+size_t prev_grapheme(const std::string& s, size_t i) {
+    if (i > s.size()) i = s.size();
+    if (i == 0) return 0;
+    size_t len;
+    size_t j = prev_code_point(s, i);
+    while (j > 0) {
+        char32_t cp = decode(s, j, len);
+        size_t k = prev_code_point(s, j);
+        char32_t before = decode(s, k, len);
+        if (is_extender(cp) || before == ZWJ) { j = k; continue; }
+        if (is_regional_indicator(cp) && is_regional_indicator(before)) {
+            // flags pair up from the start of the run
+            size_t run = 1, p = k;
+            while (p > 0) {
+                size_t q = prev_code_point(s, p);
+                if (!is_regional_indicator(decode(s, q, len))) break;
+                ++run;
+                p = q;
+            }
+            if (run % 2 == 1) j = k;
+        }
+        break;
+    }
+    return j;
+}
+
+int grapheme_width(const std::string& s, size_t begin, size_t end) {
+    if (begin >= end) return 0;
+    size_t len;
+    char32_t base = decode(s, begin, len);
+    if (is_regional_indicator(base)) return begin + len < end ? 2 : 1;
+    int w = char_width(base);
+    // emoji presentation selector turns a narrow symbol into a wide one
+    if (w == 1 && base >= 0x2000) {
+        for (size_t i = begin + len; i < end; i += len)
+            if (decode(s, i, len) == 0xFE0F) return 2;
+    }
+    return w == 0 ? 1 : w;
+}
+
+} // namespace termite::unicode
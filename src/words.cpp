@@ -0,0 +1,52 @@
+#include "termite/words.hpp"
+
+#include "termite/buffer.hpp"
+
+namespace termite {
+
+LexState WordIndex::lex(Line& l, const std::string& line, LexState in) {
+    scratch_.clear();
+    LexState out = lex_line(line, in, nullptr, &scratch_);
+    l.words.reserve(scratch_.size());
+    for (const auto& t : scratch_) {
+        if (static_cast<size_t>(t.len) < MIN_LENGTH) continue;
+        std::string_view w(line.data() + t.col, static_cast<size_t>(t.len));
+        auto found = lookup_.find(w);
+        Table::iterator it;
+        if (found != lookup_.end()) {
+            it = found->second;
+        } else {
+            it = words_.emplace(std::string(w), 0).first;
+            lookup_.emplace(it->first, it);
+        }
+        ++it->second;
+        l.words.push_back(it);
+    }
+    return out;
+}
+
+void WordIndex::drop(Line& l) {
+    for (auto it : l.words) {
+        if (--it->second > 0) continue;
+        lookup_.erase(it->first);
+        words_.erase(it);
+    }
+    l.words.clear();
+}
+
+void WordIndex::sync(const Buffer& buf) {
+    lines_.sync(
+        buf, [&](Line& l, const std::string& line, LexState in) { return lex(l, line, in); },
+        [&](Line& l) { drop(l); });
+}
+
+void WordIndex::complete(std::string_view prefix, size_t max, std::vector<std::string>& out) const {
+    for (auto it = words_.lower_bound(prefix); it != words_.end() && max > 0; ++it) {
+        if (it->first.compare(0, prefix.size(), prefix) != 0) break;
+        if (it->first.size() == prefix.size()) continue;
+        out.push_back(it->first);
+        --max;
+    }
+}
+
+} // namespace termite
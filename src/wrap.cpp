@@ -0,0 +1,109 @@
+#include "termite/wrap.hpp"
+
+#include "termite/buffer.hpp"
+#include "termite/folds.hpp"
+#include "termite/layout.hpp"
+
+#include <algorithm>
+
+namespace termite {
+
+const std::vector<int>& wrap_rows(const std::string& line, LineLayout& lay, int width) {
+    if (width < 1) width = 1;
+    if (lay.wrap_width == width) return lay.wrap_starts;
+    lay.wrap_width = width;
+    auto& starts = lay.wrap_starts;
+    starts.assign(1, 0);
+    int row_start = 0;
+    int brk = 0; // column right after the last space of the current row, 0 = none
+    size_t n = lay.plain ? line.size() : lay.cols.size() - 1;
+    for (size_t g = 0; g < n; ++g) {
+        int gc = lay.plain ? static_cast<int>(g) : lay.cols[g];
+        int ge = lay.plain ? gc + 1 : lay.cols[g + 1];
+        // break after the last space if there is one, else right before this grapheme
+        while (ge > row_start + width && gc > row_start) {
+            row_start = brk > row_start ? brk : gc;
+            starts.push_back(row_start);
+            brk = 0;
+        }
+        char ch = line[lay.plain ? g : static_cast<size_t>(lay.bytes[g])];
+        if (ch == ' ' || ch == '\t') brk = ge;
+    }
+    return starts;
+}
+
+void WrapIndex::refold() {
+    bool any = folds_ && !folds_->empty();
+    lines_.update(0, lines_.size(), [&](size_t row, Line& l) { l.hidden = any && folds_->hidden(row); });
+}
+
+void WrapIndex::reset(const Buffer& buf, int width, const FoldIndex* folds) {
+    width_ = std::max(1, width);
+    revision_ = buf.revision();
+    folds_ = folds;
+    fold_version_ = folds ? folds->version() : 0;
+    lines_.assign(buf.line_count(), Line{1, false, 0});
+    if (folds && !folds->empty()) refold();
+    lines_.settle();
+}
+
+void WrapIndex::sync(const Buffer& buf, int width, const FoldIndex* folds) {
+    if (std::max(1, width) != width_ || lines_.empty()) {
+        reset(buf, width, folds);
+        return;
+    }
+    // folds opened or closed: the counts stay, hidden lines count as none
+    uint64_t fold_version = folds ? folds->version() : 0;
+    bool refolded = folds != folds_ || fold_version != fold_version_;
+    folds_ = folds;
+    fold_version_ = fold_version;
+    if (buf.revision() != revision_) {
+        std::vector<LineEdit> edits;
+        if (!buf.edits_since(revision_, edits)) {
+            reset(buf, width, folds);
+            return;
+        }
+        // only the edited lines change, new ones count as one row until they are drawn; lines edited
+        // in place keep their count until measure() sees the new stamp. New lines are never hidden:
+        // a fold that gets lines inserted into it opens.
+        for (const auto& e : edits)
+            if (e.removed != 0 || e.added != 0) lines_.splice(e.row, e.removed, e.added, Line{1, false, 0});
+        revision_ = buf.revision();
+        if (lines_.size() != buf.line_count()) {
+            reset(buf, width, folds);
+            return;
+        }
+    }
+    if (refolded) refold();
+    lines_.settle();
+}
+
+int WrapIndex::measure(const Buffer& buf, LayoutCache& layouts, size_t line) {
+    uint64_t stamp = buf.line_stamp(line);
+    const Line& l = lines_[line];
+    if (l.stamp == stamp) return l.rows;
+    auto& lay = layouts.get_mut(buf, line);
+    int rows = static_cast<int>(wrap_rows(buf.line(line), lay, width_).size());
+    Line& m = lines_.mut(line);
+    m.rows = rows;
+    m.stamp = stamp;
+    lines_.settle();
+    return rows;
+}
+
+size_t WrapIndex::line_at(int64_t vrow, int& sub) const {
+    if (vrow < 0) vrow = 0;
+    // down the tree: the first line whose rows reach past vrow
+    int64_t before = 0;
+    size_t line = lines_.seek_forward(
+        0, [&](const Rows& r) { return before + r.n > vrow; }, [&](const Rows& r) { before += r.n; });
+    if (line == decltype(lines_)::NONE) {
+        size_t last = folds_ && !folds_->empty() ? folds_->line_at(folds_->visible_lines() - 1) : lines_.size() - 1;
+        sub = lines_[last].rows - 1;
+        return last;
+    }
+    sub = static_cast<int>(vrow - before);
+    return line;
+}
+
+} // namespace termite